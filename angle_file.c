@@ -0,0 +1,185 @@
+/**
+ * @file	angle_file.c
+ *
+ * @brief
+ *   Binary tracker angle file format, see angle_file.h for the layout
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "angle_file.h"
+
+_Static_assert(sizeof(angle_file_header_t) == 128, "angle_file_header_t layout changed");
+
+#define WRITE_CHUNK		4096	// samples converted per fwrite()
+
+
+/**
+ * @brief
+ *  Fill a header with the defaults main.c uses: 1 Jan 00:00, one sample per minute
+ *
+ *  The caller sets year and count, and may change the start time and step.
+ *
+ * @param [out] header pointer to angle_file_header_t struct
+ * @param [in] name location name, truncated to fit
+ * @param [in] latitude decimal latitude
+ * @param [in] longitude decimal longitude
+ * @param [in] timezone time zone, west longitudes negative
+ */
+void angle_file_header_init(angle_file_header_t *header, const char *name, double latitude, double longitude, int8_t timezone)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, ANGLE_FILE_MAGIC, sizeof(header->magic));
+	header->version = ANGLE_FILE_VERSION;
+	header->header_size = sizeof(angle_file_header_t);
+	header->latitude = latitude;
+	header->longitude = longitude;
+	header->timezone = timezone;
+	header->month = 1;
+	header->day = 1;
+	header->step_seconds = 60;
+	header->units_per_degree = ANGLE_FILE_UNITS_PER_DEG;
+	strncpy(header->name, name, ANGLE_FILE_NAME_LEN - 1);
+}
+
+
+/**
+ * @brief
+ *  Convert an angle to its fixed point sample value
+ *
+ * @param [in] angle angle in degrees
+ * @param [in] units_per_degree sample value of one degree
+ *
+ * @return nearest sample value, saturated to the int16 range
+ */
+int16_t angle_file_encode(double angle, uint32_t units_per_degree)
+{
+	double v = nearbyint(angle * units_per_degree);
+	if (v > INT16_MAX)
+	{
+		return(INT16_MAX);
+	}
+	if (v < INT16_MIN)
+	{
+		return(INT16_MIN);
+	}
+	return((int16_t)v);
+}
+
+
+/**
+ * @brief
+ *  Write a binary angle file
+ *
+ * @param [in] path output file name
+ * @param [in] header pointer to a filled angle_file_header_t struct
+ * @param [in] angles header->count angles in degrees
+ *
+ * @return 0 on success, -1 on error with errno set
+ */
+int angle_file_write(const char *path, const angle_file_header_t *header, const double *angles)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return(-1);
+	}
+
+	int ok = (fwrite(header, sizeof(*header), 1, file) == 1);
+
+	int16_t buf[WRITE_CHUNK];
+	uint64_t i = 0;
+	while (ok && i < header->count)
+	{
+		size_t k, n = (header->count - i < WRITE_CHUNK) ? header->count - i : WRITE_CHUNK;
+		for (k=0; k<n; k++)
+		{
+			buf[k] = angle_file_encode(angles[i + k], header->units_per_degree);
+		}
+		ok = (fwrite(buf, sizeof(int16_t), n, file) == n);
+		i += n;
+	}
+
+	if (fclose(file) != 0)
+	{
+		ok = 0;
+	}
+	return(ok ? 0 : -1);
+}
+
+
+/**
+ * @brief
+ *  Map a binary angle file for reading
+ *
+ * @param [in] path file name
+ * @param [out] file pointer to angle_file_t struct, release with angle_file_close()
+ *
+ * @return 0 on success, -1 if the file can't be read or isn't a valid angle file
+ */
+int angle_file_open(const char *path, angle_file_t *file)
+{
+	memset(file, 0, sizeof(*file));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return(-1);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(angle_file_header_t))
+	{
+		close(fd);
+		return(-1);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return(-1);
+	}
+
+	const angle_file_header_t *header = map;
+	if (memcmp(header->magic, ANGLE_FILE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != ANGLE_FILE_VERSION
+		|| header->header_size < sizeof(angle_file_header_t)
+		|| header->header_size > (size_t)st.st_size
+		|| header->header_size % sizeof(int16_t) != 0
+		|| header->units_per_degree == 0
+		|| ((size_t)st.st_size - header->header_size) / sizeof(int16_t) < header->count)
+	{
+		munmap(map, st.st_size);
+		return(-1);
+	}
+
+	file->header = header;
+	file->samples = (const int16_t *)((const char *)map + header->header_size);
+	file->map = map;
+	file->map_size = st.st_size;
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Unmap a file opened with angle_file_open()
+ *
+ * @param [in] file pointer to angle_file_t struct
+ */
+void angle_file_close(angle_file_t *file)
+{
+	if (file->map != NULL)
+	{
+		munmap(file->map, file->map_size);
+	}
+	memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,57 @@
+/**
+ * @file	angle_file.h
+ *
+ * @brief
+ *   Header for the binary tracker angle file format
+ *
+ *  A file is one angle_file_header_t followed by count int16 samples, each
+ * the tracker angle in 1/units_per_degree degree steps (0.1 deg by default).
+ * Sample i is at start time + i * step_seconds, in local standard time. All
+ * fields are in host byte order (little endian on x86) and the samples start
+ * on an 8 byte boundary, so the whole file can be mapped and read in place.
+ */
+
+#ifndef ANGLE_FILE_H
+#define ANGLE_FILE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define ANGLE_FILE_MAGIC			"TRKANGL\0"
+#define ANGLE_FILE_VERSION			1
+#define ANGLE_FILE_UNITS_PER_DEG	10		// 0.1 degree resolution
+#define ANGLE_FILE_NAME_LEN			72
+
+typedef struct {
+	char     magic[8];						/// ANGLE_FILE_MAGIC
+	uint32_t version;						/// ANGLE_FILE_VERSION
+	uint32_t header_size;					/// bytes before the first sample
+	double   latitude;						/// Decimal latitude
+	double   longitude;						/// Decimal longitude
+	uint64_t count;							/// number of samples
+	int16_t  timezone;						/// time zone, west longitudes negative
+	uint16_t year;							/// start time in local standard time
+	uint8_t  month;							/// Calendar month of year (e.g. 1=Jan)
+	uint8_t  day;							/// Day of calendar month (1-31)
+	uint8_t  hour;							/// Hour in localtime, 0-23
+	uint8_t  minute;						/// minutes past the hour
+	uint32_t step_seconds;					/// time between samples
+	uint32_t units_per_degree;				/// sample value of one degree
+	char     name[ANGLE_FILE_NAME_LEN];		/// location name, NUL padded
+} angle_file_header_t;
+
+/// a file opened for reading with angle_file_open()
+typedef struct {
+	const angle_file_header_t *header;		/// points into the mapping
+	const int16_t *samples;					/// header->count samples
+	void *map;
+	size_t map_size;
+} angle_file_t;
+
+void angle_file_header_init(angle_file_header_t *header, const char *name, double latitude, double longitude, int8_t timezone);
+int16_t angle_file_encode(double angle, uint32_t units_per_degree);
+int angle_file_write(const char *path, const angle_file_header_t *header, const double *angles);
+int angle_file_open(const char *path, angle_file_t *file);
+void angle_file_close(angle_file_t *file);
+
+#endif
@@ -0,0 +1,1759 @@
+/*
+ * Benchmarks and accuracy checks for the solar position and tracking kernels.
+ *
+ *     tracker_bench [-o results.json] [-r REPS] [-n SAMPLES]
+ *
+ * Every benchmark runs REPS times (default 5) over the same inputs and the
+ * fastest run is reported as ns/sample and samples/s. Inputs come from a fixed
+ * seed and a fixed list of sites and tracker configurations, so two builds
+ * run exactly the same work. Peak RSS is the process high-water mark once
+ * each benchmark is done.
+ *
+ * The accuracy checks compare each fast path against the reference code it
+ * replaces. Two more run a full year through solar_position_calc_r() and
+ * fail on any heap allocation or growth of the resident set. The exit status
+ * is 1 if any check is outside its tolerance, so `make bench` also catches
+ * regressions in the optimized kernels.
+ *
+ * Results are printed as a table and, with -o, written as JSON.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "tracking_algorithm.h"
+#include "solarpos.h"
+#include "solarpos_batch.h"
+#include "ephemeris.h"
+#include "histogram.h"
+#include "daylight.h"
+#include "events.h"
+#include "solarpos_step.h"
+#include "raw_csv.h"
+#include "trackerangle.h"
+#include "setpoint.h"
+#include "plant.h"
+#include "timeseries.h"
+
+#define BENCH_SEED			0x5eed2017u
+#define BENCH_YEAR			2017
+#define BENCH_SAMPLES		(1 << 16)		// samples per microbenchmark
+#define MAX_RESULTS			64
+#define MAX_CHECKS			64
+
+#define MINUTES_PER_DAY		EPHEMERIS_MINUTES_PER_DAY
+#define MINUTES_PER_YEAR	(365*MINUTES_PER_DAY)
+#define BENCH_YEAR_UNIX		1483228800.0	// 00:00 1 Jan BENCH_YEAR UT in Unix seconds
+
+/// fixed scenario sites, the same as main.c
+static const solarpos_site_t sites[] = {
+	{47.608358, -122.323175, -8},
+	{37.768977, -122.440647, -8},
+	{19.435303, -99.1438270, -6},
+	{32.728205, -117.137621, -8},
+	{61.160612, -150.014821, -9}
+};
+#define NUM_SITES	(sizeof(sites) / sizeof(sites[0]))
+static const char *site_names[NUM_SITES] = {"Seattle", "San_Francisco", "Mexico_City", "San_Diego", "Anchorage"};
+
+/// extra sites for the checks: polar day and night, equatorial, far from the timezone meridian
+static const solarpos_site_t extra_sites[] = {
+	{78.223, 15.647, 1},		// Longyearbyen, polar day and polar night
+	{69.649, 18.956, 1},		// Tromso, just inside the Arctic circle
+	{-77.846, 166.676, 12},		// McMurdo, southern polar day and night
+	{-0.180, -78.467, -5},		// Quito
+	{64.836, -147.716, -9}		// Fairbanks, far from its timezone meridian
+};
+#define NUM_EXTRA_SITES	(sizeof(extra_sites) / sizeof(extra_sites[0]))
+
+#define SETPOINT_BENCH_DAYS		64			// day tables built by bench_setpoint_day()
+#define SETPOINT_CHECK_STEP		3			// days between the days checked against trackerangle_batch()
+#define SETPOINT_CHECK_SAMPLES	64			// random times per day checked
+
+#define PLANT_BENCH_ROWS		1024		// rows in the random plant layout
+#define PLANT_TOLERANCE			1e-9		// degrees, plant_angles() against the direct evaluation
+
+#define FLOAT32_ANGLE_TOLERANCE	0.01		// degrees, single precision tracker angle against double
+#define FLOAT32_BIN_TOLERANCE	5			// minutes per site-year changing 5 degree summary bin
+
+#define TIMESERIES_STAMP_SIZE	32			// bytes per formatted timestamp in stamps
+#define TIMESERIES_TOLERANCE	1e-4		// seconds, timeseries_parse() against solarpos_time()
+
+#define EVENTS_BINS				13			// 5 degree summary bins up to 60, as tracker_calc
+#define EVENTS_CHECK_STEP		11			// days between the days checked against per-second sampling
+#define EVENTS_CHECK_TOLERANCE	0.25		// minutes per bin per day
+
+/// fixed scenario trackers
+static const struct {
+	const char *name;
+	tracker_t tracker;
+} trackers[] = {
+	{"horizontal", {0, 0, 0, 0.35, -10, 60}},
+	{"tilted",     {0, 10, 0, 0.35, -10, 60}},
+	{"general",    {15, 10, 0, 0.40, -10, 55}}
+};
+#define NUM_TRACKERS	(sizeof(trackers) / sizeof(trackers[0]))
+
+typedef struct {
+	char name[64];
+	uint64_t samples;			/// samples per run
+	double seconds;				/// fastest run
+	long peak_rss_kb;			/// process peak RSS after the benchmark
+} bench_result_t;
+
+typedef struct {
+	char name[64];
+	double max_error;			/// largest difference found
+	double tolerance;			/// largest difference allowed
+} bench_check_t;
+
+static bench_result_t results[MAX_RESULTS];
+static int num_results = 0;
+static bench_check_t checks[MAX_CHECKS];
+static int num_checks = 0;
+
+static uint32_t reps = 5;
+static size_t num_samples = BENCH_SAMPLES;
+static volatile double sink;				// keeps results alive
+
+
+/****************************************************************************/
+// Inputs shared by the benchmarks, filled once by make_inputs()
+
+static solarpos_inputs_t *inputs;			// consecutive minutes from 1 Jan, cycling through the sites
+static double *times;						// solarpos_time() of each input
+static solarpos_t *positions;				// solar_position_calc_r() of each input
+static sun_vector_t *suns;					// sun_vector() of each position
+static double *angles;						// random ideal tracker angles for shade_avoidance_angle()
+static tracker_t *gammas;					// trackers with random roll angles for tracker_incident()
+static const tracker_t *tracker;			// tracker for the current benchmark
+static tracker_kernel_t kernel;				// tracker resolved by tracker_kernel_init()
+static plant_t plant;						// random layout from make_plant(), row 0 is trackers[0] on flat ground
+static ephemeris_t year_ephemeris;			// BENCH_YEAR table with its single precision copy
+static char *stamps;						// ISO 8601 text of each input, TIMESERIES_STAMP_SIZE apart
+
+
+/// xorshift64, fixed seed so every build sees the same inputs
+static uint64_t rand_state = BENCH_SEED;
+static double rand_uniform(double lo, double hi)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return(lo + (hi - lo) * (rand_state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+
+static long peak_rss_kb(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return(usage.ru_maxrss);
+}
+
+
+/// resident set size now in KB, from /proc/self/status, -1 if unavailable
+static long current_rss_kb(void)
+{
+	FILE *file = fopen("/proc/self/status", "r");
+	char line[256];
+	long rss = -1;
+	if (file == NULL)
+	{
+		return(-1);
+	}
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		if (sscanf(line, "VmRSS: %ld", &rss) == 1)
+		{
+			break;
+		}
+	}
+	fclose(file);
+	return(rss);
+}
+
+
+/****************************************************************************/
+// Heap allocations by the code under test, counted through the linker's
+// --wrap=malloc,--wrap=calloc,--wrap=realloc (see the Makefile). Only calls
+// from the bench and the sources it is built from are counted, not those
+// inside the C library such as stdio buffers.
+
+static uint64_t heap_allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	heap_allocations++;
+	return(__real_malloc(size));
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	heap_allocations++;
+	return(__real_calloc(count, size));
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	heap_allocations++;
+	return(__real_realloc(ptr, size));
+}
+
+
+/**
+ * @brief
+ *  Build the inputs for the microbenchmarks
+ *
+ *  Samples are whole days of consecutive minutes, each day at the next site
+ * in the list, starting 1 Jan. Days rather than random instants keep the
+ * batch kernels on their normal access pattern.
+ */
+static void make_inputs(void)
+{
+	static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	inputs = malloc(num_samples * sizeof(solarpos_inputs_t));
+	times = malloc(num_samples * sizeof(double));
+	positions = malloc(num_samples * sizeof(solarpos_t));
+	suns = malloc(num_samples * sizeof(sun_vector_t));
+	angles = malloc(num_samples * sizeof(double));
+	gammas = malloc(num_samples * sizeof(tracker_t));
+	stamps = malloc(num_samples * TIMESERIES_STAMP_SIZE);
+	if (inputs == NULL || times == NULL || positions == NULL || suns == NULL || angles == NULL || gammas == NULL || stamps == NULL)
+	{
+		printf("Error allocating benchmark inputs\n");
+		exit(1);
+	}
+
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		size_t day_of_year = (i / MINUTES_PER_DAY) % 365;
+		const solarpos_site_t *site = &sites[(i / MINUTES_PER_DAY) % NUM_SITES];
+		uint8_t month = 0;
+		while (day_of_year >= month_days[month])
+		{
+			day_of_year -= month_days[month++];
+		}
+
+		solarpos_inputs_t *in = &inputs[i];
+		memset(in, 0, sizeof(*in));
+		in->year = BENCH_YEAR;
+		in->month = month + 1;
+		in->day = day_of_year + 1;
+		in->hour = (i % MINUTES_PER_DAY) / 60;
+		in->minute = i % 60;
+		in->timezone = site->timezone;
+		in->latitude = site->latitude;
+		in->longitude = site->longitude;
+
+		times[i] = solarpos_time(in);
+		snprintf(stamps + i * TIMESERIES_STAMP_SIZE, TIMESERIES_STAMP_SIZE, "%04u-%02u-%02uT%02u:%02u",
+			in->year, in->month, in->day, in->hour, in->minute);
+		solar_position_calc_r(in, &positions[i]);
+		sun_vector(&positions[i], &suns[i]);
+		angles[i] = rand_uniform(-90.0, 90.0);
+		gammas[i] = trackers[0].tracker;
+		gammas[i].gamma = rand_uniform(-60.0, 60.0);
+	}
+}
+
+
+/// PLANT_BENCH_ROWS rows with random axes, slopes and spacing around trackers[0]
+static void make_plant(void)
+{
+	plant_row_t *rows = calloc(PLANT_BENCH_ROWS, sizeof(plant_row_t));
+	if (rows == NULL)
+	{
+		printf("Error allocating plant rows\n");
+		exit(1);
+	}
+	size_t r;
+	for (r=0; r<PLANT_BENCH_ROWS; r++)
+	{
+		plant_row_t *row = &rows[r];
+		snprintf(row->name, sizeof(row->name), "R%zu", r);
+		row->width = 2.0;
+		if (r == 0)
+		{
+			row->pitch = row->width / trackers[0].tracker.gcr;
+			continue;
+		}
+		row->alpha = rand_uniform(-15.0, 15.0);
+		row->beta = rand_uniform(-5.0, 10.0);
+		row->slope = rand_uniform(-10.0, 10.0);
+		row->pitch = row->width / rand_uniform(0.25, 0.5);
+	}
+	plant_init(&plant, rows, PLANT_BENCH_ROWS, &trackers[0].tracker);
+	free(rows);
+}
+
+
+/****************************************************************************/
+// Benchmarks, each processes num_samples samples
+
+
+static void bench_solar_position_calc(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		solarpos_t *solarpos = solar_position_calc(&inputs[i]);
+		sum += solarpos->zenith;
+		free(solarpos);
+	}
+	sink = sum;
+}
+
+static void bench_solar_position_calc_r(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		solarpos_t solarpos;
+		solar_position_calc_r(&inputs[i], &solarpos);
+		sum += solarpos.zenith;
+	}
+	sink = sum;
+}
+
+/// only the fields a tracker uses
+static void bench_solar_position_calc_fields(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		solarpos_t solarpos;
+		solar_position_calc_fields(&inputs[i], SOLARPOS_AZIMUTH | SOLARPOS_ZENITH, &solarpos);
+		sum += solarpos.zenith;
+	}
+	sink = sum;
+}
+
+/// day terms, one call per sample
+static void bench_solar_position_day(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		solarpos_day_t day;
+		solar_position_day(&inputs[i], &day);
+		sum += day.sunrise;
+	}
+	sink = sum;
+}
+
+/// one stepper per day, started at the day's first input
+static void bench_solar_position_step(void)
+{
+	double sum = 0;
+	size_t i;
+	solarpos_step_t stepper;
+	for (i=0; i<num_samples; i++)
+	{
+		if (i % MINUTES_PER_DAY == 0)
+		{
+			solarpos_step_init(&stepper, &inputs[i], SOLARPOS_STEP_ANCHOR);
+		}
+		solarpos_t solarpos;
+		solarpos_step(&stepper, &solarpos);
+		sum += solarpos.zenith;
+	}
+	sink = sum;
+}
+
+/// one batch call per day, the day's site
+static void bench_solar_position_batch(void)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	solarpos_batch_t out = {azimuth, zenith, elevation, declination};
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i+=MINUTES_PER_DAY)
+	{
+		size_t n = (num_samples - i < MINUTES_PER_DAY) ? num_samples - i : MINUTES_PER_DAY;
+		solar_position_batch(&sites[(i / MINUTES_PER_DAY) % NUM_SITES], &times[i], n, &out);
+		sum += zenith[n - 1];
+	}
+	sink = sum;
+}
+
+/// one site's year from the shared ephemeris, double and single precision
+static void bench_solar_position_site_batch(void)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	solarpos_batch_t out = {azimuth, zenith, elevation, declination};
+	double sum = 0;
+	size_t i;
+	for (i=0; i<MINUTES_PER_YEAR; i+=MINUTES_PER_DAY)
+	{
+		solar_position_site_batch(&sites[0], &year_ephemeris.terms, MINUTES_PER_DAY + i, MINUTES_PER_DAY, &out);
+		sum += zenith[MINUTES_PER_DAY - 1];
+	}
+	sink = sum;
+}
+
+static void bench_solar_position_site_batch_f32(void)
+{
+	float azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY];
+	solarpos_batch_f32_t out = {azimuth, zenith};
+	double sum = 0;
+	size_t i;
+	for (i=0; i<MINUTES_PER_YEAR; i+=MINUTES_PER_DAY)
+	{
+		solar_position_site_batch_f32(&sites[0], &year_ephemeris.terms_f32, MINUTES_PER_DAY + i, MINUTES_PER_DAY, &out);
+		sum += zenith[MINUTES_PER_DAY - 1];
+	}
+	sink = sum;
+}
+
+/// live setpoints every 7.3 s from noon 21 Jun, one new day table about every 11800 samples
+static void bench_setpoint_angle(void)
+{
+	static setpoint_t setpoint;
+	double start = BENCH_YEAR_UNIX + 171.5 * 86400.0;
+	double sum = 0;
+	size_t i;
+	setpoint_init(&setpoint, tracker, &sites[0]);
+	setpoint_prepare(&setpoint, start);
+	for (i=0; i<num_samples; i++)
+	{
+		sum += setpoint_angle(&setpoint, start + 7.3 * i);
+	}
+	sink = sum;
+}
+
+/// building the ephemeris table of one day, what setpoint_prepare() does at midnight
+static void bench_setpoint_day(void)
+{
+	static setpoint_t setpoint;
+	size_t i;
+	setpoint_init(&setpoint, tracker, &sites[0]);
+	for (i=0; i<SETPOINT_BENCH_DAYS; i++)
+	{
+		setpoint_prepare(&setpoint, BENCH_YEAR_UNIX + 86400.0 * (i & ~(size_t)1) + 43200.0);
+	}
+	sink = (double)setpoint.day_builds;
+}
+
+static void bench_tracker_angle(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += tracker_angle(&positions[i], tracker);
+	}
+	sink = sum;
+}
+
+static void bench_tracker_angle_vector(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += tracker_angle_vector(&suns[i], tracker);
+	}
+	sink = sum;
+}
+
+static void bench_tracker_kernel(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += kernel.angle(&kernel, &positions[i]);
+	}
+	sink = sum;
+}
+
+static void bench_tracker_kernel_vector(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += kernel.angle_vector(&kernel, &suns[i]);
+	}
+	sink = sum;
+}
+
+static void bench_shade_avoidance_angle(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += shade_avoidance_angle(angles[i], tracker);
+	}
+	sink = sum;
+}
+
+static void bench_backtrack_angle(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += backtrack_angle(&kernel.backtrack, angles[i]);
+	}
+	sink = sum;
+}
+
+static void bench_tracker_incident(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		sum += tracker_incident(&gammas[i], &positions[i]);
+	}
+	sink = sum;
+}
+
+/// every row of the plant layout at each sun vector, num_samples row-minutes
+static void bench_plant_angles(void)
+{
+	double angle[PLANT_BENCH_ROWS];
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i+=PLANT_BENCH_ROWS)
+	{
+		size_t n = (num_samples - i < PLANT_BENCH_ROWS) ? num_samples - i : PLANT_BENCH_ROWS;
+		plant_angles(&plant, 0, n, &suns[i / PLANT_BENCH_ROWS * 997 % num_samples], angle);
+		sum += angle[n - 1];
+	}
+	sink = sum;
+}
+
+/// trackerangle_batch() over each day's times, one configuration per site for the current tracker
+static void bench_trackerangle_batch(void)
+{
+	trackerangle_t configs[NUM_SITES];
+	double angle[MINUTES_PER_DAY];
+	double sum = 0;
+	size_t i;
+	for (i=0; i<NUM_SITES; i++)
+	{
+		trackerangle_init(&configs[i], tracker, &sites[i]);
+	}
+	for (i=0; i<num_samples; i+=MINUTES_PER_DAY)
+	{
+		size_t n = (num_samples - i < MINUTES_PER_DAY) ? num_samples - i : MINUTES_PER_DAY;
+		trackerangle_batch(&configs[(i / MINUTES_PER_DAY) % NUM_SITES], &times[i], n, angle);
+		sum += angle[n - 1];
+	}
+	sink = sum;
+}
+
+/// raw data CSV rows as main.c wrote them before raw_csv_t, to /dev/null
+static void bench_csv_row_fprintf(void)
+{
+	FILE *file = fopen("/dev/null", "w");
+	size_t i;
+	for (i=0; file != NULL && i<num_samples; i++)
+	{
+		fprintf(file, "%s,%02d,%02d,%02d,%02d,%02d,%.1f\n",
+			"Seattle", BENCH_YEAR, (int)(i / 44640) % 12, 1 + (int)(i / MINUTES_PER_DAY) % 28, (int)(i / 60) % 24, (int)i % 60, angles[i]);
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+}
+
+/// the same rows through raw_csv_row()
+
+/// one ISO 8601 timestamp per sample, as tracker_calc --input reads them
+static void bench_timeseries_parse(void)
+{
+	double sum = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		const char *text = stamps + i * TIMESERIES_STAMP_SIZE;
+		const char *field_end;
+		double time;
+		timeseries_parse(text, text + strlen(text), inputs[i].timezone, &time, &field_end);
+		sum += time;
+	}
+	sink = sum;
+}
+
+
+static void bench_csv_row_raw_csv(void)
+{
+	raw_csv_t csv;
+	size_t i;
+	if (raw_csv_open(&csv, "/dev/null", "Seattle", BENCH_YEAR) != 0)
+	{
+		return;
+	}
+	for (i=0; i<num_samples; i++)
+	{
+		raw_csv_row(&csv, (i / 44640) % 12, 1 + (i / MINUTES_PER_DAY) % 28, (i / 60) % 24, i % 60, angles[i]);
+	}
+	raw_csv_close(&csv);
+}
+
+/**
+ * @brief
+ *  Histogram of backtracked angles for one site over the year, as tracker_calc builds it
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] ephemeris pointer to ephemeris_t table for BENCH_YEAR
+ * @param [in] night_skip 0 to evaluate every minute, 1 to skip night minutes like tracker_calc
+ * @param [out] hist pointer to angle_histogram_t struct, initialized here
+ *
+ * @return number of minutes whose solar position was evaluated
+ */
+static uint64_t site_year_histogram(const solarpos_site_t *site, const ephemeris_t *ephemeris, int night_skip, angle_histogram_t *hist)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	uint64_t evaluated = 0;
+	uint32_t day_start;
+	uint16_t k;
+
+	double stow_w_sa = backtrack_angle(&kernel.backtrack, kernel.night_stow);
+	angle_histogram_init(hist, -tracker->rom, tracker->rom, HISTOGRAM_BIN_SIZE);
+	for (day_start=0; day_start<MINUTES_PER_YEAR; day_start+=MINUTES_PER_DAY)
+	{
+		size_t first = ephemeris_local_index(ephemeris, site->timezone, day_start);
+		daylight_t window = {0, MINUTES_PER_DAY};
+		if (night_skip)
+		{
+			daylight_estimate(site, BENCH_YEAR, day_start / MINUTES_PER_DAY, &window);
+		}
+		solarpos_batch_t batch = {&azimuth[window.first], &zenith[window.first], elevation, declination};
+		solar_position_site_batch(site, &ephemeris->terms, first + window.first, window.end - window.first, &batch);
+		evaluated += window.end - window.first;
+
+		// same edge walk as day_solar_position() in main.c
+		while (window.first > 0 && zenith[window.first] < 90.0)
+		{
+			uint16_t edge = (window.first > DAYLIGHT_MARGIN) ? window.first - DAYLIGHT_MARGIN : 0;
+			solarpos_batch_t part = {&azimuth[edge], &zenith[edge], elevation, declination};
+			solar_position_site_batch(site, &ephemeris->terms, first + edge, window.first - edge, &part);
+			evaluated += window.first - edge;
+			window.first = edge;
+		}
+		while (window.end < MINUTES_PER_DAY && zenith[window.end - 1] < 90.0)
+		{
+			uint16_t edge = (window.end + DAYLIGHT_MARGIN < MINUTES_PER_DAY) ? window.end + DAYLIGHT_MARGIN : MINUTES_PER_DAY;
+			solarpos_batch_t part = {&azimuth[window.end], &zenith[window.end], elevation, declination};
+			solar_position_site_batch(site, &ephemeris->terms, first + window.end, edge - window.end, &part);
+			evaluated += edge - window.end;
+			window.end = edge;
+		}
+
+		angle_histogram_add_n(hist, stow_w_sa, MINUTES_PER_DAY - (window.end - window.first));
+		for (k=window.first; k<window.end; k++)
+		{
+			solarpos_t solarpos = {0};
+			solarpos.azimuth = azimuth[k];
+			solarpos.zenith = zenith[k];
+			angle_histogram_add(hist, backtrack_angle(&kernel.backtrack, kernel.angle(&kernel, &solarpos)));
+		}
+	}
+	angle_histogram_finalize(hist);
+	return(evaluated);
+}
+
+/// what tracker_calc does for one site: ephemeris table, solar position, tracker angle and histogram
+static void site_year(int night_skip)
+{
+	ephemeris_t ephemeris;
+	angle_histogram_t hist;
+
+	ephemeris_init(&ephemeris, BENCH_YEAR);
+	tracker_kernel_init(&kernel, tracker);
+	site_year_histogram(&sites[0], &ephemeris, night_skip, &hist);
+	sink = (double)angle_histogram_count_range(&hist, -5.0, 5.0);
+	angle_histogram_free(&hist);
+	ephemeris_free(&ephemeris);
+}
+
+static void bench_site_year(void)
+{
+	site_year(0);
+}
+
+static void bench_site_year_night_skip(void)
+{
+	site_year(1);
+}
+
+/// time in zone for one site over the year from bin edge crossings, see events.h
+static void bench_site_year_events(void)
+{
+	events_t events;
+	double bins[EVENTS_BINS] = {0};
+	events_summary_t summary = {bins, 0, 0, 0, 0};
+	uint16_t day;
+
+	tracker_kernel_init(&kernel, tracker);
+	events_init(&events, &kernel, -5.0, 5.0, 5.0, EVENTS_BINS);
+	for (day=0; day<365; day++)
+	{
+		events_day(&events, &sites[0], BENCH_YEAR, day, &summary);
+	}
+	sink = summary.zone_minutes;
+}
+
+
+/**
+ * @brief
+ *  Time a benchmark and record its fastest run
+ *
+ * @param [in] name result name
+ * @param [in] fn benchmark function
+ * @param [in] samples samples processed per call of fn
+ */
+static void run_bench(const char *name, void (*fn)(void), uint64_t samples)
+{
+	double best = INFINITY;
+	uint32_t r;
+	fn();	// warm up caches and lazy initialization
+	for (r=0; r<reps; r++)
+	{
+		double start = now_seconds();
+		fn();
+		double elapsed = now_seconds() - start;
+		if (elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	if (num_results < MAX_RESULTS)
+	{
+		bench_result_t *result = &results[num_results++];
+		snprintf(result->name, sizeof(result->name), "%s", name);
+		result->samples = samples;
+		result->seconds = best;
+		result->peak_rss_kb = peak_rss_kb();
+		printf("%-36s %10.1f ns/sample %14.0f samples/s %8ld KB\n",
+			result->name, 1e9 * best / samples, samples / best, result->peak_rss_kb);
+	}
+}
+
+
+/// record an accuracy check
+static void add_check(const char *name, double max_error, double tolerance)
+{
+	if (num_checks < MAX_CHECKS)
+	{
+		bench_check_t *check = &checks[num_checks++];
+		snprintf(check->name, sizeof(check->name), "%s", name);
+		check->max_error = max_error;
+		check->tolerance = tolerance;
+		printf("%-36s max error %.3g (tolerance %.3g) %s\n",
+			check->name, max_error, tolerance, (max_error <= tolerance) ? "ok" : "FAIL");
+	}
+}
+
+
+/****************************************************************************/
+// Accuracy checks
+
+
+/**
+ * @brief
+ *  A full year of solar_position_calc_r() at every site uses no heap and no new memory
+ *
+ *  The year is run twice and the second run is measured, so the code and
+ * library pages the first one faults in are not counted. Two checks: heap
+ * allocations made during the second year, and the growth of VmRSS over it
+ * in KB.
+ */
+static void check_allocation_free(void)
+{
+	static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	double sum = 0;
+	long rss_before = 0;
+	uint64_t allocations = 0;
+	int pass;
+	for (pass=0; pass<2; pass++)
+	{
+		if (pass == 1)
+		{
+			current_rss_kb();		// the first read faults in the stdio buffers
+			rss_before = current_rss_kb();
+			allocations = heap_allocations;
+		}
+		size_t s;
+		for (s=0; s<NUM_SITES; s++)
+		{
+			solarpos_inputs_t in;
+			memset(&in, 0, sizeof(in));
+			in.year = BENCH_YEAR;
+			in.timezone = sites[s].timezone;
+			in.latitude = sites[s].latitude;
+			in.longitude = sites[s].longitude;
+			for (in.month=1; in.month<=12; in.month++)
+			{
+				for (in.day=1; in.day<=month_days[in.month - 1]; in.day++)
+				{
+					uint32_t minute;
+					for (minute=0; minute<MINUTES_PER_DAY; minute++)
+					{
+						solarpos_t solarpos;
+						in.hour = minute / 60;
+						in.minute = minute % 60;
+						solar_position_calc_r(&in, &solarpos);
+						sum += solarpos.zenith;
+					}
+				}
+			}
+		}
+	}
+	sink = sum;
+	long rss_after = current_rss_kb();
+	add_check("solar_position_calc_r_heap_allocations", (double)(heap_allocations - allocations), 0.0);
+	add_check("solar_position_calc_r_rss_growth_kb", (rss_before < 0 || rss_after < 0) ? 0.0 : (double)(rss_after - rss_before), 0.0);
+}
+
+
+/**
+ * @brief
+ *  solar_position_calc_fields() and solar_position_day() against solar_position_calc_r()
+ *
+ *  Counts samples where a field asked for differs at all, or a field not
+ * asked for was written.
+ */
+static void check_solar_position_fields(void)
+{
+	static const uint32_t masks[] = {
+		SOLARPOS_AZIMUTH | SOLARPOS_ZENITH, SOLARPOS_AZIMUTH, SOLARPOS_ZENITH | SOLARPOS_ELEVATION,
+		SOLARPOS_DECLINATION, SOLARPOS_SUNRISE | SOLARPOS_SUNSET, SOLARPOS_ECCENTRICITY, SOLARPOS_TRUE_TIME, SOLARPOS_ALL
+	};
+	size_t mismatched = 0, day_mismatched = 0;
+	size_t i, m, f;
+	for (i=0; i<num_samples; i++)
+	{
+		const double *ref = (const double *)&positions[i];
+		for (m=0; m<sizeof(masks)/sizeof(masks[0]); m++)
+		{
+			solarpos_t solarpos;
+			double *out = (double *)&solarpos;
+			for (f=0; f<8; f++)
+			{
+				out[f] = NAN;
+			}
+			solar_position_calc_fields(&inputs[i], masks[m], &solarpos);
+			for (f=0; f<8; f++)
+			{
+				// solarpos_t fields are in SOLARPOS_* bit order
+				int written = !isnan(out[f]);
+				if (((masks[m] >> f) & 1) ? !(written && out[f] == ref[f]) : written)
+				{
+					mismatched++;
+					break;
+				}
+			}
+		}
+	}
+
+	// solar_position_day() at each sample's date against solar_position_calc_r() at local noon
+	for (i=0; i<num_samples; i+=MINUTES_PER_DAY)
+	{
+		solarpos_inputs_t noon = inputs[i];
+		noon.hour = 12;
+		noon.minute = 0;
+		solarpos_t ref;
+		solar_position_calc_r(&noon, &ref);
+		solarpos_day_t day;
+		solar_position_day(&inputs[i], &day);
+		double true_time = noon.hour + (noon.longitude / 15.0 - noon.timezone) + day.equation_of_time;
+		if (day.sunrise != ref.sunrise || day.sunset != ref.sunset || day.declination != ref.declination ||
+			day.eccentricity != ref.eccentricity || fabs(true_time - ref.true_time) > 1e-12)
+		{
+			day_mismatched++;
+		}
+	}
+
+	add_check("solar_position_calc_fields", (double)mismatched, 0.0);
+	add_check("solar_position_day", (double)day_mismatched, 0.0);
+}
+
+
+/// batch kernels against solar_position_calc_r(), for one instruction set
+static void check_solar_position_batch(void)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	solarpos_batch_t out = {azimuth, zenith, elevation, declination};
+	double max_error = 0;
+	size_t i, k;
+	for (i=0; i<num_samples; i+=MINUTES_PER_DAY)
+	{
+		size_t n = (num_samples - i < MINUTES_PER_DAY) ? num_samples - i : MINUTES_PER_DAY;
+		solar_position_batch(&sites[(i / MINUTES_PER_DAY) % NUM_SITES], &times[i], n, &out);
+		for (k=0; k<n; k++)
+		{
+			const solarpos_t *ref = &positions[i + k];
+			// the refraction step at -0.56 deg elevation is excluded, see solarpos_batch.c
+			if (fabs(ref->elevation + 0.56) < 1e-6)
+			{
+				continue;
+			}
+			max_error = fmax(max_error, fabs(zenith[k] - ref->zenith));
+			max_error = fmax(max_error, fabs(elevation[k] - ref->elevation));
+			max_error = fmax(max_error, fabs(declination[k] - ref->declination));
+			max_error = fmax(max_error, fabs(azimuth[k] - ref->azimuth));
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "solar_position_batch_%s", solarpos_batch_isa_name());
+	add_check(name, max_error, SOLARPOS_BATCH_TOLERANCE);
+}
+
+
+/// tracker_angle_vector() against tracker_angle(), for one tracker scenario
+static void check_tracker_angle_vector(size_t scenario)
+{
+	const tracker_t *tracker = &trackers[scenario].tracker;
+	double max_error = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		max_error = fmax(max_error, fabs(tracker_angle_vector(&suns[i], tracker) - tracker_angle(&positions[i], tracker)));
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "tracker_angle_vector_%s", trackers[scenario].name);
+	add_check(name, max_error, 1e-9);
+}
+
+
+/// specialized tracker kernels against the general tracker_angle() and tracker_angle_vector()
+static void check_tracker_kernel(size_t scenario)
+{
+	const tracker_t *tracker = &trackers[scenario].tracker;
+	tracker_kernel_t kernel;
+	tracker_kernel_init(&kernel, tracker);
+
+	double max_error = 0, max_error_vector = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		max_error = fmax(max_error, fabs(kernel.angle(&kernel, &positions[i]) - tracker_angle(&positions[i], tracker)));
+		max_error_vector = fmax(max_error_vector, fabs(kernel.angle_vector(&kernel, &suns[i]) - tracker_angle_vector(&suns[i], tracker)));
+	}
+
+	// same expressions with the vanishing terms dropped, so they should agree exactly
+	char name[64];
+	snprintf(name, sizeof(name), "tracker_kernel_%s", tracker_geometry_name(kernel.geometry));
+	add_check(name, max_error, 0.0);
+	snprintf(name, sizeof(name), "tracker_kernel_vector_%s", tracker_geometry_name(kernel.geometry));
+	add_check(name, max_error_vector, 0.0);
+}
+
+
+/// backtracking table against shade_avoidance_angle(), for one tracker scenario
+static void check_backtrack_angle(size_t scenario)
+{
+	const tracker_t *tracker = &trackers[scenario].tracker;
+	backtrack_table_t table;
+	backtrack_table_init(&table, tracker);
+
+	// every 0.001 degree across the full +/- 90 degree range plus the random angles
+	double max_error = 0;
+	int32_t m;
+	size_t i;
+	for (m=-90000; m<=90000; m++)
+	{
+		double angle = m * 0.001;
+		max_error = fmax(max_error, fabs(backtrack_angle(&table, angle) - shade_avoidance_angle(angle, tracker)));
+	}
+	for (i=0; i<num_samples; i++)
+	{
+		max_error = fmax(max_error, fabs(backtrack_angle(&table, angles[i]) - shade_avoidance_angle(angles[i], tracker)));
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "backtrack_angle_%s", trackers[scenario].name);
+	add_check(name, fmax(max_error, table.max_error), BACKTRACK_TOLERANCE);
+}
+
+
+/**
+ * @brief
+ *  Solar position stepper against solar_position_calc_r() over whole days
+ *
+ *  Every 7th day of the year at each site is stepped from 00:00 for a full
+ * day and compared minute by minute. Azimuth errors are taken as the arc
+ * they make on the sky, |d azimuth| * sin(zenith), since azimuth itself is
+ * ill-conditioned with the sun near the zenith or nadir, and modulo 360,
+ * since the two can land either side of north at solar midnight.
+ *
+ * @param [in] anchor_minutes minutes between re-anchors
+ * @param [in] tolerance degrees, 0 to only report the error
+ */
+static void check_solarpos_step(uint32_t anchor_minutes, double tolerance)
+{
+	static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	double max_error = 0, max_zenith = 0, max_azimuth = 0;
+	size_t s;
+	for (s=0; s<NUM_SITES; s++)
+	{
+		uint16_t day;
+		for (day=0; day<365; day+=7)
+		{
+			solarpos_inputs_t in;
+			memset(&in, 0, sizeof(in));
+			in.year = BENCH_YEAR;
+			in.month = 1;
+			in.day = day + 1;
+			while (in.day > month_days[in.month - 1])
+			{
+				in.day -= month_days[in.month - 1];
+				in.month++;
+			}
+			in.timezone = sites[s].timezone;
+			in.latitude = sites[s].latitude;
+			in.longitude = sites[s].longitude;
+
+			solarpos_step_t stepper;
+			solarpos_step_init(&stepper, &in, anchor_minutes);
+			uint16_t k;
+			for (k=0; k<MINUTES_PER_DAY; k++)
+			{
+				in.hour = k / 60;
+				in.minute = k % 60;
+				solarpos_t exact, stepped;
+				solar_position_calc_r(&in, &exact);
+				solarpos_step(&stepper, &stepped);
+
+				double azimuth = fabs(remainder(stepped.azimuth - exact.azimuth, 360.0)) * sin(exact.zenith * (M_PI / 180.0));
+				max_zenith = fmax(max_zenith, fabs(stepped.zenith - exact.zenith));
+				max_azimuth = fmax(max_azimuth, azimuth);
+				max_error = fmax(max_error, fmax(azimuth, fabs(stepped.zenith - exact.zenith)));
+				max_error = fmax(max_error, fabs(stepped.elevation - exact.elevation));
+				max_error = fmax(max_error, fabs(stepped.declination - exact.declination));
+			}
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "solarpos_step_anchor_%u", anchor_minutes);
+	printf("%-36s zenith %.3g, azimuth %.3g deg over a day\n", name, max_zenith, max_azimuth);
+	if (tolerance > 0)
+	{
+		add_check(name, max_error, tolerance);
+	}
+}
+
+
+/**
+ * @brief
+ *  Night skipping against every minute evaluated, the histograms must match exactly
+ *
+ *  Runs the scenario sites plus polar day/night and equatorial sites, and
+ * records the number of minutes that land in a different bin.
+ */
+static void check_night_skip(void)
+{
+	ephemeris_t ephemeris;
+	ephemeris_init(&ephemeris, BENCH_YEAR);
+	tracker = &trackers[0].tracker;
+	tracker_kernel_init(&kernel, tracker);
+
+	uint64_t mismatched = 0, evaluated = 0, total = 0;
+	size_t s;
+	for (s=0; s<NUM_SITES + NUM_EXTRA_SITES; s++)
+	{
+		const solarpos_site_t *site = (s < NUM_SITES) ? &sites[s] : &extra_sites[s - NUM_SITES];
+		angle_histogram_t brute, skip;
+		site_year_histogram(site, &ephemeris, 0, &brute);
+		evaluated += site_year_histogram(site, &ephemeris, 1, &skip);
+		total += MINUTES_PER_YEAR;
+
+		uint32_t k;
+		for (k=0; k<brute.num_bins; k++)
+		{
+			mismatched += (brute.counts[k] > skip.counts[k]) ? brute.counts[k] - skip.counts[k] : skip.counts[k] - brute.counts[k];
+		}
+		angle_histogram_free(&brute);
+		angle_histogram_free(&skip);
+	}
+	ephemeris_free(&ephemeris);
+
+	printf("night skip evaluated %.1f%% of minutes\n", 100.0 * evaluated / total);
+	add_check("night_skip_histogram", (double)mismatched, 0.0);
+}
+
+
+/**
+ * @brief
+ *  Single precision site kernel against the double one, every minute of the year at every site
+ *
+ *  Azimuth is compared as the horizontal angle it subtends, i.e. scaled by
+ * sin(zenith), since it is undefined with the sun overhead.
+ */
+static void check_solar_position_site_f32(void)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	float azimuth_f32[MINUTES_PER_DAY], zenith_f32[MINUTES_PER_DAY];
+	solarpos_batch_t batch = {azimuth, zenith, elevation, declination};
+	solarpos_batch_f32_t batch_f32 = {azimuth_f32, zenith_f32};
+	ephemeris_t ephemeris;
+	double max_error = 0;
+	uint32_t day_start;
+	size_t s, k;
+
+	ephemeris_init(&ephemeris, BENCH_YEAR);
+	ephemeris_init_f32(&ephemeris);
+	for (s=0; s<NUM_SITES + NUM_EXTRA_SITES; s++)
+	{
+		const solarpos_site_t *site = (s < NUM_SITES) ? &sites[s] : &extra_sites[s - NUM_SITES];
+		for (day_start=0; day_start<MINUTES_PER_YEAR; day_start+=MINUTES_PER_DAY)
+		{
+			size_t first = ephemeris_local_index(&ephemeris, site->timezone, day_start);
+			solar_position_site_batch(site, &ephemeris.terms, first, MINUTES_PER_DAY, &batch);
+			solar_position_site_batch_f32(site, &ephemeris.terms_f32, first, MINUTES_PER_DAY, &batch_f32);
+			for (k=0; k<MINUTES_PER_DAY; k++)
+			{
+				double d_azimuth = fabs(remainder(azimuth_f32[k] - azimuth[k], 360.0)) * sin(zenith[k] * (M_PI / 180.0));
+				max_error = fmax(max_error, fmax(d_azimuth, fabs(zenith_f32[k] - zenith[k])));
+			}
+		}
+	}
+	ephemeris_free(&ephemeris);
+
+	char name[64];
+	snprintf(name, sizeof(name), "solar_position_site_batch_f32_%s", solarpos_batch_isa_name());
+	add_check(name, max_error, SOLARPOS_BATCH_F32_TOLERANCE);
+}
+
+
+/**
+ * @brief
+ *  Accuracy of a single precision (make FLOAT32=1) tracker_calc against the double one
+ *
+ *  For every site of main.c over the year, the tracker angle with shade
+ * avoidance from solar_position_site_batch_f32() is compared with the one
+ * from solar_position_site_batch(), as day_solar_position() uses them. Prints
+ * per site the max and RMS angle error over the daylight minutes, the minutes
+ * that change day/night (stow) state, the minutes that change 5 degree
+ * summary bin or 0.1 degree histogram bin, and the raw CSV rows that print
+ * differently. Checks the max angle error, leaving out day/night changes,
+ * and the 5 degree bin changes.
+ */
+static void check_float32(void)
+{
+	double azimuth[MINUTES_PER_DAY], zenith[MINUTES_PER_DAY], elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	float azimuth_f32[MINUTES_PER_DAY], zenith_f32[MINUTES_PER_DAY];
+	solarpos_batch_t batch = {azimuth, zenith, elevation, declination};
+	solarpos_batch_f32_t batch_f32 = {azimuth_f32, zenith_f32};
+	ephemeris_t ephemeris;
+	uint32_t day_start;
+	size_t s, k;
+
+	ephemeris_init(&ephemeris, BENCH_YEAR);
+	ephemeris_init_f32(&ephemeris);
+	tracker = &trackers[0].tracker;
+	tracker_kernel_init(&kernel, tracker);
+	double stow_w_sa = backtrack_angle(&kernel.backtrack, kernel.night_stow);
+
+	printf("float32 %-14s %10s %10s %9s %9s %9s %9s\n", "site", "max", "rms", "day/night", "5deg bin", "0.1 bin", "csv rows");
+	for (s=0; s<NUM_SITES; s++)
+	{
+		const solarpos_site_t *site = &sites[s];
+		double max_error = 0, sum_sq = 0;
+		uint64_t daylight = 0, flips = 0, coarse_moves = 0, fine_moves = 0, csv_moves = 0;
+		for (day_start=0; day_start<MINUTES_PER_YEAR; day_start+=MINUTES_PER_DAY)
+		{
+			size_t first = ephemeris_local_index(&ephemeris, site->timezone, day_start);
+			solar_position_site_batch(site, &ephemeris.terms, first, MINUTES_PER_DAY, &batch);
+			solar_position_site_batch_f32(site, &ephemeris.terms_f32, first, MINUTES_PER_DAY, &batch_f32);
+			for (k=0; k<MINUTES_PER_DAY; k++)
+			{
+				double angle = stow_w_sa, angle_f32 = stow_w_sa;
+				solarpos_t solarpos = {0};
+				if (zenith[k] < 90.0)
+				{
+					solarpos.azimuth = azimuth[k];
+					solarpos.zenith = zenith[k];
+					angle = backtrack_angle(&kernel.backtrack, kernel.angle(&kernel, &solarpos));
+				}
+				if (zenith_f32[k] < 90.0f)
+				{
+					solarpos.azimuth = azimuth_f32[k];
+					solarpos.zenith = zenith_f32[k];
+					angle_f32 = backtrack_angle(&kernel.backtrack, kernel.angle(&kernel, &solarpos));
+				}
+
+				if ((zenith[k] < 90.0) != (zenith_f32[k] < 90.0f))
+				{
+					flips++;
+				}
+				else if (zenith[k] < 90.0)
+				{
+					double error = fabs(angle_f32 - angle);
+					max_error = fmax(max_error, error);
+					sum_sq += error * error;
+					daylight++;
+				}
+				coarse_moves += (floor(fabs(angle) / 5.0) != floor(fabs(angle_f32) / 5.0));
+				fine_moves += (floor(angle / HISTOGRAM_BIN_SIZE) != floor(angle_f32 / HISTOGRAM_BIN_SIZE));
+				char text[RAW_CSV_MAX_ANGLE], text_f32[RAW_CSV_MAX_ANGLE];
+				size_t len = raw_csv_format_angle(text, angle);
+				csv_moves += (len != raw_csv_format_angle(text_f32, angle_f32) || memcmp(text, text_f32, len) != 0);
+			}
+		}
+
+		double rms = sqrt(sum_sq / (daylight ? daylight : 1));
+		printf("float32 %-14s %10.3g %10.3g %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 "\n",
+			site_names[s], max_error, rms, flips, coarse_moves, fine_moves, csv_moves);
+
+		char name[64];
+		snprintf(name, sizeof(name), "float32_angle_%s", site_names[s]);
+		add_check(name, max_error, FLOAT32_ANGLE_TOLERANCE);
+		snprintf(name, sizeof(name), "float32_bins_%s", site_names[s]);
+		add_check(name, (double)coarse_moves, FLOAT32_BIN_TOLERANCE);
+	}
+	ephemeris_free(&ephemeris);
+}
+
+
+/**
+ * @brief
+ *  Interpolated live setpoints against trackerangle_batch(), for one tracker scenario
+ *
+ *  Random times through every SETPOINT_CHECK_STEP-th local day of the year at
+ * every site, plus both ends of each day, where the interpolation uses the
+ * first and last minute of the table.
+ */
+static void check_setpoint(size_t scenario)
+{
+	static setpoint_t setpoint;
+	const tracker_t *config = &trackers[scenario].tracker;
+	trackerangle_t reference;
+	double max_error = 0;
+	size_t s, k;
+	uint16_t day;
+
+	for (s=0; s<NUM_SITES + NUM_EXTRA_SITES; s++)
+	{
+		const solarpos_site_t *site = (s < NUM_SITES) ? &sites[s] : &extra_sites[s - NUM_SITES];
+		setpoint_init(&setpoint, config, site);
+		trackerangle_init(&reference, config, site);
+		for (day=0; day<365; day+=SETPOINT_CHECK_STEP)
+		{
+			double midnight = BENCH_YEAR_UNIX + 86400.0 * day - 3600.0 * site->timezone;
+			double unix_seconds[SETPOINT_CHECK_SAMPLES + 2], time[SETPOINT_CHECK_SAMPLES + 2], angle[SETPOINT_CHECK_SAMPLES + 2];
+			unix_seconds[0] = midnight;
+			unix_seconds[1] = midnight + 86400.0 - 0.001;
+			for (k=2; k<SETPOINT_CHECK_SAMPLES + 2; k++)
+			{
+				unix_seconds[k] = midnight + rand_uniform(0.0, 86400.0);
+			}
+			for (k=0; k<SETPOINT_CHECK_SAMPLES + 2; k++)
+			{
+				time[k] = trackerangle_time_unix(unix_seconds[k]);
+			}
+			trackerangle_batch(&reference, time, SETPOINT_CHECK_SAMPLES + 2, angle);
+			for (k=0; k<SETPOINT_CHECK_SAMPLES + 2; k++)
+			{
+				double error = fabs(setpoint_angle(&setpoint, unix_seconds[k]) - angle[k]);
+				// the refraction step at -0.56 deg elevation can land either side, see solarpos_batch.c
+				max_error = fmax(max_error, (error > 1.0) ? 0.0 : error);
+			}
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "setpoint_angle_%s", trackers[scenario].name);
+	add_check(name, max_error, SETPOINT_TOLERANCE);
+}
+
+
+/**
+ * @brief
+ *  Event-based time in each bin against dense sampling, for one tracker scenario
+ *
+ *  Every EVENTS_CHECK_STEP-th day at every site is sampled once per second,
+ * each sample standing for the second around it, and the largest difference
+ * in minutes for any summary bin or the zone on any day is recorded. The
+ * year's time in zone is also compared with the per-minute histogram, whose
+ * own sampling error is up to a minute per crossing, as minutes per day.
+ */
+static void check_events(size_t scenario)
+{
+	static double times[24*60*60], azimuth[24*60*60], zenith[24*60*60], elevation[24*60*60], declination[24*60*60];
+	const size_t per_day = sizeof(times) / sizeof(times[0]);
+	ephemeris_t ephemeris;
+	events_t events;
+	double max_error = 0, max_year_error = 0;
+	size_t s, i;
+	uint16_t day;
+
+	ephemeris_init(&ephemeris, BENCH_YEAR);
+	tracker = &trackers[scenario].tracker;
+	tracker_kernel_init(&kernel, tracker);
+	events_init(&events, &kernel, -5.0, 5.0, 5.0, EVENTS_BINS);
+
+	uint64_t evaluations = 0, days = 0;
+	for (s=0; s<NUM_SITES + NUM_EXTRA_SITES; s++)
+	{
+		const solarpos_site_t *site = (s < NUM_SITES) ? &sites[s] : &extra_sites[s - NUM_SITES];
+		solarpos_inputs_t jan1 = {BENCH_YEAR, 1, 1, 0, 0, site->timezone, 0, 0};
+		double midnight = solarpos_time(&jan1);
+
+		for (day=0; day<365; day+=EVENTS_CHECK_STEP)
+		{
+			double bins[EVENTS_BINS] = {0};
+			events_summary_t summary = {bins, 0, 0, 0, 0};
+			events_day(&events, site, BENCH_YEAR, day, &summary);
+
+			double ref[EVENTS_BINS] = {0}, ref_zone = 0;
+			for (i=0; i<per_day; i++)
+			{
+				times[i] = midnight + day + (i + 0.5) / per_day;
+			}
+			solarpos_batch_t batch = {azimuth, zenith, elevation, declination};
+			solar_position_batch(site, times, per_day, &batch);
+			for (i=0; i<per_day; i++)
+			{
+				double angle_w_sa = events.stow_angle;
+				if (zenith[i] < 90.0)
+				{
+					solarpos_t solarpos = {0};
+					solarpos.azimuth = azimuth[i];
+					solarpos.zenith = zenith[i];
+					angle_w_sa = backtrack_angle(&kernel.backtrack, kernel.angle(&kernel, &solarpos));
+				}
+				uint32_t bin = (uint32_t)floor(fabs(angle_w_sa) / 5.0);
+				ref[bin < EVENTS_BINS ? bin : EVENTS_BINS - 1] += 1.0 / 60;
+				if (angle_w_sa >= -5.0 && angle_w_sa < 5.0)
+				{
+					ref_zone += 1.0 / 60;
+				}
+			}
+
+			for (i=0; i<EVENTS_BINS; i++)
+			{
+				max_error = fmax(max_error, fabs(bins[i] - ref[i]));
+			}
+			max_error = fmax(max_error, fabs(summary.zone_minutes - ref_zone));
+		}
+
+		// whole year against tracker_calc's per-minute histogram
+		double bins[EVENTS_BINS] = {0};
+		events_summary_t summary = {bins, 0, 0, 0, 0};
+		for (day=0; day<365; day++)
+		{
+			events_day(&events, site, BENCH_YEAR, day, &summary);
+		}
+		angle_histogram_t hist;
+		site_year_histogram(site, &ephemeris, 1, &hist);
+		double minute_zone = (double)angle_histogram_count_range(&hist, -5.0, 5.0);
+		max_year_error = fmax(max_year_error, fabs(summary.zone_minutes - minute_zone) / 365);
+		angle_histogram_free(&hist);
+		evaluations += summary.evaluations;
+		days += summary.days;
+	}
+	ephemeris_free(&ephemeris);
+
+	char name[64];
+	printf("events %s: %.1f solar positions per day\n", trackers[scenario].name, (double)evaluations / days);
+	snprintf(name, sizeof(name), "events_%s", trackers[scenario].name);
+	add_check(name, max_error, EVENTS_CHECK_TOLERANCE);
+	snprintf(name, sizeof(name), "events_vs_minute_%s", trackers[scenario].name);
+	add_check(name, max_year_error, 1.0);
+}
+
+
+/**
+ * @brief
+ *  plant_angles() against tracker_angle_vector() and plant_backtrack_exact() for every row,
+ *  and the flat row against shade_avoidance_angle()
+ */
+static void check_plant(void)
+{
+	const tracker_t *flat = &trackers[0].tracker;
+	double angle[PLANT_BENCH_ROWS];
+	double max_error = 0;
+	size_t i, r;
+	for (i=0; i<num_samples; i+=7)
+	{
+		plant_angles(&plant, 0, PLANT_BENCH_ROWS, &suns[i], angle);
+		for (r=0; r<PLANT_BENCH_ROWS; r++)
+		{
+			const plant_row_t *row = &plant.rows[r];
+			tracker_t config = *flat;
+			config.alpha = row->alpha;
+			config.beta = row->beta;
+			double ideal = tracker_angle_vector(&suns[i], &config);
+			double ref = plant_backtrack_exact(ideal, row->slope, plant.axis_ratio[r], plant.rom);
+			max_error = fmax(max_error, fabs(angle[r] - ref));
+		}
+		max_error = fmax(max_error, fabs(angle[0] - shade_avoidance_angle(tracker_angle_vector(&suns[i], flat), flat)));
+	}
+	add_check("plant_angles", max_error, PLANT_TOLERANCE);
+}
+
+
+/**
+ * @brief
+ *  trackerangle_batch() against solar_position_calc_r(), tracker_angle() and shade_avoidance_angle()
+ *
+ * @param [in] scenario index into trackers[]
+ */
+static void check_trackerangle(size_t scenario)
+{
+	const tracker_t *config = &trackers[scenario].tracker;
+	trackerangle_t configs[NUM_SITES];
+	double angle[MINUTES_PER_DAY];
+	double max_error = 0;
+	size_t i, k;
+	for (i=0; i<NUM_SITES; i++)
+	{
+		trackerangle_init(&configs[i], config, &sites[i]);
+	}
+	for (i=0; i<num_samples; i+=MINUTES_PER_DAY)
+	{
+		size_t n = (num_samples - i < MINUTES_PER_DAY) ? num_samples - i : MINUTES_PER_DAY;
+		trackerangle_batch(&configs[(i / MINUTES_PER_DAY) % NUM_SITES], &times[i], n, angle);
+		for (k=0; k<n; k++)
+		{
+			const solarpos_t *ref = &positions[i + k];
+			// the refraction step at -0.56 deg elevation is excluded, see solarpos_batch.c
+			if (fabs(ref->elevation + 0.56) < 1e-6)
+			{
+				continue;
+			}
+			max_error = fmax(max_error, fabs(angle[k] - shade_avoidance_angle(tracker_angle(ref, config), config)));
+		}
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "trackerangle_batch_%s", trackers[scenario].name);
+	add_check(name, max_error, TRACKERANGLE_TOLERANCE);
+}
+
+
+/// one angle through raw_csv_format_angle() and snprintf("%.1f"), 1 if they differ
+static int raw_csv_mismatch(double angle)
+{
+	char fast[RAW_CSV_MAX_ANGLE + 1], text[RAW_CSV_MAX_ANGLE + 1];
+	size_t n = raw_csv_format_angle(fast, angle);
+	fast[n] = '\0';
+	snprintf(text, sizeof(text), "%.1f", angle);
+	return(strcmp(fast, text) != 0);
+}
+
+
+/**
+ * @brief
+ *  raw_csv_format_angle() against snprintf("%.1f"), must match byte for byte
+ *
+ *  Covers the benchmark angles, every hundredth of a degree over the tracker
+ * range, the values either side of each of those, exact binary ties
+ * (k/20 with k odd and k/4), -0.0, small negatives that round to "-0.0", and
+ * large values. The error is the number of mismatches.
+ */
+static void check_raw_csv_format(void)
+{
+	uint64_t mismatched = 0;
+	size_t i;
+	int32_t k;
+	for (i=0; i<num_samples; i++)
+	{
+		mismatched += raw_csv_mismatch(angles[i]);
+	}
+	for (k=-18000; k<=18000; k++)
+	{
+		double angle = k / 100.0;
+		mismatched += raw_csv_mismatch(angle);
+		mismatched += raw_csv_mismatch(nextafter(angle, INFINITY));
+		mismatched += raw_csv_mismatch(nextafter(angle, -INFINITY));
+		mismatched += raw_csv_mismatch(k / 20.0);
+		mismatched += raw_csv_mismatch(k / 4.0);
+	}
+	static const double special[] = {-0.0, 0.0, -0.04, -0.05, -0.05000000001, 0.05, 0.25, -0.25, 0.35, 0.45,
+		999999999.95, 4294967295.95, 1e9, -1e9, 99999999999999.95, 1e14, 1e15 + 0.25, 1e300, -1e300};
+	for (i=0; i<sizeof(special)/sizeof(special[0]); i++)
+	{
+		mismatched += raw_csv_mismatch(special[i]);
+	}
+	for (i=0; i<num_samples; i++)
+	{
+		mismatched += raw_csv_mismatch(rand_uniform(-1e6, 1e6));
+	}
+	add_check("raw_csv_format", (double)mismatched, 0.0);
+}
+
+
+/**
+ * @brief
+ *  Parsed timestamps against solarpos_time()
+ *
+ *  Every input in the ISO 8601 form of stamps, and in the TMY3 date and time
+ * form, and the same instant as UT with a 'Z' and with an explicit offset.
+ * The error is in seconds, a timestamp that fails to parse counts as a day.
+ */
+static void check_timeseries(void)
+{
+	double max_error = 0;
+	size_t i;
+	for (i=0; i<num_samples; i++)
+	{
+		const solarpos_inputs_t *in = &inputs[i];
+		char text[4][TIMESERIES_STAMP_SIZE];
+		strcpy(text[0], stamps + i * TIMESERIES_STAMP_SIZE);
+		snprintf(text[1], sizeof(text[1]), "%02u/%02u/%04u,%02u:%02u,0", in->month, in->day, in->year, in->hour, in->minute);
+		snprintf(text[2], sizeof(text[2]), "%s:00%+03d:00", text[0], in->timezone);
+		double unix_seconds = BENCH_YEAR_UNIX + 86400.0 * (times[i] - trackerangle_time_unix(BENCH_YEAR_UNIX));
+		time_t ut = (time_t)llround(unix_seconds);
+		struct tm tm;
+		gmtime_r(&ut, &tm);
+		strftime(text[3], sizeof(text[3]), "%Y-%m-%d %H:%MZ", &tm);
+
+		int k;
+		for (k=0; k<4; k++)
+		{
+			double time;
+			const char *field_end;
+			double error = 86400.0;
+			if (timeseries_parse(text[k], text[k] + strlen(text[k]), in->timezone, &time, &field_end) == 0)
+			{
+				error = 86400.0 * fabs(time - times[i]);
+			}
+			max_error = fmax(max_error, error);
+		}
+	}
+	// dates and times that do not exist must not parse
+	static const char *invalid[] = {"2017-02-29 12:00", "2017-02-30T00:00", "2017-04-31 12:00", "1900-02-29 12:00",
+		"02/31/2017,12:00", "02/28/2017,24:59", "02/28/2017,24:00:30", "2017-06-21 24:00"};
+	for (i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+	{
+		double time;
+		const char *field_end;
+		if (timeseries_parse(invalid[i], invalid[i] + strlen(invalid[i]), 0, &time, &field_end) == 0)
+		{
+			max_error = fmax(max_error, 86400.0);
+		}
+	}
+	add_check("timeseries_parse", max_error, TIMESERIES_TOLERANCE);
+}
+
+
+/****************************************************************************/
+
+
+/**
+ * @brief
+ *  Write the results as JSON
+ *
+ * @param [in] file output file
+ */
+static void write_json(FILE *file)
+{
+	int k;
+	fprintf(file, "{\n");
+	fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+	fprintf(file, "  \"batch_isa\": \"%s\",\n", solarpos_batch_isa_name());
+	fprintf(file, "  \"seed\": %u,\n", BENCH_SEED);
+	fprintf(file, "  \"reps\": %u,\n", reps);
+	fprintf(file, "  \"samples\": %zu,\n", num_samples);
+	fprintf(file, "  \"peak_rss_kb\": %ld,\n", peak_rss_kb());
+	fprintf(file, "  \"results\": [\n");
+	for (k=0; k<num_results; k++)
+	{
+		const bench_result_t *r = &results[k];
+		fprintf(file, "    {\"name\": \"%s\", \"samples\": %" PRIu64 ", \"seconds\": %.9f, \"ns_per_sample\": %.3f, \"samples_per_s\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+			r->name, r->samples, r->seconds, 1e9 * r->seconds / r->samples, r->samples / r->seconds, r->peak_rss_kb,
+			(k + 1 < num_results) ? "," : "");
+	}
+	fprintf(file, "  ],\n");
+	fprintf(file, "  \"checks\": [\n");
+	for (k=0; k<num_checks; k++)
+	{
+		const bench_check_t *c = &checks[k];
+		fprintf(file, "    {\"name\": \"%s\", \"max_error\": %.6g, \"tolerance\": %.6g, \"pass\": %s}%s\n",
+			c->name, c->max_error, c->tolerance, (c->max_error <= c->tolerance) ? "true" : "false",
+			(k + 1 < num_checks) ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	const char *json_path = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:r:n:h")) != -1)
+	{
+		switch (opt)
+		{
+			case 'o':
+				json_path = optarg;
+				break;
+			case 'r':
+				reps = strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				num_samples = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				printf("Usage: %s [-o results.json] [-r REPS] [-n SAMPLES]\n", argv[0]);
+				exit(opt == 'h' ? 0 : 1);
+		}
+	}
+	if (reps < 1 || num_samples < 1)
+	{
+		printf("REPS and SAMPLES must be at least 1\n");
+		exit(1);
+	}
+
+	make_inputs();
+	make_plant();
+	ephemeris_init(&year_ephemeris, BENCH_YEAR);
+	ephemeris_init_f32(&year_ephemeris);
+	printf("%zu samples, best of %u runs, batch kernels %s\n\n", num_samples, reps, solarpos_batch_isa_name());
+
+	// Solar position
+	run_bench("solar_position_calc", bench_solar_position_calc, num_samples);
+	run_bench("solar_position_calc_r", bench_solar_position_calc_r, num_samples);
+	run_bench("solar_position_calc_fields", bench_solar_position_calc_fields, num_samples);
+	run_bench("solar_position_day", bench_solar_position_day, num_samples);
+	static const solarpos_isa_t isas[] = {SOLARPOS_ISA_SCALAR, SOLARPOS_ISA_SSE2, SOLARPOS_ISA_AVX2};
+	size_t k;
+	for (k=0; k<sizeof(isas)/sizeof(isas[0]); k++)
+	{
+		if (solarpos_batch_set_isa(isas[k]) != isas[k])
+		{
+			continue;	// not supported on this CPU
+		}
+		char name[64];
+		snprintf(name, sizeof(name), "solar_position_batch_%s", solarpos_batch_isa_name());
+		run_bench(name, bench_solar_position_batch, num_samples);
+		snprintf(name, sizeof(name), "solar_position_site_batch_%s", solarpos_batch_isa_name());
+		run_bench(name, bench_solar_position_site_batch, MINUTES_PER_YEAR);
+		snprintf(name, sizeof(name), "solar_position_site_batch_f32_%s", solarpos_batch_isa_name());
+		run_bench(name, bench_solar_position_site_batch_f32, MINUTES_PER_YEAR);
+	}
+	solarpos_batch_set_isa(SOLARPOS_ISA_AUTO);
+	run_bench("solar_position_step", bench_solar_position_step, num_samples);
+
+	// Tracking, per tracker scenario
+	for (k=0; k<NUM_TRACKERS; k++)
+	{
+		char name[64];
+		tracker = &trackers[k].tracker;
+		snprintf(name, sizeof(name), "tracker_angle_%s", trackers[k].name);
+		run_bench(name, bench_tracker_angle, num_samples);
+		snprintf(name, sizeof(name), "tracker_angle_vector_%s", trackers[k].name);
+		run_bench(name, bench_tracker_angle_vector, num_samples);
+		tracker_kernel_init(&kernel, tracker);
+		snprintf(name, sizeof(name), "tracker_kernel_%s", tracker_geometry_name(kernel.geometry));
+		run_bench(name, bench_tracker_kernel, num_samples);
+		snprintf(name, sizeof(name), "tracker_kernel_vector_%s", tracker_geometry_name(kernel.geometry));
+		run_bench(name, bench_tracker_kernel_vector, num_samples);
+		snprintf(name, sizeof(name), "trackerangle_batch_%s", trackers[k].name);
+		run_bench(name, bench_trackerangle_batch, num_samples);
+		snprintf(name, sizeof(name), "setpoint_angle_%s", trackers[k].name);
+		run_bench(name, bench_setpoint_angle, num_samples);
+	}
+	tracker = &trackers[0].tracker;
+	run_bench("shade_avoidance_angle", bench_shade_avoidance_angle, num_samples);
+	tracker_kernel_init(&kernel, tracker);
+	run_bench("backtrack_angle", bench_backtrack_angle, num_samples);
+	run_bench("setpoint_day", bench_setpoint_day, SETPOINT_BENCH_DAYS);
+	run_bench("tracker_incident", bench_tracker_incident, num_samples);
+	run_bench("plant_angles", bench_plant_angles, num_samples);
+	run_bench("csv_row_fprintf", bench_csv_row_fprintf, num_samples);
+	run_bench("csv_row_raw_csv", bench_csv_row_raw_csv, num_samples);
+	run_bench("timeseries_parse", bench_timeseries_parse, num_samples);
+
+	// End to end
+	run_bench("site_year", bench_site_year, MINUTES_PER_YEAR);
+	run_bench("site_year_night_skip", bench_site_year_night_skip, MINUTES_PER_YEAR);
+	run_bench("site_year_events", bench_site_year_events, MINUTES_PER_YEAR);
+
+	// Accuracy
+	printf("\n");
+	for (k=0; k<sizeof(isas)/sizeof(isas[0]); k++)
+	{
+		if (solarpos_batch_set_isa(isas[k]) == isas[k])
+		{
+			check_solar_position_batch();
+		}
+	}
+	for (k=0; k<sizeof(isas)/sizeof(isas[0]); k++)
+	{
+		if (solarpos_batch_set_isa(isas[k]) == isas[k])
+		{
+			check_solar_position_site_f32();
+		}
+	}
+	solarpos_batch_set_isa(SOLARPOS_ISA_AUTO);
+	check_allocation_free();
+	check_solar_position_fields();
+	check_solarpos_step(15, 0);
+	check_solarpos_step(SOLARPOS_STEP_ANCHOR, SOLARPOS_STEP_TOLERANCE);
+	check_solarpos_step(240, 0);
+	check_solarpos_step(SOLARPOS_STEP_MAX_ANCHOR, 0);
+	check_night_skip();
+	check_float32();
+	for (k=0; k<NUM_TRACKERS; k++)
+	{
+		check_tracker_angle_vector(k);
+		check_tracker_kernel(k);
+		check_backtrack_angle(k);
+		check_events(k);
+		check_trackerangle(k);
+		check_setpoint(k);
+	}
+	check_plant();
+	check_raw_csv_format();
+	check_timeseries();
+
+	if (json_path != NULL)
+	{
+		FILE *file = fopen(json_path, "w");
+		if (file == NULL)
+		{
+			printf("Error opening %s\n", json_path);
+			exit(1);
+		}
+		write_json(file);
+		fclose(file);
+		printf("\nResults written to %s\n", json_path);
+	}
+
+	int failed = 0;
+	int c;
+	for (c=0; c<num_checks; c++)
+	{
+		failed |= (checks[c].max_error > checks[c].tolerance);
+	}
+	exit(failed ? 1 : 0);
+}
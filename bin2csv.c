@@ -0,0 +1,136 @@
+/*
+ * Convert a binary tracker angle file (TrackerAngle_<site>.bin, see angle_file.h) back to the
+ * CSV layout main.c writes, so existing scripts can read it.
+ *
+ *     tracker_bin2csv TrackerAngle_Seattle.bin [TrackerAngle_Seattle.csv]
+ *
+ * A time in zone raster (ZoneRaster.bin, see raster_file.h) becomes one row per cell with its
+ * centre and values in percent. The CSV is written to stdout when no output file is given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "angle_file.h"
+#include "raster_file.h"
+
+static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+
+/// one row per cell: centre, % in zone, percent of time per bin
+static void raster_to_csv(const raster_file_t *file, FILE *out)
+{
+	const raster_file_header_t *header = file->header;
+	double scale = 1.0 / header->units_per_percent;
+	uint32_t r, c, j;
+	
+	fprintf(out, "LATITUDE,LONGITUDE,PERCENT_IN_ZONE");
+	for (j=1; j<header->layers; j++)
+	{
+		fprintf(out, ",BIN_%.1f", (j - 1) * header->bin_size);
+	}
+	fprintf(out, "\n");
+	
+	const uint16_t *cell = file->cells;
+	for (r=0; r<header->rows; r++)
+	{
+		for (c=0; c<header->cols; c++)
+		{
+			fprintf(out, "%.4f,%.4f", header->lat_min + (r + 0.5) * header->resolution, header->lon_min + (c + 0.5) * header->resolution);
+			for (j=0; j<header->layers; j++)
+			{
+				fprintf(out, ",%.2f", *cell++ * scale);
+			}
+			fprintf(out, "\n");
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		printf("Usage: %s input.bin [output.csv]\n", argv[0]);
+		exit(1);
+	}
+	
+	angle_file_t file;
+	raster_file_t raster;
+	int is_raster = 0;
+	if (angle_file_open(argv[1], &file) != 0)
+	{
+		if (raster_file_open(argv[1], &raster) != 0)
+		{
+			printf("Error reading angle file %s\n", argv[1]);
+			exit(1);
+		}
+		is_raster = 1;
+	}
+	
+	FILE *out = stdout;
+	if (argc == 3)
+	{
+		out = fopen(argv[2], "w");
+		if (out == NULL)
+		{
+			printf("Error opening output file %s\n", argv[2]);
+			exit(1);
+		}
+	}
+	
+	if (is_raster)
+	{
+		raster_to_csv(&raster, out);
+		if (out != stdout && fclose(out) != 0)
+		{
+			printf("Error writing output file %s\n", argv[2]);
+			exit(1);
+		}
+		raster_file_close(&raster);
+		exit(0);
+	}
+	
+	const angle_file_header_t *header = file.header;
+	uint16_t year = header->year;
+	uint8_t month = header->month - 1;	// the CSV has always used a 0-based month column
+	uint8_t day = header->day;
+	uint32_t second = (header->hour * 60 + header->minute) * 60;
+	double scale = 1.0 / header->units_per_degree;
+	
+	fprintf(out, "LOCATION,YEAR,MONTH,DAY,HOUR,MINUTE,ANGLE\n");
+	
+	uint64_t i;
+	for (i=0; i<header->count; i++)
+	{
+		fprintf(out, "%s,%02d,%02d,%02d,%02d,%02d,%.1f\n",
+			header->name, year, month, day, second / 3600, (second / 60) % 60, file.samples[i] * scale);
+		
+		// Advance the local calendar by one step
+		second += header->step_seconds;
+		while (second >= 24*3600)
+		{
+			second -= 24*3600;
+			uint8_t days = month_days[month] + ((month == 1 && year % 4 == 0) ? 1 : 0);
+			if (++day > days)
+			{
+				day = 1;
+				if (++month == 12)
+				{
+					month = 0;
+					year++;
+				}
+			}
+		}
+	}
+	
+	if (out != stdout && fclose(out) != 0)
+	{
+		printf("Error writing output file %s\n", argv[2]);
+		exit(1);
+	}
+	angle_file_close(&file);
+	
+	exit(0);
+}
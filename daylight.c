@@ -0,0 +1,98 @@
+/**
+ * @file	daylight.c
+ *
+ * @brief
+ *   Per-day daylight window used to skip night minutes
+ *
+ *  The window comes from the solar noon and declination of the day and the
+ * hour angle at which the sun crosses DAYLIGHT_HORIZON, widened by
+ * DAYLIGHT_MARGIN minutes. It is an estimate: callers evaluate the window and
+ * walk its edges outward until the minute at each edge is night, so a window
+ * that is slightly too narrow costs a few extra minutes but never changes a
+ * result. Outside the window the sun moves further below the horizon towards
+ * solar midnight, so night at the edge means night beyond it.
+ *
+ *  Polar days, and days whose window would reach past local midnight, get
+ * the whole day. Polar nights get a window of just the margins around solar
+ * noon, which the edge walk widens if refraction lifts the sun into view.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "angle_conversions.h"
+#include "daylight.h"
+
+
+/**
+ * @brief
+ *  Estimate the minutes of a local day that may have the sun up
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] year calendar year
+ * @param [in] day_of_year day of the year, 0 = 1 Jan, in local standard time
+ * @param [out] window pointer to daylight_t struct
+ */
+void daylight_estimate(const solarpos_site_t *site, uint16_t year, uint16_t day_of_year, daylight_t *window)
+{
+	uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	if (year % 4 == 0)
+	{
+		month_days[1] = 29;
+	}
+
+	// the day terms at local noon give the declination, and the mid point of
+	// sunrise and sunset is solar noon in local standard time
+	solarpos_inputs_t noon;
+	memset(&noon, 0, sizeof(noon));
+	noon.year = year;
+	noon.month = 1;
+	noon.hour = 12;
+	noon.timezone = site->timezone;
+	noon.latitude = site->latitude;
+	noon.longitude = site->longitude;
+	while (noon.month < 12 && day_of_year >= month_days[noon.month - 1])
+	{
+		day_of_year -= month_days[noon.month - 1];
+		noon.month++;
+	}
+	noon.day = day_of_year + 1;
+
+	solarpos_day_t day;
+	solar_position_day(&noon, &day);
+	double solar_noon = 0.5 * (day.sunrise + day.sunset) * 60.0;	// minutes
+
+	// half the time the sun spends above DAYLIGHT_HORIZON
+	double latrad = deg2rad(site->latitude);
+	double decrad = deg2rad(day.declination);
+	double denom = cos(latrad) * cos(decrad);
+	double arg = (sin(deg2rad(DAYLIGHT_HORIZON)) - sin(latrad) * sin(decrad)) / denom;
+	double half_day;
+	if (fabs(denom) < 1e-9 || arg <= -1.0)
+	{
+		half_day = DAYLIGHT_MINUTES_PER_DAY;	// sun never sets, or at a pole
+	}
+	else if (arg >= 1.0)
+	{
+		half_day = 0.0;							// sun never rises
+	}
+	else
+	{
+		half_day = rad2deg(acos(arg)) / 15.0 * 60.0;
+	}
+
+	double first = floor(solar_noon - half_day) - DAYLIGHT_MARGIN;
+	double end = ceil(solar_noon + half_day) + DAYLIGHT_MARGIN + 1;
+
+	// a window reaching past either midnight means yesterday's sunset or
+	// tomorrow's sunrise may fall in this local day too, evaluate all of it
+	if (first < 0 || end > DAYLIGHT_MINUTES_PER_DAY)
+	{
+		first = 0;
+		end = DAYLIGHT_MINUTES_PER_DAY;
+	}
+
+	window->first = (uint16_t)first;
+	window->end = (uint16_t)end;
+}
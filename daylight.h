@@ -0,0 +1,26 @@
+/**
+ * @file	daylight.h
+ *
+ * @brief
+ *   Header for the per-day daylight window used to skip night minutes
+ */
+
+#ifndef DAYLIGHT_H
+#define DAYLIGHT_H
+
+#include <inttypes.h>
+#include "solarpos.h"
+
+#define DAYLIGHT_MINUTES_PER_DAY	(24*60)
+#define DAYLIGHT_HORIZON			-1.0	// geometric elevation in degrees, below the -0.56 refraction step
+#define DAYLIGHT_MARGIN				20		// minutes added on each side of the estimate
+
+/// minutes [first, end) of a local day that may have the sun up, every other minute is night
+typedef struct {
+	uint16_t first;			/// first minute after local midnight that may be daylight
+	uint16_t end;			/// one past the last minute that may be daylight
+} daylight_t;
+
+void daylight_estimate(const solarpos_site_t *site, uint16_t year, uint16_t day_of_year, daylight_t *window);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file	ephemeris.c
+ *
+ * @brief
+ *   Per-minute solar ephemeris table shared by all sites
+ *
+ *  Mean longitude, anomaly, ecliptic longitude, obliquity, right ascension,
+ * declination and sidereal time depend only on the UT instant. They are
+ * computed once per minute of the year here, and every site then only needs
+ * the hour angle, elevation and azimuth step (solar_position_site_batch()).
+ *
+ * The table starts at 00:00 UT on the day before 1 Jan so that any local
+ * minute of the year, in any timezone from -24 to +24 hours, has an entry.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#include "ephemeris.h"
+
+
+/**
+ * @brief
+ *  Build the ephemeris table for a calendar year
+ *
+ * @param [out] ephemeris pointer to ephemeris_t struct to fill, release with ephemeris_free()
+ * @param [in] year calendar year, e.g. 2017
+ */
+void ephemeris_init(ephemeris_t *ephemeris, uint16_t year)
+{
+	uint16_t days = (year % 4 == 0) ? 366 : 365;
+
+	// 00:00 UT on 1 Jan, one day back is the first entry
+	solarpos_inputs_t jan1 = {0};
+	jan1.year = year;
+	jan1.month = 1;
+	jan1.day = 1;
+
+	ephemeris->year = year;
+	ephemeris->t0 = solarpos_time(&jan1) - 1.0;
+	ephemeris->n = (size_t)(days + 2) * EPHEMERIS_MINUTES_PER_DAY;
+
+	double *block = malloc(5 * ephemeris->n * sizeof(double));
+	assert(block != NULL);
+	ephemeris->terms.gmst        = block;
+	ephemeris->terms.ra          = block + 1 * ephemeris->n;
+	ephemeris->terms.sin_dec     = block + 2 * ephemeris->n;
+	ephemeris->terms.cos_dec     = block + 3 * ephemeris->n;
+	ephemeris->terms.declination = block + 4 * ephemeris->n;
+	memset(&ephemeris->terms_f32, 0, sizeof(ephemeris->terms_f32));
+
+	// one day of times at a time keeps the scratch space on the stack
+	double time[EPHEMERIS_MINUTES_PER_DAY];
+	size_t i, k;
+	for (i=0; i<ephemeris->n; i+=EPHEMERIS_MINUTES_PER_DAY)
+	{
+		for (k=0; k<EPHEMERIS_MINUTES_PER_DAY; k++)
+		{
+			time[k] = ephemeris->t0 + (double)(i + k) / EPHEMERIS_MINUTES_PER_DAY;
+		}
+
+		solarpos_ephem_t day = {
+			ephemeris->terms.gmst + i,
+			ephemeris->terms.ra + i,
+			ephemeris->terms.sin_dec + i,
+			ephemeris->terms.cos_dec + i,
+			ephemeris->terms.declination + i
+		};
+		solar_ephemeris_batch(time, EPHEMERIS_MINUTES_PER_DAY, &day);
+	}
+}
+
+
+/**
+ * @brief
+ *  Add the single precision terms solar_position_site_batch_f32() reads
+ *
+ *  Each term is rounded from the double table, so the ephemeris itself is
+ * still evaluated in double precision, once per minute for all sites.
+ *
+ * @param [in,out] ephemeris pointer to ephemeris_t struct filled by ephemeris_init()
+ */
+void ephemeris_init_f32(ephemeris_t *ephemeris)
+{
+	if (ephemeris->terms_f32.gmst != NULL)
+	{
+		return;
+	}
+
+	float *block = malloc(4 * ephemeris->n * sizeof(float));
+	assert(block != NULL);
+	ephemeris->terms_f32.gmst    = block;
+	ephemeris->terms_f32.ra      = block + 1 * ephemeris->n;
+	ephemeris->terms_f32.sin_dec = block + 2 * ephemeris->n;
+	ephemeris->terms_f32.cos_dec = block + 3 * ephemeris->n;
+
+	size_t i;
+	for (i=0; i<ephemeris->n; i++)
+	{
+		ephemeris->terms_f32.gmst[i]    = (float)ephemeris->terms.gmst[i];
+		ephemeris->terms_f32.ra[i]      = (float)ephemeris->terms.ra[i];
+		ephemeris->terms_f32.sin_dec[i] = (float)ephemeris->terms.sin_dec[i];
+		ephemeris->terms_f32.cos_dec[i] = (float)ephemeris->terms.cos_dec[i];
+	}
+}
+
+
+/**
+ * @brief
+ *  Release the memory held by an ephemeris table
+ *
+ * @param [in] ephemeris pointer to ephemeris_t struct filled by ephemeris_init()
+ */
+void ephemeris_free(ephemeris_t *ephemeris)
+{
+	free(ephemeris->terms.gmst);	// all terms share one allocation
+	ephemeris->terms.gmst = NULL;
+	ephemeris->terms.ra = NULL;
+	ephemeris->terms.sin_dec = NULL;
+	ephemeris->terms.cos_dec = NULL;
+	ephemeris->terms.declination = NULL;
+	free(ephemeris->terms_f32.gmst);
+	memset(&ephemeris->terms_f32, 0, sizeof(ephemeris->terms_f32));
+	ephemeris->n = 0;
+}
+
+
+/**
+ * @brief
+ *  Table index of a local standard time
+ *
+ * @param [in] ephemeris pointer to ephemeris_t struct
+ * @param [in] timezone time zone in hours, west longitudes negative
+ * @param [in] local_minute minutes since 00:00 local standard time on 1 Jan
+ *
+ * @return index into the ephemeris terms
+ */
+size_t ephemeris_local_index(const ephemeris_t *ephemeris, int8_t timezone, uint32_t local_minute)
+{
+	int64_t index = EPHEMERIS_MINUTES_PER_DAY + (int64_t)local_minute - 60 * (int64_t)timezone;
+	assert(index >= 0 && (size_t)index < ephemeris->n);
+
+	return((size_t)index);
+}
@@ -0,0 +1,32 @@
+/**
+ * @file	ephemeris.h
+ *
+ * @brief
+ *   Header for the per-minute solar ephemeris table shared by all sites
+ */
+
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "solarpos.h"
+#include "solarpos_batch.h"
+
+#define EPHEMERIS_MINUTES_PER_DAY	(24*60)
+
+/// site independent solar terms for every UT minute of a year, plus one day either side
+typedef struct {
+	uint16_t year;				/// Calendar year the table covers
+	double t0;					/// time of entry 0 in days referenced from noon 1 Jan 2000 UT
+	size_t n;					/// number of one minute entries
+	solarpos_ephem_t terms;		/// n entries of each term
+	solarpos_ephem_f32_t terms_f32;	/// single precision copy from ephemeris_init_f32(), NULL until then
+} ephemeris_t;
+
+void ephemeris_init(ephemeris_t *ephemeris, uint16_t year);
+void ephemeris_init_f32(ephemeris_t *ephemeris);
+void ephemeris_free(ephemeris_t *ephemeris);
+size_t ephemeris_local_index(const ephemeris_t *ephemeris, int8_t timezone, uint32_t local_minute);
+
+#endif
@@ -0,0 +1,539 @@
+/**
+ * @file	events.c
+ *
+ * @brief
+ *   Event-based time-in-zone engine
+ *
+ *  Instead of sampling every minute, the time the backtracked angle spends in
+ * each bin is accumulated from the instants it crosses the bin edges.
+ *
+ *  The backtracked angle is a function of the ideal angle alone, with three
+ * monotone branches: backtracking from 0 towards -cutoff in the morning, the
+ * ideal angle itself between -cutoff and +cutoff, and backtracking from
+ * +cutoff back to 0 in the evening, all clamped to the range of motion. So
+ * each bin edge maps to at most two ideal angles (targets), found once per
+ * tracker by events_init(). The ideal angle is smooth over the day, so each
+ * crossing of a target is bracketed between solar position samples
+ * EVENTS_NODE_MINUTES apart and refined with regula falsi to within
+ * EVENTS_TOLERANCE. Sunrise and sunset are found the same way, by bisection
+ * on zenith < 90 as in the per-minute calculation.
+ *
+ *  Between two consecutive known points (samples or crossings) the ideal
+ * angle stays between two adjacent targets, so the backtracked angle at the
+ * mid point of the two known values decides the bin for that whole span.
+ *
+ *  A crossing is missed if the ideal angle crosses the same target twice
+ * within one sample spacing, which does not happen for a single-axis tracker
+ * whose angle sweeps once from east to west over the day.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "solarpos_batch.h"
+#include "daylight.h"
+#include "events.h"
+
+#define EVENTS_MAX_NODES	(DAYLIGHT_MINUTES_PER_DAY / EVENTS_NODE_MINUTES + 2)
+#define EVENTS_MAX_REFINE	512			// extra samples around turning points and jumps per day
+#define EVENTS_MAX_SPAN		(EVENTS_MAX_NODES + EVENTS_MAX_REFINE)
+#define EVENTS_MAX_POINTS	(2 * EVENTS_MAX_SPAN + EVENTS_MAX_TARGETS)
+#define EVENTS_MAX_ITER		60
+#define EVENTS_MAX_KNOWN	64			// points kept per gap to bracket later crossings
+#define EVENTS_REFINE_MINUTES	0.25	// sample spacing around turning points and jumps
+#define EVENTS_MAX_STEP		45.0		// degrees between samples above which the ideal angle jumped
+
+/// a time of day with the ideal angle there, or night
+typedef struct {
+	double minute;		/// minutes after local midnight
+	double angle;		/// ideal tracker angle in degrees, daylight only
+	int day;			/// sun up
+} events_point_t;
+
+/// one day at one site
+typedef struct {
+	const events_t *events;
+	const solarpos_site_t *site;
+	double midnight;	/// solarpos_time() of local 00:00
+	uint64_t evaluations;
+} events_ctx_t;
+
+
+/// solar position and ideal angle for n times of the day
+static void evaluate(events_ctx_t *ctx, const double *minute, size_t n, events_point_t *point)
+{
+	double time[EVENTS_MAX_NODES] = {0}, azimuth[EVENTS_MAX_NODES], zenith[EVENTS_MAX_NODES];
+	double elevation[EVENTS_MAX_NODES], declination[EVENTS_MAX_NODES];
+	size_t k;
+
+	for (k=0; k<n; k++)
+	{
+		time[k] = ctx->midnight + minute[k] / DAYLIGHT_MINUTES_PER_DAY;
+	}
+	solarpos_batch_t batch = {azimuth, zenith, elevation, declination};
+	solar_position_batch(ctx->site, time, n, &batch);
+	ctx->evaluations += n;
+
+	const tracker_kernel_t *kernel = ctx->events->kernel;
+	for (k=0; k<n; k++)
+	{
+		point[k].minute = minute[k];
+		point[k].day = (zenith[k] < 90.0);
+		point[k].angle = 0;
+		if (point[k].day)
+		{
+			solarpos_t solarpos = {0};
+			solarpos.azimuth = azimuth[k];
+			solarpos.zenith = zenith[k];
+			point[k].angle = kernel->angle(kernel, &solarpos);
+		}
+	}
+}
+
+
+/// sunrise or sunset between a night and a day point, returns the first or last daylight point
+static events_point_t find_horizon(events_ctx_t *ctx, events_point_t night, events_point_t day)
+{
+	while (fabs(day.minute - night.minute) > EVENTS_TOLERANCE)
+	{
+		double mid = 0.5 * (day.minute + night.minute);
+		events_point_t point;
+		evaluate(ctx, &mid, 1, &point);
+		if (point.day)
+		{
+			day = point;
+		}
+		else
+		{
+			night = point;
+		}
+	}
+	return(day);
+}
+
+
+/**
+ * Time the ideal angle crosses target within a gap between two daylight
+ * samples. known holds the points evaluated in the gap so far in time order,
+ * starting with its two ends; the points evaluated here are added to it, so
+ * later targets in the same gap start from a tighter bracket.
+ */
+static double find_crossing(events_ctx_t *ctx, events_point_t *known, size_t *num_known, double target)
+{
+	// tightest bracket from what is known
+	size_t k = 0;
+	while (k+2 < *num_known && (known[k+1].angle - target < 0) == (known[0].angle - target < 0))
+	{
+		k++;
+	}
+	events_point_t a = known[k], b = known[k+1];
+	double fa = a.angle - target;
+	double fb = b.angle - target;
+	double minute = 0.5 * (a.minute + b.minute);
+	double last = a.minute;
+	int side = 0, iter;
+
+	// regula falsi, Illinois variant, done once a step moves less than the tolerance
+	for (iter=0; iter<EVENTS_MAX_ITER && b.minute - a.minute > EVENTS_TOLERANCE; iter++)
+	{
+		minute = (a.minute * fb - b.minute * fa) / (fb - fa);
+		if (!(minute > a.minute && minute < b.minute))
+		{
+			minute = 0.5 * (a.minute + b.minute);
+		}
+		if (fabs(minute - last) < EVENTS_TOLERANCE)
+		{
+			break;
+		}
+		last = minute;
+
+		events_point_t c;
+		evaluate(ctx, &minute, 1, &c);
+		if (!c.day)
+		{
+			break;
+		}
+		int inserted = (*num_known < EVENTS_MAX_KNOWN);
+		if (inserted)
+		{
+			k++;
+			memmove(&known[k+1], &known[k], (*num_known - k) * sizeof(events_point_t));
+			known[k] = c;
+			(*num_known)++;
+		}
+
+		double fc = c.angle - target;
+		if (fc == 0)
+		{
+			break;
+		}
+		if ((fc < 0) == (fb < 0))
+		{
+			b = c;
+			fb = fc;
+			if (side == -1)
+			{
+				fa *= 0.5;
+			}
+			side = -1;
+			k -= inserted;
+		}
+		else
+		{
+			a = c;
+			fa = fc;
+			if (side == 1)
+			{
+				fb *= 0.5;
+			}
+			side = 1;
+		}
+	}
+	return(minute);
+}
+
+
+/// add minutes at backtracked angle to the summary
+static void accumulate(const events_t *events, events_summary_t *summary, double angle_w_sa, double minutes)
+{
+	uint32_t bin = (uint32_t)(floor(fabs(angle_w_sa)) / events->bin_size);
+	if (bin >= events->num_bins)
+	{
+		bin = events->num_bins - 1;
+	}
+	summary->bin_minutes[bin] += minutes;
+	if (angle_w_sa >= events->zone_min && angle_w_sa < events->zone_max)
+	{
+		summary->zone_minutes += minutes;
+	}
+	summary->total_minutes += minutes;
+}
+
+
+static int compare_points(const void *a, const void *b)
+{
+	double x = ((const events_point_t *)a)->minute;
+	double y = ((const events_point_t *)b)->minute;
+	return((x > y) - (x < y));
+}
+
+
+/// true if the ideal angle turns around or jumps next to the gap after span[k]
+static int suspect_gap(const events_point_t *span, size_t n, size_t k)
+{
+	double step = span[k+1].angle - span[k].angle;
+	if (fabs(step) > EVENTS_MAX_STEP)
+	{
+		return(1);
+	}
+	if (k > 0 && (step > 0) != (span[k].angle - span[k-1].angle > 0))
+	{
+		return(1);
+	}
+	if (k+2 < n && (step > 0) != (span[k+2].angle - span[k+1].angle > 0))
+	{
+		return(1);
+	}
+	return(0);
+}
+
+
+/**
+ * Sample more finely where the ideal angle turns around or wraps, so no target
+ * is crossed twice between two samples. In polar summer the sun circles the
+ * sky and the angle turns around, and tilted or rotated axes can wrap past
+ * +/- 180 degrees. Returns the new number of points.
+ */
+static size_t refine_span(events_ctx_t *ctx, events_point_t *span, size_t n)
+{
+	int changed = 1;
+	while (changed)
+	{
+		changed = 0;
+		size_t k;
+		for (k=0; k+1<n && n<EVENTS_MAX_SPAN; k++)
+		{
+			if (span[k+1].minute - span[k].minute <= EVENTS_REFINE_MINUTES || !suspect_gap(span, n, k))
+			{
+				continue;
+			}
+			double mid = 0.5 * (span[k].minute + span[k+1].minute);
+			events_point_t point;
+			evaluate(ctx, &mid, 1, &point);
+			if (!point.day)
+			{
+				continue;	// grazing the horizon, left to the coarse samples
+			}
+			memmove(&span[k+2], &span[k+1], (n - k - 1) * sizeof(events_point_t));
+			span[k+1] = point;
+			n++;
+			k++;
+			changed = 1;
+		}
+	}
+	return(n);
+}
+
+
+/// accumulate the daylight span between points[0] and points[n-1], all day points in time order
+static void daylight_span(events_ctx_t *ctx, events_point_t *node, size_t n, events_summary_t *summary)
+{
+	const events_t *events = ctx->events;
+	events_point_t points[EVENTS_MAX_POINTS];
+	size_t num_points = 0, k, j;
+
+	n = refine_span(ctx, node, n);
+
+	for (k=0; k+1<n; k++)
+	{
+		points[num_points++] = node[k];
+		if (fabs(node[k+1].angle - node[k].angle) > EVENTS_MAX_STEP)
+		{
+			// the ideal angle wrapped past +/- 180, split the short gap between the two sides
+			double half = 0.5 * (node[k+1].minute - node[k].minute);
+			accumulate(events, summary, backtrack_angle(&events->kernel->backtrack, node[k].angle), half);
+			accumulate(events, summary, backtrack_angle(&events->kernel->backtrack, node[k+1].angle), half);
+			continue;
+		}
+		double lo = fmin(node[k].angle, node[k+1].angle);
+		double hi = fmax(node[k].angle, node[k+1].angle);
+		events_point_t known[EVENTS_MAX_KNOWN] = {node[k], node[k+1]};
+		size_t num_known = 2;
+		for (j=0; j<events->num_targets && num_points < EVENTS_MAX_POINTS - 1; j++)
+		{
+			double target = events->targets[j];
+			if (target > lo && target < hi)
+			{
+				points[num_points].minute = find_crossing(ctx, known, &num_known, target);
+				points[num_points].angle = target;
+				points[num_points].day = 1;
+				num_points++;
+			}
+		}
+	}
+	points[num_points++] = node[n-1];
+	qsort(points, num_points, sizeof(events_point_t), compare_points);
+
+	for (k=0; k+1<num_points; k++)
+	{
+		double minutes = points[k+1].minute - points[k].minute;
+		if (minutes > 0 && fabs(points[k+1].angle - points[k].angle) <= EVENTS_MAX_STEP)
+		{
+			double angle = 0.5 * (points[k].angle + points[k+1].angle);
+			accumulate(events, summary, backtrack_angle(&events->kernel->backtrack, angle), minutes);
+		}
+	}
+}
+
+
+/// ideal angles in [lo, hi] where backtracking gives edge, g decreasing from g(lo) to g(hi)
+static double invert_backtrack(const backtrack_table_t *table, double lo, double hi, double edge)
+{
+	int iter;
+	for (iter=0; iter<100; iter++)
+	{
+		double mid = 0.5 * (lo + hi);
+		if (backtrack_exact(table, mid) > edge)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return(0.5 * (lo + hi));
+}
+
+
+static void add_target(events_t *events, double target)
+{
+	size_t k;
+	for (k=0; k<events->num_targets; k++)
+	{
+		if (events->targets[k] == target)
+		{
+			return;
+		}
+	}
+	if (events->num_targets < EVENTS_MAX_TARGETS)
+	{
+		events->targets[events->num_targets++] = target;
+	}
+}
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return((x > y) - (x < y));
+}
+
+
+/// the ideal angles at which the backtracked angle equals edge
+static void add_edge(events_t *events, double edge)
+{
+	const backtrack_table_t *table = &events->kernel->backtrack;
+	double cutoff = table->cutoff;
+
+	if (fabs(edge) <= cutoff)
+	{
+		add_target(events, edge);
+	}
+	if (edge < 0 && edge > -cutoff)
+	{
+		// morning branch, backtracking from 0 at -90 to -cutoff
+		add_target(events, invert_backtrack(table, -90.0, -cutoff, edge));
+	}
+	if (edge > 0 && edge < cutoff)
+	{
+		// evening branch, backtracking from +cutoff down to 0 at +90
+		add_target(events, invert_backtrack(table, cutoff, 90.0, edge));
+	}
+}
+
+
+/**
+ * @brief
+ *  Set up the event engine for one tracker
+ *
+ *  Bin edges are every bin_size degrees by |angle|, the zone edges and the
+ * range of motion limits. The summary bins match the per-minute summary:
+ * bin = floor(|angle|) / bin_size.
+ *
+ * @param [out] events pointer to events_t struct
+ * @param [in] kernel pointer to tracker_kernel_t struct, must outlive events
+ * @param [in] zone_min lower zone edge in degrees
+ * @param [in] zone_max upper zone edge in degrees
+ * @param [in] bin_size summary bin width in degrees
+ * @param [in] num_bins number of summary bins
+ */
+void events_init(events_t *events, const tracker_kernel_t *kernel, double zone_min, double zone_max, double bin_size, uint32_t num_bins)
+{
+	memset(events, 0, sizeof(*events));
+	events->kernel = kernel;
+	events->zone_min = zone_min;
+	events->zone_max = zone_max;
+	events->bin_size = bin_size;
+	events->num_bins = num_bins;
+	events->stow_angle = backtrack_angle(&kernel->backtrack, kernel->night_stow);
+
+	uint32_t j;
+	for (j=1; j<num_bins; j++)
+	{
+		add_edge(events, j * bin_size);
+		add_edge(events, -(j * bin_size));
+	}
+	add_edge(events, zone_min);
+	add_edge(events, zone_max);
+	add_edge(events, kernel->backtrack.rom);
+	add_edge(events, -kernel->backtrack.rom);
+
+	qsort(events->targets, events->num_targets, sizeof(double), compare_doubles);
+}
+
+
+/**
+ * @brief
+ *  Accumulate the time in each bin over one local day
+ *
+ *  Covers minutes [0, 1440) of the day in continuous time, with the sun up
+ * while zenith < 90 degrees and the tracker at its night stow otherwise.
+ *
+ * @param [in] events pointer to events_t struct from events_init()
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] year calendar year
+ * @param [in] day_of_year day of the year, 0 = 1 Jan, in local standard time
+ * @param [in,out] summary pointer to events_summary_t struct to add the day to
+ */
+void events_day(const events_t *events, const solarpos_site_t *site, uint16_t year, uint16_t day_of_year, events_summary_t *summary)
+{
+	solarpos_inputs_t jan1;
+	memset(&jan1, 0, sizeof(jan1));
+	jan1.year = year;
+	jan1.month = 1;
+	jan1.day = 1;
+	jan1.timezone = site->timezone;
+
+	events_ctx_t ctx;
+	ctx.events = events;
+	ctx.site = site;
+	ctx.midnight = solarpos_time(&jan1) + day_of_year;
+	ctx.evaluations = 0;
+
+	// Samples over the daylight window, widened until both edges are night
+	daylight_t window;
+	daylight_estimate(site, year, day_of_year, &window);
+	double first = window.first, end = window.end;
+	events_point_t node[EVENTS_MAX_NODES];
+	size_t n, k;
+	while (1)
+	{
+		n = (size_t)ceil((end - first) / EVENTS_NODE_MINUTES) + 1;
+		double minute[EVENTS_MAX_NODES];
+		for (k=0; k<n; k++)
+		{
+			minute[k] = first + (end - first) * k / (n - 1);
+		}
+		evaluate(&ctx, minute, n, node);
+
+		if (node[0].day && first > 0)
+		{
+			first = fmax(0.0, first - EVENTS_NODE_MINUTES);
+		}
+		else if (node[n-1].day && end < DAYLIGHT_MINUTES_PER_DAY)
+		{
+			end = fmin((double)DAYLIGHT_MINUTES_PER_DAY, end + EVENTS_NODE_MINUTES);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// Night before the first sample and after the last one
+	accumulate(events, summary, events->stow_angle, first + (DAYLIGHT_MINUTES_PER_DAY - end));
+
+	// Walk the samples, splitting them into night and daylight spans at sunrise and sunset
+	events_point_t span[EVENTS_MAX_SPAN];
+	size_t span_n = 0;
+	for (k=0; k<n; k++)
+	{
+		if (k > 0 && node[k].day != node[k-1].day)
+		{
+			if (node[k].day)
+			{
+				events_point_t rise = find_horizon(&ctx, node[k-1], node[k]);
+				accumulate(events, summary, events->stow_angle, rise.minute - node[k-1].minute);
+				span[span_n++] = rise;
+			}
+			else
+			{
+				events_point_t set = find_horizon(&ctx, node[k], node[k-1]);
+				span[span_n++] = set;
+				daylight_span(&ctx, span, span_n, summary);
+				span_n = 0;
+				accumulate(events, summary, events->stow_angle, node[k].minute - set.minute);
+			}
+		}
+		else if (k > 0 && !node[k].day)
+		{
+			accumulate(events, summary, events->stow_angle, node[k].minute - node[k-1].minute);
+		}
+
+		if (node[k].day)
+		{
+			span[span_n++] = node[k];
+		}
+	}
+	if (span_n > 0)
+	{
+		daylight_span(&ctx, span, span_n, summary);
+	}
+
+	summary->evaluations += ctx.evaluations;
+	summary->days++;
+}
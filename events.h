@@ -0,0 +1,44 @@
+/**
+ * @file	events.h
+ *
+ * @brief
+ *   Header for the event-based time-in-zone engine
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "solarpos.h"
+#include "tracking_algorithm.h"
+
+#define EVENTS_NODE_MINUTES		30			// spacing of the solar position samples that bracket each event
+#define EVENTS_TOLERANCE		(1.0 / 60)	// minutes, events are located to within one second
+#define EVENTS_MAX_TARGETS		256
+
+/// what to measure for one tracker, see events_init()
+typedef struct {
+	const tracker_kernel_t *kernel;		/// tracker, its night stow and backtracking
+	double zone_min;					/// zone of interest [zone_min, zone_max) in degrees
+	double zone_max;
+	double bin_size;					/// summary bin width by |angle| in degrees
+	uint32_t num_bins;					/// summary bins, the last one also holds anything larger
+	double stow_angle;					/// backtracked night stow angle
+	size_t num_targets;
+	double targets[EVENTS_MAX_TARGETS];	/// ideal angles at which the backtracked angle crosses an edge, ascending
+} events_t;
+
+/// time in each bin, accumulated over the days passed to events_day()
+typedef struct {
+	double *bin_minutes;				/// caller-owned, num_bins entries, zero before the first day
+	double zone_minutes;				/// time in [zone_min, zone_max)
+	double total_minutes;				/// time covered, 1440 per day
+	uint64_t evaluations;				/// solar positions evaluated
+	uint32_t days;						/// days accumulated
+} events_summary_t;
+
+void events_init(events_t *events, const tracker_kernel_t *kernel, double zone_min, double zone_max, double bin_size, uint32_t num_bins);
+void events_day(const events_t *events, const solarpos_site_t *site, uint16_t year, uint16_t day_of_year, events_summary_t *summary);
+
+#endif
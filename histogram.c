@@ -0,0 +1,315 @@
+/**
+ * @file	histogram.c
+ *
+ * @brief
+ *   Signed, fine grained tracker angle histogram
+ *
+ *  Angles are counted into narrow signed bins (0.1 deg by default) instead of
+ * the 5 deg |angle| bins of the summary files. Once the prefix sums are built
+ * the time spent in any angle range, or a coarser binning of the whole
+ * histogram, is answered from the prefix sums without revisiting the year.
+ * Range ends are snapped to the nearest bin edge.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#include "histogram.h"
+
+#define HISTOGRAM_HEADER	"LOCATION,ANGLE_MIN,ANGLE_MAX,COUNT,CUMULATIVE\n"
+
+
+static void alloc_bins(angle_histogram_t *hist)
+{
+	hist->counts = calloc(hist->num_bins, sizeof(uint64_t));
+	hist->cumulative = calloc(hist->num_bins + 1, sizeof(uint64_t));
+	assert(hist->counts != NULL && hist->cumulative != NULL);
+}
+
+
+/**
+ * @brief
+ *  Set up an empty histogram covering [min, max]
+ *
+ * @param [out] hist pointer to angle_histogram_t struct, release with angle_histogram_free()
+ * @param [in] min lowest angle in degrees, e.g. -rom
+ * @param [in] max highest angle in degrees, e.g. +rom
+ * @param [in] bin_size bin width in degrees
+ */
+void angle_histogram_init(angle_histogram_t *hist, double min, double max, double bin_size)
+{
+	hist->min = min;
+	hist->bin_size = bin_size;
+	hist->num_bins = (uint32_t)ceil((max - min) / bin_size - 1e-9);
+	if (hist->num_bins == 0)
+	{
+		hist->num_bins = 1;
+	}
+	alloc_bins(hist);
+}
+
+
+/**
+ * @brief
+ *  Release the memory held by a histogram
+ *
+ * @param [in] hist pointer to angle_histogram_t struct
+ */
+void angle_histogram_free(angle_histogram_t *hist)
+{
+	free(hist->counts);
+	free(hist->cumulative);
+	hist->counts = NULL;
+	hist->cumulative = NULL;
+	hist->num_bins = 0;
+}
+
+
+/**
+ * @brief
+ *  Zero the counts of a histogram so it can be reused with the same binning
+ *
+ * @param [in,out] hist pointer to angle_histogram_t struct
+ */
+void angle_histogram_clear(angle_histogram_t *hist)
+{
+	memset(hist->counts, 0, hist->num_bins * sizeof(uint64_t));
+	memset(hist->cumulative, 0, (hist->num_bins + 1) * sizeof(uint64_t));
+}
+
+
+/**
+ * @brief
+ *  Add the counts of one histogram to another with the same binning
+ *
+ * @param [in,out] dst pointer to angle_histogram_t struct receiving the counts
+ * @param [in] src pointer to angle_histogram_t struct, same min, bin_size and num_bins as dst
+ */
+void angle_histogram_merge(angle_histogram_t *dst, const angle_histogram_t *src)
+{
+	assert(dst->num_bins == src->num_bins);
+
+	uint32_t k;
+	for (k=0; k<dst->num_bins; k++)
+	{
+		dst->counts[k] += src->counts[k];
+	}
+}
+
+
+/**
+ * @brief
+ *  Build the prefix sums, required before any query
+ *
+ * @param [in,out] hist pointer to angle_histogram_t struct
+ */
+void angle_histogram_finalize(angle_histogram_t *hist)
+{
+	uint32_t k;
+	hist->cumulative[0] = 0;
+	for (k=0; k<hist->num_bins; k++)
+	{
+		hist->cumulative[k+1] = hist->cumulative[k] + hist->counts[k];
+	}
+}
+
+
+/**
+ * @brief
+ *  Total number of samples in a finalized histogram
+ *
+ * @param [in] hist pointer to angle_histogram_t struct
+ *
+ * @return number of samples
+ */
+uint64_t angle_histogram_total(const angle_histogram_t *hist)
+{
+	return(hist->cumulative[hist->num_bins]);
+}
+
+
+/// nearest bin edge to an angle, clamped to the histogram
+static uint32_t edge_index(const angle_histogram_t *hist, double angle)
+{
+	double k = round((angle - hist->min) / hist->bin_size);
+	if (k < 0.0)
+	{
+		return(0);
+	}
+	if (k > hist->num_bins)
+	{
+		return(hist->num_bins);
+	}
+	return((uint32_t)k);
+}
+
+
+/**
+ * @brief
+ *  Number of samples with an angle in [a, b), constant time
+ *
+ *  a and b are snapped to the nearest bin edge. The last bin also holds any
+ * sample at exactly the top of the range (e.g. +rom).
+ *
+ * @param [in] hist pointer to a finalized angle_histogram_t struct
+ * @param [in] a lower end of the range in degrees
+ * @param [in] b upper end of the range in degrees
+ *
+ * @return number of samples in the range
+ */
+uint64_t angle_histogram_count_range(const angle_histogram_t *hist, double a, double b)
+{
+	uint32_t lo = edge_index(hist, a);
+	uint32_t hi = edge_index(hist, b);
+	if (hi <= lo)
+	{
+		return(0);
+	}
+	return(hist->cumulative[hi] - hist->cumulative[lo]);
+}
+
+
+/**
+ * @brief
+ *  Fraction of samples with an angle in [a, b), constant time
+ *
+ * @param [in] hist pointer to a finalized angle_histogram_t struct
+ * @param [in] a lower end of the range in degrees
+ * @param [in] b upper end of the range in degrees
+ *
+ * @return fraction of samples (0-1) in the range
+ */
+double angle_histogram_fraction(const angle_histogram_t *hist, double a, double b)
+{
+	uint64_t total = angle_histogram_total(hist);
+	if (total == 0)
+	{
+		return(0.0);
+	}
+	return((double)angle_histogram_count_range(hist, a, b) / total);
+}
+
+
+/**
+ * @brief
+ *  Re-bin a histogram to a coarser bin size, constant time per output bin
+ *
+ *  The bin size must be a positive whole multiple of the input bin size, so
+ * every output bin covers the same number of input bins. Output bins start at
+ * the same min as the input.
+ *
+ * @param [in] hist pointer to a finalized angle_histogram_t struct
+ * @param [in] bin_size output bin width in degrees
+ * @param [out] out pointer to angle_histogram_t struct, finalized, release with angle_histogram_free()
+ *
+ * @return 0 on success, -1 if bin_size is not a positive multiple of the input bin size, out is untouched
+ */
+int angle_histogram_rebin(const angle_histogram_t *hist, double bin_size, angle_histogram_t *out)
+{
+	double ratio = bin_size / hist->bin_size;
+	if (!(ratio >= 1.0 - 1e-9) || !isfinite(ratio) || fabs(ratio - round(ratio)) > 1e-9 * ratio)
+	{
+		return(-1);
+	}
+
+	angle_histogram_init(out, hist->min, hist->min + hist->num_bins * hist->bin_size, bin_size);
+
+	uint32_t k;
+	for (k=0; k<out->num_bins; k++)
+	{
+		out->counts[k] = angle_histogram_count_range(hist, out->min + k * bin_size, out->min + (k+1) * bin_size);
+	}
+	angle_histogram_finalize(out);
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Write a finalized histogram as CSV, one row per bin
+ *
+ * @param [in] hist pointer to a finalized angle_histogram_t struct
+ * @param [in] name location name for the LOCATION column
+ * @param [in] file open output file
+ */
+void angle_histogram_write(const angle_histogram_t *hist, const char *name, FILE *file)
+{
+	uint32_t k;
+	fprintf(file, HISTOGRAM_HEADER);
+	for (k=0; k<hist->num_bins; k++)
+	{
+		fprintf(file, "%s,%.4f,%.4f,%" PRIu64 ",%" PRIu64 "\n",
+			name, hist->min + k * hist->bin_size, hist->min + (k+1) * hist->bin_size,
+			hist->counts[k], hist->cumulative[k+1]);
+	}
+}
+
+
+/**
+ * @brief
+ *  Read a histogram written by angle_histogram_write()
+ *
+ * @param [out] hist pointer to angle_histogram_t struct, finalized, release with angle_histogram_free()
+ * @param [in] file open input file
+ *
+ * @return 0 on success, -1 if the file is not a histogram
+ */
+int angle_histogram_read(angle_histogram_t *hist, FILE *file)
+{
+	char line[256];
+	if (fgets(line, sizeof(line), file) == NULL || strcmp(line, HISTOGRAM_HEADER) != 0)
+	{
+		return(-1);
+	}
+
+	uint32_t capacity = 1024, n = 0;
+	uint64_t *counts = malloc(capacity * sizeof(uint64_t));
+	assert(counts != NULL);
+	double min = 0, bin_size = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		// the location name is skipped, it may not contain a comma
+		char *p = strchr(line, ',');
+		double lo, hi;
+		uint64_t count;
+		if (p == NULL || sscanf(p + 1, "%lf,%lf,%" SCNu64, &lo, &hi, &count) != 3)
+		{
+			free(counts);
+			return(-1);
+		}
+		if (n == 0)
+		{
+			// undo the rounding of the 4 decimal text format
+			min = lo;
+			bin_size = round((hi - lo) * 1e4) / 1e4;
+		}
+		if (n == capacity)
+		{
+			capacity *= 2;
+			counts = realloc(counts, capacity * sizeof(uint64_t));
+			assert(counts != NULL);
+		}
+		counts[n++] = count;
+	}
+
+	if (n == 0 || bin_size <= 0.0)
+	{
+		free(counts);
+		return(-1);
+	}
+
+	hist->min = min;
+	hist->bin_size = bin_size;
+	hist->num_bins = n;
+	alloc_bins(hist);
+	memcpy(hist->counts, counts, n * sizeof(uint64_t));
+	free(counts);
+	angle_histogram_finalize(hist);
+
+	return(0);
+}
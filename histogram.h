@@ -0,0 +1,83 @@
+/**
+ * @file	histogram.h
+ *
+ * @brief
+ *   Header for the signed, fine grained tracker angle histogram
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define HISTOGRAM_BIN_SIZE	0.1		// default bin size in degrees
+
+/// angle histogram over [min, min + num_bins * bin_size), bin k is [min + k*bin_size, min + (k+1)*bin_size)
+typedef struct {
+	double min;					/// lower edge of bin 0 in degrees
+	double bin_size;			/// width of each bin in degrees
+	uint32_t num_bins;			/// number of bins
+	uint64_t *counts;			/// num_bins counts
+	uint64_t *cumulative;		/// num_bins + 1 prefix sums, cumulative[k] is the sum of counts[0 .. k-1]
+} angle_histogram_t;
+
+void angle_histogram_init(angle_histogram_t *hist, double min, double max, double bin_size);
+void angle_histogram_free(angle_histogram_t *hist);
+void angle_histogram_clear(angle_histogram_t *hist);
+void angle_histogram_merge(angle_histogram_t *dst, const angle_histogram_t *src);
+void angle_histogram_finalize(angle_histogram_t *hist);
+uint64_t angle_histogram_total(const angle_histogram_t *hist);
+uint64_t angle_histogram_count_range(const angle_histogram_t *hist, double a, double b);
+double angle_histogram_fraction(const angle_histogram_t *hist, double a, double b);
+int angle_histogram_rebin(const angle_histogram_t *hist, double bin_size, angle_histogram_t *out);
+void angle_histogram_write(const angle_histogram_t *hist, const char *name, FILE *file);
+int angle_histogram_read(angle_histogram_t *hist, FILE *file);
+
+
+/**
+ * @brief
+ *  Count one angle n times, values outside the histogram go to the first or last bin
+ *
+ *  Only counts[] is updated, call angle_histogram_finalize() before querying.
+ *
+ * @param [in] hist pointer to angle_histogram_t struct
+ * @param [in] angle angle in degrees
+ * @param [in] n number of times to count it
+ */
+static inline void angle_histogram_add_n(angle_histogram_t *hist, double angle, uint64_t n)
+{
+	double k = (angle - hist->min) / hist->bin_size;
+	uint32_t bin;
+
+	if (k < 0.0)
+	{
+		bin = 0;
+	}
+	else if (k >= hist->num_bins)
+	{
+		bin = hist->num_bins - 1;
+	}
+	else
+	{
+		bin = (uint32_t)k;
+	}
+	hist->counts[bin] += n;
+}
+
+
+/**
+ * @brief
+ *  Count one angle, values outside the histogram go to the first or last bin
+ *
+ *  Only counts[] is updated, call angle_histogram_finalize() before querying.
+ *
+ * @param [in] hist pointer to angle_histogram_t struct
+ * @param [in] angle angle in degrees
+ */
+static inline void angle_histogram_add(angle_histogram_t *hist, double angle)
+{
+	angle_histogram_add_n(hist, angle, 1);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Answer questions about a saved AngleHistogram_<site>.csv without re-running the year.
+ *
+ *     tracker_histq AngleHistogram_Seattle.csv -5 5      percent of time with -5 <= angle < 5
+ *     tracker_histq AngleHistogram_Seattle.csv --rebin 5 histogram re-binned to 5 degree bins
+ *
+ * Both are answered from the prefix sums in constant time per range or output bin.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "histogram.h"
+
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s histogram.csv MIN MAX\n", prog);
+	printf("       %s histogram.csv --rebin SIZE   SIZE a multiple of the histogram's bin size\n", prog);
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4)
+	{
+		usage(argv[0]);
+		exit(1);
+	}
+	
+	FILE *file = fopen(argv[1], "r");
+	angle_histogram_t hist;
+	if (file == NULL || angle_histogram_read(&hist, file) != 0)
+	{
+		printf("Error reading histogram %s\n", argv[1]);
+		exit(1);
+	}
+	fclose(file);
+	
+	if (strcmp(argv[2], "--rebin") == 0)
+	{
+		angle_histogram_t coarse;
+		char *end;
+		double bin_size = strtod(argv[3], &end);
+		if (end == argv[3] || *end != '\0' || angle_histogram_rebin(&hist, bin_size, &coarse) != 0)
+		{
+			printf("Invalid bin size %s, expected a positive multiple of %g degrees\n", argv[3], hist.bin_size);
+			usage(argv[0]);
+			exit(1);
+		}
+		
+		uint64_t total = angle_histogram_total(&coarse);
+		uint32_t k;
+		printf("ANGLE_MIN,ANGLE_MAX,COUNT,PERCENT_OF_TIME\n");
+		for (k=0; k<coarse.num_bins; k++)
+		{
+			printf("%.1f,%.1f,%" PRIu64 ",%.3f\n",
+				coarse.min + k * coarse.bin_size, coarse.min + (k+1) * coarse.bin_size,
+				coarse.counts[k], 100.0 * coarse.counts[k] / total);
+		}
+		angle_histogram_free(&coarse);
+	}
+	else
+	{
+		double a = atof(argv[2]);
+		double b = atof(argv[3]);
+		printf("%.3f%% of time in [%.1f, %.1f) degrees (%" PRIu64 " of %" PRIu64 " samples)\n",
+			100.0 * angle_histogram_fraction(&hist, a, b), a, b,
+			angle_histogram_count_range(&hist, a, b), angle_histogram_total(&hist));
+	}
+	
+	angle_histogram_free(&hist);
+	exit(0);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file	latency.c
+ *
+ * @brief
+ *   Fixed size latency histogram for percentile reports
+ *
+ *  Latencies below 64 ns get a bin each, larger ones LATENCY_SUB_BITS bits
+ * of mantissa, so every percentile is within ~3% and the histogram is one
+ * fixed block that can live on the stack or in a static.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "latency.h"
+
+
+/**
+ * @brief
+ *  Empty a latency histogram
+ *
+ * @param [out] latency pointer to latency_hist_t struct
+ */
+void latency_clear(latency_hist_t *latency)
+{
+	memset(latency, 0, sizeof(*latency));
+}
+
+
+/// bin of a latency, exact below 64 ns then LATENCY_SUB_BITS bits of mantissa
+static uint32_t latency_bin(uint64_t ns)
+{
+	if (ns < 64)
+	{
+		return((uint32_t)ns);
+	}
+	uint32_t e = 63 - __builtin_clzll(ns);
+	uint32_t sub = (uint32_t)(ns >> (e - LATENCY_SUB_BITS)) & ((1u << LATENCY_SUB_BITS) - 1);
+	return(64 + ((e - 6) << LATENCY_SUB_BITS) + sub);
+}
+
+
+/// largest latency that lands in a bin
+static uint64_t latency_bin_max(uint32_t bin)
+{
+	if (bin < 64)
+	{
+		return(bin);
+	}
+	uint32_t e = 6 + ((bin - 64) >> LATENCY_SUB_BITS);
+	uint64_t sub = (bin - 64) & ((1u << LATENCY_SUB_BITS) - 1);
+	return((((1ull << LATENCY_SUB_BITS) + sub + 1) << (e - LATENCY_SUB_BITS)) - 1);
+}
+
+
+/**
+ * @brief
+ *  Count one latency
+ *
+ * @param [in,out] latency pointer to latency_hist_t struct
+ * @param [in] ns latency in nanoseconds
+ */
+void latency_add(latency_hist_t *latency, uint64_t ns)
+{
+	latency->bins[latency_bin(ns)]++;
+	latency->count++;
+	if (ns > latency->max_ns)
+	{
+		latency->max_ns = ns;
+	}
+}
+
+
+/**
+ * @brief
+ *  Latency below which a given percentage of the counted ones fall
+ *
+ * @param [in] latency pointer to latency_hist_t struct
+ * @param [in] percent percentage, e.g. 99.9
+ *
+ * @return latency in nanoseconds, rounded up to the top of its bin, 0 if nothing was counted
+ */
+uint64_t latency_percentile(const latency_hist_t *latency, double percent)
+{
+	uint64_t rank = (uint64_t)ceil(latency->count * percent / 100.0);
+	uint64_t seen = 0;
+	uint32_t bin;
+
+	rank = (rank == 0) ? 1 : rank;
+	for (bin=0; bin<LATENCY_BINS && latency->count != 0; bin++)
+	{
+		seen += latency->bins[bin];
+		if (seen >= rank)
+		{
+			uint64_t top = latency_bin_max(bin);
+			return((top < latency->max_ns) ? top : latency->max_ns);
+		}
+	}
+	return(latency->max_ns);
+}
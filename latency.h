@@ -0,0 +1,27 @@
+/**
+ * @file	latency.h
+ *
+ * @brief
+ *   Header for the fixed size latency histogram
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <inttypes.h>
+
+#define LATENCY_SUB_BITS	5							// bins per power of two as bits, 32 bins
+#define LATENCY_BINS		(64 + (64 - 6) * 32)		// exact below 64 ns, then up to 2^64 ns
+
+/// latency histogram with log-linear bins, no heap memory
+typedef struct {
+	uint64_t count;				/// latencies counted
+	uint64_t max_ns;			/// largest latency counted
+	uint64_t bins[LATENCY_BINS];
+} latency_hist_t;
+
+void latency_clear(latency_hist_t *latency);
+void latency_add(latency_hist_t *latency, uint64_t ns);
+uint64_t latency_percentile(const latency_hist_t *latency, double percent);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Load generator for tracker_setpointd on a local UNIX socket.
+ *
+ *     tracker_loadgen --socket PATH [--requests N] [--depth D] [--rate R] [--start UNIX] [--step SECONDS]
+ *
+ * Sends N timestamp requests over one connection with up to D waiting for a
+ * reply, paced at R requests per second or as fast as the replies allow.
+ * Timestamps run from START in STEP second increments, by default every
+ * minute from 1 Jan 2017 UT. Reports the throughput and the p50/p99/p999
+ * round trip latency, then asks the daemon for its own latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "latency.h"
+
+#define MAX_DEPTH		1024			// requests in flight
+#define READ_BUFFER		65536
+#define DEFAULT_START	1483228800.0	// 00:00 1 Jan 2017 UT
+
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+
+/// write all of a buffer, 0 on success
+static int write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return(-1);
+		}
+		buf += n;
+		len -= n;
+	}
+	return(0);
+}
+
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s --socket PATH [--requests N] [--depth D] [--rate R] [--start UNIX] [--step SECONDS]\n", prog);
+	printf("  -s, --socket PATH    tracker_setpointd socket\n");
+	printf("  -n, --requests N     number of requests (default 100000)\n");
+	printf("  -d, --depth D        requests waiting for a reply at once, 1-%d (default 1)\n", MAX_DEPTH);
+	printf("  -r, --rate R         requests per second, 0 = as fast as possible (default 0)\n");
+	printf("  -t, --start UNIX     first timestamp in Unix seconds (default 00:00 1 Jan 2017 UT)\n");
+	printf("  -p, --step SECONDS   timestamp increment (default 60)\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	const char *socket_path = NULL;
+	uint64_t requests = 100000;
+	long depth = 1;
+	double rate = 0, start = DEFAULT_START, step = 60;
+
+	static const struct option long_options[] = {
+		{"socket",   required_argument, NULL, 's'},
+		{"requests", required_argument, NULL, 'n'},
+		{"depth",    required_argument, NULL, 'd'},
+		{"rate",     required_argument, NULL, 'r'},
+		{"start",    required_argument, NULL, 't'},
+		{"step",     required_argument, NULL, 'p'},
+		{"help",     no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "s:n:d:r:t:p:h", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 's':	socket_path = optarg;					break;
+			case 'n':	requests = strtoull(optarg, NULL, 10);	break;
+			case 'd':	depth = atol(optarg);					break;
+			case 'r':	rate = atof(optarg);					break;
+			case 't':	start = atof(optarg);					break;
+			case 'p':	step = atof(optarg);					break;
+			case 'h':
+				usage(argv[0]);
+				exit(0);
+			default:
+				usage(argv[0]);
+				exit(1);
+		}
+	}
+	if (socket_path == NULL || optind != argc || depth < 1 || depth > MAX_DEPTH || rate < 0 || requests == 0)
+	{
+		usage(argv[0]);
+		exit(1);
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		printf("Socket path too long %s\n", socket_path);
+		exit(1);
+	}
+	strcpy(addr.sun_path, socket_path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		printf("Error connecting to %s\n", socket_path);
+		exit(1);
+	}
+
+	static latency_hist_t latency;
+	static char buf[READ_BUFFER];
+	uint64_t sent_at[MAX_DEPTH];
+	uint64_t sent = 0, received = 0, errors = 0;
+	size_t len = 0;
+	latency_clear(&latency);
+
+	uint64_t begin = now_ns();
+	while (received < requests)
+	{
+		// send what the depth and the rate allow
+		uint64_t now = now_ns();
+		int timeout = -1;
+		while (sent < requests && sent - received < (uint64_t)depth)
+		{
+			if (rate > 0)
+			{
+				uint64_t due = begin + (uint64_t)(sent * 1e9 / rate);
+				if (due > now)
+				{
+					timeout = (int)((due - now) / 1000000);
+					break;
+				}
+			}
+			char line[64];
+			int n = snprintf(line, sizeof(line), "%.3f\n", start + sent * step);
+			sent_at[sent % MAX_DEPTH] = now_ns();
+			if (write_all(fd, line, n) != 0)
+			{
+				printf("Error writing to %s\n", socket_path);
+				exit(1);
+			}
+			sent++;
+		}
+		// a reply, or the time of the next paced send
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if (poll(&pfd, 1, timeout) <= 0)
+		{
+			continue;
+		}
+		ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+		now = now_ns();
+		if (n <= 0)
+		{
+			printf("Connection closed after %" PRIu64 " of %" PRIu64 " replies\n", received, requests);
+			exit(1);
+		}
+		len += n;
+
+		size_t done = 0, pos;
+		for (pos=0; pos<len; pos++)
+		{
+			if (buf[pos] == '\n')
+			{
+				errors += (strncmp(buf + done, "error", 5) == 0);
+				latency_add(&latency, now - sent_at[received % MAX_DEPTH]);
+				received++;
+				done = pos + 1;
+			}
+		}
+		memmove(buf, buf + done, len - done);
+		len -= done;
+	}
+	double seconds = (now_ns() - begin) * 1e-9;
+
+	printf("%" PRIu64 " requests, depth %ld, %.0f requests/s, %" PRIu64 " errors\n", requests, depth, requests / seconds, errors);
+	printf("round trip p50 %.1f us p99 %.1f us p999 %.1f us max %.1f us\n",
+		latency_percentile(&latency, 50.0) * 1e-3, latency_percentile(&latency, 99.0) * 1e-3,
+		latency_percentile(&latency, 99.9) * 1e-3, latency.max_ns * 1e-3);
+
+	// the daemon's view, without the socket round trip
+	if (write_all(fd, "stats\n", 6) == 0)
+	{
+		ssize_t n = read(fd, buf, sizeof(buf) - 1);
+		if (n > 0)
+		{
+			buf[n] = '\0';
+			printf("daemon %s", buf);
+		}
+	}
+	close(fd);
+	return(errors ? 1 : 0);
+}
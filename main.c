@@ -3,6 +3,13 @@
  * and write results for each location to a CSV file.  A summary file is also created.
  *
  * Finally, we answer the question: "what percent of the time does a tracker spend at +/- 5 degrees?"
+ *
+ * The year is split into location x month chunks which are handed out to a pool of worker
+ * threads (--threads N). Each worker keeps its own histograms, which are merged once all
+ * chunks are done, and the summary files are written afterwards in the same order as a serial
+ * run. The per-minute CSV files are written while the workers run: each chunk's angles go into
+ * a slot of a bounded ring and a writer thread formats the chunks in file order, see
+ * writer_main().
  * 
  * Jason Alderman
  * 04SEP2017
@@ -12,11 +19,30 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <inttypes.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "tracking_algorithm.h"
 #include "angle_conversions.h"
 #include "solarpos.h"
+#include "solarpos_batch.h"
+#include "ephemeris.h"
+#include "angle_file.h"
+#include "histogram.h"
+#include "sweep.h"
+#include "plant.h"
+#include "solar_cache.h"
+#include "daylight.h"
+#include "events.h"
+#include "sites.h"
+#include "raster_file.h"
+#include "raw_csv.h"
+#include "trackerangle.h"
+#include "timeseries.h"
 
 typedef struct
 {
@@ -41,6 +67,15 @@ typedef struct
 
 #define ANGLE_BIN_SIZE	5.0		// degrees
 
+#ifdef TRACKER_FLOAT32
+#define SOLARPOS_BITS	32		// per-site solar position arithmetic, kept in the --cache key
+#else
+#define SOLARPOS_BITS	64
+#endif
+
+#define MINUTES_PER_DAY		EPHEMERIS_MINUTES_PER_DAY
+#define MINUTES_PER_YEAR	(365*MINUTES_PER_DAY)
+
 #define NUM_LOCATIONS	5
 static location_t locations[NUM_LOCATIONS] = {
 	{47.608358, -122.323175, -8, "Seattle",       0}, 
@@ -50,143 +85,1904 @@ static location_t locations[NUM_LOCATIONS] = {
 	{61.160612, -150.014821, -9, "Anchorage",     0}
 };
 
-tracker_t tracker;
-uint16_t year = 2017;
-int8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+static tracker_t tracker;
+static tracker_kernel_t tracker_kernel;			// tracker resolved to its tracker_angle() kernel
+static const uint16_t year = 2017;
+static const int8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
 /****************************************************************************/
+// State shared by the worker threads, read-only once the workers start except for next_chunk
 
+#define NUM_CHUNKS		(NUM_LOCATIONS * 12)	// one chunk per location and month
 
-int main(int argc, char* argv[])
+typedef struct
 {
-	uint8_t month, day, hour, minute;
-	tracker.rom = TRACKER_ROM;
-	tracker.gcr = TRACKER_GCR;
-	tracker.night_stow = TRACKER_STOW;
-	tracker.alpha = 0;
-	tracker.beta = 0;
+	pthread_t thread;
+	uint32_t *counts;		// NUM_LOCATIONS x num_bins histogram owned by this worker
+	angle_histogram_t hist[NUM_LOCATIONS];	// fine signed histograms owned by this worker
+} worker_t;
+
+static ephemeris_t ephemeris;					// built on first use, n == 0 until then
+static solar_cache_t solar_caches[NUM_LOCATIONS];	// mapped solar position per location with --cache
+static uint32_t month_start[12];				// local minute of the year at 00:00 on the 1st
+static uint32_t num_bins;
+static uint32_t raw_step = 1;					// keep every Nth minute for the raw data file, 0 = no raw file
+static double *angles[NUM_LOCATIONS];			// angle with shade avoidance for every kept minute of the year
+
+static pthread_mutex_t chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t next_chunk = 0;
+
+/****************************************************************************/
+// Raw CSV output ring, chunk c is computed into slot c % ring_slots and written by the
+// writer thread in chunk order. A worker waits for its slot until chunk c - ring_slots
+// has been written, so the workers stay at most ring_slots chunks ahead of the disk.
+
+#define OUTPUT_RING_DEPTH	4		// slots beyond one per worker
+#define MAX_MONTH_MINUTES	(31 * MINUTES_PER_DAY)
+
+static uint32_t ring_slots;						// 0 when the raw data is not a CSV file
+static double *ring;							// ring_slots x MAX_MONTH_MINUTES angles
+static uint8_t *ring_done;						// slot holds a computed chunk not yet written
+static uint32_t chunks_written;					// chunks the writer has finished with
+static pthread_cond_t ring_written = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_computed = PTHREAD_COND_INITIALIZER;
+
+/****************************************************************************/
+// Site list (--sites) and raster (--raster) modes, sites are read or generated,
+// calculated and written one block at a time
+
+#define SITES_BLOCK		1024	// sites per block
+
+typedef struct site_worker site_worker_t;
+
+typedef struct
+{
+	site_entry_t *entries;			// SITES_BLOCK sites, the first count are this block
+	uint32_t count;
+	uint32_t next;					// next site to hand out, under chunk_lock
+	double *results;				// SITES_BLOCK x (num_bins + 1), % in zone then percent of time per bin
+	const events_t *events;			// bin edge crossings instead of every minute, NULL for every minute
+	double zone_min;
+	double zone_max;
+	site_worker_t *workers;
+	long num_threads;
+} site_block_t;
+
+struct site_worker
+{
+	pthread_t thread;
+	site_block_t *block;
+	angle_histogram_t hist;			// fine signed histogram, reused for each site
+};
+
+/****************************************************************************/
+
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+
+/**
+ * @brief
+ *  Build the shared ephemeris table, with its single precision copy in a TRACKER_FLOAT32 build
+ */
+static void build_ephemeris(void)
+{
+	ephemeris_init(&ephemeris, year);
+#ifdef TRACKER_FLOAT32
+	ephemeris_init_f32(&ephemeris);
+#endif
+}
+
+
+/**
+ * @brief
+ *  Solar azimuth and zenith of n minutes from the shared ephemeris table
+ *
+ *  A TRACKER_FLOAT32 build runs solar_position_site_batch_f32() and widens
+ * the results, so everything downstream stays double.
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] first index of the first ephemeris entry
+ * @param [in] n number of minutes, at most MINUTES_PER_DAY
+ * @param [out] azimuth n azimuths in degrees
+ * @param [out] zenith n zeniths in degrees
+ */
+static void site_solar_position(const solarpos_site_t *site, size_t first, size_t n, double *azimuth, double *zenith)
+{
+#ifdef TRACKER_FLOAT32
+	float azimuth_f32[MINUTES_PER_DAY], zenith_f32[MINUTES_PER_DAY];
+	solarpos_batch_f32_t batch = {azimuth_f32, zenith_f32};
+	solar_position_site_batch_f32(site, &ephemeris.terms_f32, first, n, &batch);
+	size_t i;
+	for (i=0; i<n; i++)
+	{
+		azimuth[i] = azimuth_f32[i];
+		zenith[i] = zenith_f32[i];
+	}
+#else
+	double elevation[MINUTES_PER_DAY], declination[MINUTES_PER_DAY];
+	solarpos_batch_t batch = {azimuth, zenith, elevation, declination};
+	solar_position_site_batch(site, &ephemeris.terms, first, n, &batch);
+#endif
+}
+
+
+/**
+ * @brief
+ *  Solar azimuth and zenith for the daylight minutes of one day at one site
+ *
+ *  Points into the site's solar_cache_t when one is mapped, otherwise the
+ * minutes in the window are calculated into the caller's buffers from the
+ * shared ephemeris table. The window's edges are then walked outward until
+ * the minute at each edge is night (or the edge is midnight), so every minute
+ * outside the window is night. Entries outside the window are not set.
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] cache pointer to the site's solar_cache_t struct, NULL or unmapped to calculate
+ * @param [in] day_start local minute of the year at 00:00 of the day
+ * @param [out] buf_azimuth buffer for MINUTES_PER_DAY azimuths
+ * @param [out] buf_zenith buffer for MINUTES_PER_DAY zeniths
+ * @param [out] azimuth set to the day's azimuths in degrees, indexed by minute of the day
+ * @param [out] zenith set to the day's zeniths in degrees, indexed by minute of the day
+ * @param [in,out] window minutes to evaluate, e.g. from daylight_estimate(), widened as needed
+ */
+static void day_solar_position(const solarpos_site_t *site, const solar_cache_t *cache, uint32_t day_start,
+	double *buf_azimuth, double *buf_zenith, const double **azimuth, const double **zenith, daylight_t *window)
+{
+	int cached = (cache != NULL && cache->map != NULL);
+	size_t first = 0;
 	
-	FILE *summary_file = fopen("AngleSummary_All.csv", "w");
-	if (summary_file == NULL)
+	if (cached)
 	{
-		printf("Error opening summary file!\n");
-		exit(1);
+		*azimuth = cache->azimuth + day_start;
+		*zenith = cache->zenith + day_start;
 	}
-	fprintf(summary_file, "LOCATION,ANGLE_BIN,COUNT,PERCENT_OF_TIME\n");
+	else
+	{
+		*azimuth = buf_azimuth;
+		*zenith = buf_zenith;
+		first = ephemeris_local_index(&ephemeris, site->timezone, day_start);
+		site_solar_position(site, first + window->first, window->end - window->first,
+			&buf_azimuth[window->first], &buf_zenith[window->first]);
+	}
+	
+	// Walk the edges out until the minute at each edge is night
+	while (window->first > 0 && (*zenith)[window->first] < 90.0)
+	{
+		uint16_t edge = (window->first > DAYLIGHT_MARGIN) ? window->first - DAYLIGHT_MARGIN : 0;
+		if (!cached)
+		{
+			site_solar_position(site, first + edge, window->first - edge, &buf_azimuth[edge], &buf_zenith[edge]);
+		}
+		window->first = edge;
+	}
+	while (window->end < MINUTES_PER_DAY && (*zenith)[window->end - 1] < 90.0)
+	{
+		uint16_t edge = (window->end + DAYLIGHT_MARGIN < MINUTES_PER_DAY) ? window->end + DAYLIGHT_MARGIN : MINUTES_PER_DAY;
+		if (!cached)
+		{
+			site_solar_position(site, first + window->end, edge - window->end, &buf_azimuth[window->end], &buf_zenith[window->end]);
+		}
+		window->end = edge;
+	}
+}
 
-	uint8_t i;
+
+/**
+ * @brief
+ *  Map the solar position cache for every location, building missing entries
+ *
+ *  After this every location has a mapped cache, so the ephemeris table is
+ * only built if at least one cache file was missing or stale.
+ *
+ * @param [in] dir cache directory, must exist
+ */
+static void load_solar_caches(const char *dir)
+{
+	double start_time = now_seconds();
+	uint8_t i, built = 0;
+	
 	for (i=0; i<NUM_LOCATIONS; i++)
 	{
-		printf("Calculating data for %s\n", locations[i].name);
+		solarpos_site_t site = {locations[i].latitude, locations[i].longitude, locations[i].timezone};
+		solar_cache_key_t key = {site.latitude, site.longitude, site.timezone, year, 60, MINUTES_PER_YEAR, SOLARPOS_BITS};
+		char path[4096];
+		if (solar_cache_path(path, sizeof(path), dir, &key) != 0)
+		{
+			printf("Cache directory name too long %s\n", dir);
+			exit(1);
+		}
+		if (solar_cache_open(path, &key, &solar_caches[i]) == 0)
+		{
+			continue;
+		}
 		
-		// Open raw data file where we will save all angle data for the year
-		char fname[32] = {0};
-		strcat(fname, "TrackerAngle_");
-		strcat(fname, locations[i].name);
-		strcat(fname, ".csv");
-		FILE *location_file = fopen(fname, "w");
-		if (location_file == NULL)
+		// Missing or stale, calculate the year as an uncached run would and save it
+		if (ephemeris.n == 0)
 		{
-			printf("Error opening output file for %s \n", locations[i].name);
+			build_ephemeris();
+		}
+		double *azimuth = malloc(2 * MINUTES_PER_YEAR * sizeof(double));
+		if (azimuth == NULL)
+		{
+			printf("Error allocating solar position data\n");
+			exit(1);
+		}
+		double *zenith = azimuth + MINUTES_PER_YEAR;
+		uint32_t day_start;
+		for (day_start=0; day_start<MINUTES_PER_YEAR; day_start+=MINUTES_PER_DAY)
+		{
+			// every minute, night included, so the cache holds the full year
+			const double *day_azimuth, *day_zenith;
+			daylight_t window = {0, MINUTES_PER_DAY};
+			day_solar_position(&site, NULL, day_start, azimuth + day_start, zenith + day_start, &day_azimuth, &day_zenith, &window);
+		}
+		if (solar_cache_write(path, &key, azimuth, zenith) != 0 || solar_cache_open(path, &key, &solar_caches[i]) != 0)
+		{
+			printf("Error writing solar position cache %s\n", path);
 			exit(1);
 		}
-		fprintf(location_file, "LOCATION,YEAR,MONTH,DAY,HOUR,MINUTE,ANGLE\n");
+		free(azimuth);
+		built++;
+	}
+	
+	printf("Solar position cache: %d of %d locations loaded, %d rebuilt in %.2f s\n",
+		NUM_LOCATIONS - built, NUM_LOCATIONS, built, now_seconds() - start_time);
+}
+
+
+/**
+ * @brief
+ *  Calculate tracker angles for a run of days at one site
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] cache pointer to the site's solar_cache_t struct, NULL to calculate
+ * @param [in] day_start local minute of the year at 00:00 of the first day
+ * @param [in] num_days number of days
+ * @param [in,out] counts num_bins histogram of |angle| to add to
+ * @param [in,out] hist fine signed histogram to add to
+ * @param [out] raw angle for every raw_step-th minute of the year, NULL for none
+ * @param [in] raw_first index in the year of raw[0]
+ */
+static void compute_days(const solarpos_site_t *site, const solar_cache_t *cache, uint32_t day_start, uint16_t num_days,
+	uint32_t *counts, angle_histogram_t *hist, double *raw, uint32_t raw_first)
+{
+	uint16_t day;
+	uint16_t k;
+	
+	// Every night minute gets the same angle
+	double stow_w_sa = backtrack_angle(&tracker_kernel.backtrack, tracker_kernel.night_stow);
+	uint16_t stow_bin = (uint16_t)floor(fabs(stow_w_sa) / ANGLE_BIN_SIZE);
+	
+	for (day=0; day<num_days; day++)
+	{
+		// Solar position and tracking only for the minutes the sun may be up
+		double buf_azimuth[MINUTES_PER_DAY], buf_zenith[MINUTES_PER_DAY];
+		const double *azimuth, *zenith;
+		daylight_t window;
+		daylight_estimate(site, year, day_start / MINUTES_PER_DAY, &window);
+		day_solar_position(site, cache, day_start, buf_azimuth, buf_zenith, &azimuth, &zenith, &window);
 		
+		uint16_t night = MINUTES_PER_DAY - (window.end - window.first);
+		counts[stow_bin] += night;
+		angle_histogram_add_n(hist, stow_w_sa, night);
 		
-		// Initialize summary struct
-		uint32_t num_bins = (uint32_t)(TRACKER_ROM/ANGLE_BIN_SIZE) + 1;
-		location_summary_t location_summary[num_bins];
-		uint32_t j;
-		for (j=0; j<num_bins; j++)
+		for (k=0; k<MINUTES_PER_DAY; k++)
 		{
-			location_summary[j].angle_bin = j*ANGLE_BIN_SIZE;
-			location_summary[j].count = 0;
+			double angle_w_sa = stow_w_sa;
+			if (k >= window.first && k < window.end)
+			{
+				// Calculate tracker angle for this site at this time, only azimuth and zenith are used
+				solarpos_t solarpos = {0};
+				solarpos.azimuth 		= azimuth[k];
+				solarpos.zenith 		= zenith[k];
+				
+				double angle_no_sa = tracker_kernel.angle(&tracker_kernel, &solarpos);
+				angle_w_sa = backtrack_angle(&tracker_kernel.backtrack, angle_no_sa);
+				
+				// Update the caller's histograms
+				uint16_t bin = (uint16_t)floor(fabs(angle_w_sa) / ANGLE_BIN_SIZE);
+				counts[bin]++;
+				angle_histogram_add(hist, angle_w_sa);
+			}
+			
+			uint32_t minute_of_year = day_start + k;
+			if (raw != NULL && minute_of_year % raw_step == 0)
+			{
+				raw[minute_of_year / raw_step - raw_first] = angle_w_sa;
+			}
+		}
+		
+		day_start += MINUTES_PER_DAY;
+	}
+}
+
+
+/// index in the year of the first kept raw minute at or after a minute of the year
+static uint32_t raw_index(uint32_t minute_of_year)
+{
+	return((minute_of_year + raw_step - 1) / raw_step);
+}
+
+
+/**
+ * @brief
+ *  Calculate tracker angles for one location over one month
+ *
+ *  With the output ring the angles go into the chunk's slot once the writer
+ * has freed it, and the writer is told when the chunk is done.
+ *
+ * @param [in] chunk chunk number, location * 12 + month
+ * @param [in,out] worker pointer to the worker_t struct whose histograms are updated
+ */
+static void compute_chunk(uint32_t chunk, worker_t *worker)
+{
+	uint8_t i = chunk / 12;
+	uint8_t month = chunk % 12;
+	double *raw = angles[i];
+	uint32_t raw_first = 0;
+	
+	if (ring_slots != 0)
+	{
+		pthread_mutex_lock(&chunk_lock);
+		while (chunk >= chunks_written + ring_slots)
+		{
+			pthread_cond_wait(&ring_written, &chunk_lock);
 		}
+		pthread_mutex_unlock(&chunk_lock);
+		raw = &ring[(size_t)(chunk % ring_slots) * MAX_MONTH_MINUTES];
+		raw_first = raw_index(month_start[month]);
+	}
+	
+	solarpos_site_t site = {locations[i].latitude, locations[i].longitude, locations[i].timezone};
+	compute_days(&site, &solar_caches[i], month_start[month], month_days[month],
+		&worker->counts[i*num_bins], &worker->hist[i], raw, raw_first);
+	
+	if (ring_slots != 0)
+	{
+		pthread_mutex_lock(&chunk_lock);
+		ring_done[chunk % ring_slots] = 1;
+		pthread_cond_signal(&ring_computed);
+		pthread_mutex_unlock(&chunk_lock);
+	}
+}
+
+
+/**
+ * @brief
+ *  Worker thread, takes chunks until there are none left
+ *
+ * @param [in] arg pointer to this thread's worker_t struct
+ */
+static void *worker_main(void *arg)
+{
+	worker_t *worker = arg;
+	
+	while (1)
+	{
+		pthread_mutex_lock(&chunk_lock);
+		uint32_t chunk = next_chunk++;
+		pthread_mutex_unlock(&chunk_lock);
 		
-		for (month=0; month<12; month++)
+		if (chunk >= NUM_CHUNKS)
 		{
-			
-			for (day=1; day<=month_days[month]; day++)
+			break;
+		}
+		compute_chunk(chunk, worker);
+	}
+	
+	return(NULL);
+}
+
+
+/**
+ * @brief
+ *  Write the raw data CSV rows of one location and month
+ *
+ * @param [in,out] csv raw data file of the location
+ * @param [in] month month, 0 = January
+ * @param [in] angle kept angles of the month, from its first kept minute
+ */
+static void write_raw_month(raw_csv_t *csv, uint8_t month, const double *angle)
+{
+	uint8_t day, hour, minute;
+	uint32_t minute_of_year = month_start[month];
+	
+	for (day=1; day<=month_days[month]; day++)
+	{
+		for (hour=0; hour<24; hour++)
+		{
+			for(minute=0; minute<60; minute++)
 			{
-				
-				for (hour=0; hour<24; hour++)
+				if (minute_of_year++ % raw_step == 0)
 				{
-					
-					for(minute=0; minute<60; minute++)
-					{
-						solarpos_inputs_t solarpos_inputs;
-						solarpos_inputs.year 		= year;
-						solarpos_inputs.month 		= month+1; // algorith expects calendar month
-						solarpos_inputs.day 		= day;
-						solarpos_inputs.hour 		= hour;
-						solarpos_inputs.minute 		= minute;
-						solarpos_inputs.latitude	= locations[i].latitude;
-						solarpos_inputs.longitude	= locations[i].longitude;
-						solarpos_inputs.timezone	= locations[i].timezone;
-						
-						// Calculate solar position and tracker angle for this location at this time
-						solarpos_t *solarpos = solar_position_calc(&solarpos_inputs);
-						//~ printf("Month %02d Day %02d Hour %02d Minute %02d Az %.3f El %.3f - ",
-							//~ month+1, day, hour, minute, solarpos->azimuth, solarpos->elevation);
-							
-						double angle_no_sa = tracker_angle(solarpos, &tracker);
-						double angle_w_sa = shade_avoidance_angle(angle_no_sa, &tracker);
-						//~ printf("w/o SA %.1f, w/SA %.1f\n", angle_no_sa, angle_w_sa);
-						
-						// Save to raw data file
-						fprintf(location_file, "%s,%02d,%02d,%02d,%02d,%02d,%.1f\n",
-							locations[i].name, year, month, day, hour, minute, angle_w_sa);
-							
-						// Update location summary struct
-						uint16_t bin = (uint16_t)(abs(angle_w_sa) / ANGLE_BIN_SIZE);
-						location_summary[bin].count++;
-					}
+					raw_csv_row(csv, month, day, hour, minute, *angle++);
 				}
 			}
 		}
+	}
+}
+
+
+/**
+ * @brief
+ *  Writer thread, formats the chunks in the output ring into the raw data CSV files
+ *
+ *  Takes the chunks in order as the workers finish them, opening each
+ * location's TrackerAngle_<site>.csv at its first month and closing it after
+ * the last, and frees each slot for the chunk ring_slots further on.
+ *
+ * @param [in] arg unused
+ */
+static void *writer_main(void *arg)
+{
+	raw_csv_t csv;
+	uint32_t chunk;
+	(void)arg;
+	
+	for (chunk=0; chunk<NUM_CHUNKS; chunk++)
+	{
+		uint8_t i = chunk / 12;
+		uint8_t month = chunk % 12;
+		uint32_t slot = chunk % ring_slots;
 		
-		fclose(location_file);
+		if (month == 0)
+		{
+			char fname[4096];
+			snprintf(fname, sizeof(fname), "TrackerAngle_%s.csv", locations[i].name);
+			if (raw_csv_open(&csv, fname, locations[i].name, year) != 0)
+			{
+				printf("Error opening output file for %s \n", locations[i].name);
+				exit(1);
+			}
+		}
 		
-		// Write angle summary file
-		memset(fname, 0, 32);
-		strcat(fname, "AngleSummary_");
-		strcat(fname, locations[i].name);
-		strcat(fname, ".csv");
-		FILE *location_summary_file = fopen(fname, "w");
-		if (location_summary_file == NULL)
+		pthread_mutex_lock(&chunk_lock);
+		while (!ring_done[slot])
 		{
-			printf("Error opening output file for %s \n", locations[i].name);
-			exit(1);
+			pthread_cond_wait(&ring_computed, &chunk_lock);
 		}
-		fprintf(location_summary_file, "LOCATION,ANGLE_BIN,COUNT,PERCENT_OF_TIME\n");
-		for (j=0; j<num_bins; j++)
+		pthread_mutex_unlock(&chunk_lock);
+		
+		write_raw_month(&csv, month, &ring[(size_t)slot * MAX_MONTH_MINUTES]);
+		
+		pthread_mutex_lock(&chunk_lock);
+		ring_done[slot] = 0;
+		chunks_written = chunk + 1;
+		pthread_cond_broadcast(&ring_written);
+		pthread_mutex_unlock(&chunk_lock);
+		
+		if (month == 11 && raw_csv_close(&csv) != 0)
 		{
-			fprintf(location_summary_file, "%s,%.1f,%d,%.3f\n",
-				locations[i].name, location_summary[j].angle_bin, location_summary[j].count, (100 * (double)location_summary[j].count/(365*24*60)) );
-				
-			fprintf(summary_file, "%s,%.1f,%d,%.3f\n",
-				locations[i].name, location_summary[j].angle_bin, location_summary[j].count, (100 * (double)location_summary[j].count/(365*24*60)) );
+			printf("Error writing output file for %s \n", locations[i].name);
+			exit(1);
 		}
-		fclose(location_summary_file);
+	}
+	
+	return(NULL);
+}
+
+
+/**
+ * @brief
+ *  Measure the average size and formatting cost of one raw data CSV row
+ *
+ *  Ten days of rows are formatted to /dev/null, so the estimate covers the
+ * formatting and buffering cost but not the disk writes themselves.
+ *
+ * @param [out] row_bytes average bytes per row
+ * @param [out] row_seconds average seconds per row
+ */
+static void measure_raw_row_cost(double *row_bytes, double *row_seconds)
+{
+	const uint32_t rows = 10 * MINUTES_PER_DAY;
+	*row_bytes = 0;
+	*row_seconds = 0;
+	
+	raw_csv_t csv;
+	if (raw_csv_open(&csv, "/dev/null", locations[0].name, year) != 0)
+	{
+		return;
+	}
+	
+	uint32_t k;
+	uint64_t bytes = 0;
+	double start = now_seconds();
+	for (k=0; k<rows; k++)
+	{
+		size_t len = csv.len;
+		raw_csv_row(&csv, 0, 1 + k / MINUTES_PER_DAY, (k / 60) % 24, k % 60, -TRACKER_ROM + k * (2.0 * TRACKER_ROM / rows));
+		bytes += (csv.len > len) ? csv.len - len : csv.len;
+	}
+	raw_csv_close(&csv);
+	*row_seconds = (now_seconds() - start) / rows;
+	*row_bytes = (double)bytes / rows;
+}
+
+
+/**
+ * @brief
+ *  Sun vector for every minute of the year at one location
+ *
+ * @param [in] i location index
+ * @param [out] sun array of MINUTES_PER_YEAR sun vectors
+ */
+static void location_sun_vectors(uint8_t i, sun_vector_t *sun)
+{
+	solarpos_site_t site = {locations[i].latitude, locations[i].longitude, locations[i].timezone};
+	double buf_azimuth[MINUTES_PER_DAY], buf_zenith[MINUTES_PER_DAY];
+	uint32_t day_start;
+	uint16_t k;
+	
+	for (day_start=0; day_start<MINUTES_PER_YEAR; day_start+=MINUTES_PER_DAY)
+	{
+		const double *azimuth, *zenith;
+		daylight_t window;
+		daylight_estimate(&site, year, day_start / MINUTES_PER_DAY, &window);
+		day_solar_position(&site, &solar_caches[i], day_start, buf_azimuth, buf_zenith, &azimuth, &zenith, &window);
 		
-		// Calculate percent of time this location's tracker is within the range of interest (+/- 5 deg)
-		double count_in_zone = 0;
-		j = 0;
-		while (j*ANGLE_BIN_SIZE < 5)
+		// night minutes are a zero vector, which every tracker treats as below the horizon
+		memset(&sun[day_start], 0, window.first * sizeof(sun_vector_t));
+		memset(&sun[day_start + window.end], 0, (MINUTES_PER_DAY - window.end) * sizeof(sun_vector_t));
+		for (k=window.first; k<window.end; k++)
 		{
-			count_in_zone += location_summary[j].count;
-			j++;
+			solarpos_t solarpos = {0};
+			solarpos.azimuth = azimuth[k];
+			solarpos.zenith = zenith[k];
+			sun_vector(&solarpos, &sun[day_start + k]);
 		}
-		locations[i].percent_in_zone = 100.0 * (double)count_in_zone / (365*24*60);
+	}
+}
+
+
+typedef struct
+{
+	pthread_t thread;
+	const sun_vector_t *sun;
+	const tracker_t *configs;
+	angle_histogram_t *hists;
+	size_t count;
+} sweep_worker_t;
+
+static void *sweep_worker_main(void *arg)
+{
+	sweep_worker_t *worker = arg;
+	sweep_evaluate(worker->sun, MINUTES_PER_YEAR, worker->configs, worker->hists, worker->count);
+	return(NULL);
+}
+
+
+/**
+ * @brief
+ *  Parameter sweep mode, every tracker configuration in the sweep at every location
+ *
+ *  Writes SweepSummary.csv with the percent of time in the zone for each
+ * location and configuration, and SweepHistogram_<site>.csv with one
+ * ANGLE_BIN_SIZE histogram per configuration.
+ *
+ * @param [in] spec pointer to sweep_spec_t struct
+ * @param [in] num_threads number of threads, the configurations are split between them
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ */
+static void run_sweep(const sweep_spec_t *spec, long num_threads, double zone_min, double zone_max)
+{
+	tracker_t *configs;
+	size_t num_configs = sweep_expand(spec, &configs);
+	printf("Sweeping %zu tracker configurations at %d locations with %ld thread(s)\n", num_configs, NUM_LOCATIONS, num_threads);
+	
+	sun_vector_t *sun = malloc(MINUTES_PER_YEAR * sizeof(sun_vector_t));
+	angle_histogram_t *hists = malloc(num_configs * sizeof(angle_histogram_t));
+	sweep_worker_t *workers = calloc(num_threads, sizeof(sweep_worker_t));
+	if (sun == NULL || hists == NULL || workers == NULL)
+	{
+		printf("Error allocating sweep data\n");
+		exit(1);
 	}
 	
-	fclose(summary_file);
+	FILE *summary_file = fopen("SweepSummary.csv", "w");
+	if (summary_file == NULL)
+	{
+		printf("Error opening sweep summary file!\n");
+		exit(1);
+	}
+	fprintf(summary_file, "LOCATION,CONFIG,GCR,ROM,STOW,ALPHA,BETA,PERCENT_IN_ZONE\n");
 	
-	// Print a table showing percent of time at +/- 5 degrees for each location
-	printf("\nLocation           %% in Zone\n");
+	double solar_time = 0, sweep_time = 0;
+	uint8_t i;
 	for (i=0; i<NUM_LOCATIONS; i++)
 	{
-		printf("%-18s %.2f\n", locations[i].name, locations[i].percent_in_zone);
+		printf("Calculating data for %s\n", locations[i].name);
+		
+		// Solar position once per location
+		double start_time = now_seconds();
+		location_sun_vectors(i, sun);
+		solar_time += now_seconds() - start_time;
+		
+		// Every configuration against the same sun vectors, configurations split across threads
+		start_time = now_seconds();
+		size_t c;
+		for (c=0; c<num_configs; c++)
+		{
+			angle_histogram_init(&hists[c], -configs[c].rom, configs[c].rom, HISTOGRAM_BIN_SIZE);
+		}
+		long w;
+		size_t first = 0;
+		for (w=0; w<num_threads; w++)
+		{
+			size_t count = num_configs / num_threads + ((size_t)w < num_configs % num_threads ? 1 : 0);
+			workers[w].sun = sun;
+			workers[w].configs = &configs[first];
+			workers[w].hists = &hists[first];
+			workers[w].count = count;
+			first += count;
+			if (w > 0 && pthread_create(&workers[w].thread, NULL, sweep_worker_main, &workers[w]) != 0)
+			{
+				printf("Error starting worker thread\n");
+				exit(1);
+			}
+		}
+		sweep_worker_main(&workers[0]);
+		for (w=1; w<num_threads; w++)
+		{
+			pthread_join(workers[w].thread, NULL);
+		}
+		sweep_time += now_seconds() - start_time;
+		
+		// One histogram per configuration
+		char fname[4096];
+		snprintf(fname, sizeof(fname), "SweepHistogram_%s.csv", locations[i].name);
+		FILE *histogram_file = fopen(fname, "w");
+		if (histogram_file == NULL)
+		{
+			printf("Error opening output file for %s \n", locations[i].name);
+			exit(1);
+		}
+		fprintf(histogram_file, "CONFIG,GCR,ROM,STOW,ALPHA,BETA,ANGLE_MIN,ANGLE_MAX,COUNT,PERCENT_OF_TIME\n");
+		for (c=0; c<num_configs; c++)
+		{
+			const tracker_t *config = &configs[c];
+			angle_histogram_finalize(&hists[c]);
+			
+			fprintf(summary_file, "%s,%zu,%.3f,%.1f,%.1f,%.1f,%.1f,%.3f\n",
+				locations[i].name, c, config->gcr, config->rom, config->night_stow, config->alpha, config->beta,
+				100.0 * angle_histogram_fraction(&hists[c], zone_min, zone_max));
+			
+			angle_histogram_t coarse;
+			angle_histogram_rebin(&hists[c], ANGLE_BIN_SIZE, &coarse);
+			uint32_t k;
+			for (k=0; k<coarse.num_bins; k++)
+			{
+				fprintf(histogram_file, "%zu,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%" PRIu64 ",%.3f\n",
+					c, config->gcr, config->rom, config->night_stow, config->alpha, config->beta,
+					coarse.min + k * coarse.bin_size, coarse.min + (k+1) * coarse.bin_size,
+					coarse.counts[k], 100.0 * coarse.counts[k] / MINUTES_PER_YEAR);
+			}
+			angle_histogram_free(&coarse);
+			angle_histogram_free(&hists[c]);
+		}
+		fclose(histogram_file);
+	}
+	
+	fclose(summary_file);
+	printf("\nSolar position %.2f s, %zu configurations %.2f s (%.1f ns per configuration-minute)\n",
+		solar_time, num_configs, sweep_time, 1e9 * sweep_time / ((double)num_configs * NUM_LOCATIONS * MINUTES_PER_YEAR));
+	
+	free(workers);
+	free(hists);
+	free(sun);
+	free(configs);
+}
+
+
+typedef struct
+{
+	pthread_t thread;
+	const plant_t *plant;
+	const sun_vector_t *sun;
+	size_t first;
+	size_t count;
+	plant_stats_t stats;
+} plant_worker_t;
+
+static void *plant_worker_main(void *arg)
+{
+	plant_worker_t *worker = arg;
+	plant_evaluate(worker->plant, worker->first, worker->count, worker->sun, MINUTES_PER_YEAR, &worker->stats);
+	return(NULL);
+}
+
+
+/**
+ * @brief
+ *  Plant layout mode, every row of a row table at every location
+ *
+ *  Each row has its own axis, cross-axis slope and spacing, see plant.h. The
+ * rows are split across the threads, which share one year of sun vectors per
+ * location. Writes PlantSummary_<site>.csv with the % in zone and percent of
+ * time per ANGLE_BIN_SIZE bin of |angle| for each row, PlantHistogram_<site>.csv
+ * with the signed histogram over every row and minute, and PlantFleet_All.csv
+ * with the fleet totals per location.
+ *
+ * @param [in] path row table file name
+ * @param [in] num_threads number of threads, the rows are split between them
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ */
+static void run_plant(const char *path, long num_threads, double zone_min, double zone_max)
+{
+	plant_t plant;
+	uint64_t error_line;
+	if (plant_read(&plant, path, &tracker, &error_line) != 0)
+	{
+		if (error_line == 0)
+		{
+			printf("Error opening plant layout %s\n", path);
+		}
+		else
+		{
+			printf("Invalid plant layout %s line %" PRIu64 ", expected NAME,ALPHA,BETA,SLOPE,PITCH,WIDTH\n", path, error_line);
+		}
+		exit(1);
+	}
+	if ((size_t)num_threads > plant.num_rows)
+	{
+		num_threads = plant.num_rows;
+	}
+	num_bins = (uint32_t)(TRACKER_ROM/ANGLE_BIN_SIZE) + 1;
+	printf("Evaluating %zu tracker rows at %d locations with %ld thread(s)\n", plant.num_rows, NUM_LOCATIONS, num_threads);
+	
+	sun_vector_t *sun = malloc(MINUTES_PER_YEAR * sizeof(sun_vector_t));
+	plant_worker_t *workers = calloc(num_threads, sizeof(plant_worker_t));
+	if (sun == NULL || workers == NULL)
+	{
+		printf("Error allocating plant data\n");
+		exit(1);
+	}
+	
+	FILE *fleet_file = fopen("PlantFleet_All.csv", "w");
+	if (fleet_file == NULL)
+	{
+		printf("Error opening plant fleet file!\n");
+		exit(1);
+	}
+	uint32_t j;
+	fprintf(fleet_file, "LOCATION,ROWS,PERCENT_IN_ZONE");
+	for (j=0; j<num_bins; j++)
+	{
+		fprintf(fleet_file, ",BIN_%.1f", j*ANGLE_BIN_SIZE);
+	}
+	fprintf(fleet_file, "\n");
+	
+	double solar_time = 0, plant_time = 0;
+	uint8_t i;
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		printf("Calculating data for %s\n", locations[i].name);
+		
+		// Solar position once per location
+		double start_time = now_seconds();
+		location_sun_vectors(i, sun);
+		solar_time += now_seconds() - start_time;
+		
+		// Every row against the same sun vectors, rows split across threads
+		start_time = now_seconds();
+		long w;
+		size_t first = 0;
+		for (w=0; w<num_threads; w++)
+		{
+			plant_worker_t *worker = &workers[w];
+			worker->plant = &plant;
+			worker->sun = sun;
+			worker->first = first;
+			worker->count = plant.num_rows / num_threads + ((size_t)w < plant.num_rows % num_threads ? 1 : 0);
+			first += worker->count;
+			plant_stats_init(&worker->stats, worker->count, plant.rom, zone_min, zone_max, ANGLE_BIN_SIZE);
+			if (w > 0 && pthread_create(&worker->thread, NULL, plant_worker_main, worker) != 0)
+			{
+				printf("Error starting worker thread\n");
+				exit(1);
+			}
+		}
+		plant_worker_main(&workers[0]);
+		for (w=1; w<num_threads; w++)
+		{
+			pthread_join(workers[w].thread, NULL);
+		}
+		plant_time += now_seconds() - start_time;
+		
+		// One line per row, the fleet adds up every row
+		char fname[4096];
+		snprintf(fname, sizeof(fname), "PlantSummary_%s.csv", locations[i].name);
+		FILE *row_file = fopen(fname, "w");
+		if (row_file == NULL)
+		{
+			printf("Error opening output file for %s \n", locations[i].name);
+			exit(1);
+		}
+		fprintf(row_file, "ROW,ALPHA,BETA,SLOPE,PITCH,WIDTH,PERCENT_IN_ZONE");
+		for (j=0; j<num_bins; j++)
+		{
+			fprintf(row_file, ",BIN_%.1f", j*ANGLE_BIN_SIZE);
+		}
+		fprintf(row_file, "\n");
+		
+		uint64_t fleet_zone = 0;
+		uint64_t fleet_counts[num_bins];
+		memset(fleet_counts, 0, sizeof(fleet_counts));
+		for (w=0; w<num_threads; w++)
+		{
+			const plant_worker_t *worker = &workers[w];
+			size_t r;
+			for (r=0; r<worker->count; r++)
+			{
+				const plant_row_t *row = &plant.rows[worker->first + r];
+				const uint32_t *counts = &worker->stats.counts[r * num_bins];
+				fprintf(row_file, "%s,%.2f,%.2f,%.2f,%.3f,%.3f,%.3f", row->name, row->alpha, row->beta, row->slope,
+					row->pitch, row->width, 100.0 * worker->stats.zone_minutes[r] / MINUTES_PER_YEAR);
+				for (j=0; j<num_bins; j++)
+				{
+					fprintf(row_file, ",%.3f", 100.0 * counts[j] / MINUTES_PER_YEAR);
+					fleet_counts[j] += counts[j];
+				}
+				fprintf(row_file, "\n");
+				fleet_zone += worker->stats.zone_minutes[r];
+			}
+			if (w > 0)
+			{
+				angle_histogram_merge(&workers[0].stats.fleet, &worker->stats.fleet);
+			}
+		}
+		fclose(row_file);
+		
+		snprintf(fname, sizeof(fname), "PlantHistogram_%s.csv", locations[i].name);
+		FILE *histogram_file = fopen(fname, "w");
+		if (histogram_file == NULL)
+		{
+			printf("Error opening output file for %s \n", locations[i].name);
+			exit(1);
+		}
+		angle_histogram_finalize(&workers[0].stats.fleet);
+		angle_histogram_write(&workers[0].stats.fleet, locations[i].name, histogram_file);
+		fclose(histogram_file);
+		
+		double row_minutes = (double)plant.num_rows * MINUTES_PER_YEAR;
+		locations[i].percent_in_zone = 100.0 * fleet_zone / row_minutes;
+		fprintf(fleet_file, "%s,%zu,%.3f", locations[i].name, plant.num_rows, locations[i].percent_in_zone);
+		for (j=0; j<num_bins; j++)
+		{
+			fprintf(fleet_file, ",%.3f", 100.0 * fleet_counts[j] / row_minutes);
+		}
+		fprintf(fleet_file, "\n");
+		
+		for (w=0; w<num_threads; w++)
+		{
+			plant_stats_free(&workers[w].stats);
+		}
+	}
+	fclose(fleet_file);
+	
+	printf("\nLocation           Fleet %% in Zone [%.1f, %.1f)\n", zone_min, zone_max);
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		printf("%-16s   %.2f%%\n", locations[i].name, locations[i].percent_in_zone);
+	}
+	printf("\nSolar position %.2f s, %zu rows %.2f s (%.1f ns per row-minute)\n",
+		solar_time, plant.num_rows, plant_time, 1e9 * plant_time / ((double)plant.num_rows * NUM_LOCATIONS * MINUTES_PER_YEAR));
+	
+	free(workers);
+	free(sun);
+	plant_free(&plant);
+}
+
+
+/**
+ * @brief
+ *  Time in each bin from the instants the tracker angle crosses the bin edges
+ *
+ *  Runs every location through events_day() instead of sampling each minute,
+ * see events.h, and writes EventSummary_All.csv with the minutes in each
+ * 5 degree bin of |angle|.
+ *
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ */
+static void run_events(double zone_min, double zone_max)
+{
+	uint32_t bins = (uint32_t)(TRACKER_ROM/ANGLE_BIN_SIZE) + 1;
+	events_t events;
+	events_init(&events, &tracker_kernel, zone_min, zone_max, ANGLE_BIN_SIZE, bins);
+	printf("Calculating bin edge crossings for %d locations, %s tracker\n",
+		NUM_LOCATIONS, tracker_geometry_name(tracker_kernel.geometry));
+	
+	FILE *summary_file = fopen("EventSummary_All.csv", "w");
+	if (summary_file == NULL)
+	{
+		printf("Error opening event summary file!\n");
+		exit(1);
+	}
+	fprintf(summary_file, "LOCATION,ANGLE_BIN,MINUTES,PERCENT_OF_TIME\n");
+	
+	double start_time = now_seconds();
+	uint64_t evaluations = 0;
+	uint8_t i;
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		solarpos_site_t site = {locations[i].latitude, locations[i].longitude, locations[i].timezone};
+		double bin_minutes[bins];
+		memset(bin_minutes, 0, sizeof(bin_minutes));
+		events_summary_t summary = {bin_minutes, 0, 0, 0, 0};
+		uint16_t day;
+		for (day=0; day<MINUTES_PER_YEAR/MINUTES_PER_DAY; day++)
+		{
+			events_day(&events, &site, year, day, &summary);
+		}
+		evaluations += summary.evaluations;
+		
+		uint32_t j;
+		for (j=0; j<bins; j++)
+		{
+			fprintf(summary_file, "%s,%.1f,%.3f,%.3f\n",
+				locations[i].name, j*ANGLE_BIN_SIZE, bin_minutes[j], 100 * bin_minutes[j] / summary.total_minutes);
+		}
+		locations[i].percent_in_zone = 100.0 * summary.zone_minutes / summary.total_minutes;
+	}
+	fclose(summary_file);
+	double compute_time = now_seconds() - start_time;
+	
+	printf("\nLocation           %% in Zone [%.1f, %.1f)\n", zone_min, zone_max);
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		printf("%-18s %.2f\n", locations[i].name, locations[i].percent_in_zone);
+	}
+	printf("\nCalculation %.3f s, %.1f solar positions per location-day\n",
+		compute_time, (double)evaluations / (NUM_LOCATIONS * (MINUTES_PER_YEAR/MINUTES_PER_DAY)));
+}
+
+
+/**
+ * @brief
+ *  Percent of time in each bin and in the zone for one site over the year
+ *
+ * @param [in,out] worker pointer to the site_worker_t struct calculating the site
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [out] result num_bins + 1 entries, % in zone then percent of time per bin
+ */
+static void compute_site(site_worker_t *worker, const solarpos_site_t *site, double *result)
+{
+	const site_block_t *block = worker->block;
+	uint32_t j;
+	
+	if (block->events != NULL)
+	{
+		double bin_minutes[num_bins];
+		memset(bin_minutes, 0, sizeof(bin_minutes));
+		events_summary_t summary = {bin_minutes, 0, 0, 0, 0};
+		uint16_t day;
+		for (day=0; day<MINUTES_PER_YEAR/MINUTES_PER_DAY; day++)
+		{
+			events_day(block->events, site, year, day, &summary);
+		}
+		result[0] = 100.0 * summary.zone_minutes / summary.total_minutes;
+		for (j=0; j<num_bins; j++)
+		{
+			result[1 + j] = 100.0 * bin_minutes[j] / summary.total_minutes;
+		}
+		return;
+	}
+	
+	uint32_t counts[num_bins];
+	memset(counts, 0, sizeof(counts));
+	angle_histogram_clear(&worker->hist);
+	compute_days(site, NULL, 0, MINUTES_PER_YEAR/MINUTES_PER_DAY, counts, &worker->hist, NULL, 0);
+	angle_histogram_finalize(&worker->hist);
+	result[0] = 100.0 * angle_histogram_fraction(&worker->hist, block->zone_min, block->zone_max);
+	for (j=0; j<num_bins; j++)
+	{
+		result[1 + j] = 100.0 * counts[j] / MINUTES_PER_YEAR;
+	}
+}
+
+
+/**
+ * @brief
+ *  Site worker thread, takes sites from the current block until there are none left
+ *
+ * @param [in] arg pointer to this thread's site_worker_t struct
+ */
+static void *site_worker_main(void *arg)
+{
+	site_worker_t *worker = arg;
+	site_block_t *block = worker->block;
+	
+	while (1)
+	{
+		pthread_mutex_lock(&chunk_lock);
+		uint32_t n = block->next++;
+		pthread_mutex_unlock(&chunk_lock);
+		
+		if (n >= block->count)
+		{
+			break;
+		}
+		compute_site(worker, &block->entries[n].site, &block->results[n * (num_bins + 1)]);
+	}
+	
+	return(NULL);
+}
+
+
+/**
+ * @brief
+ *  Set up the site block, its workers and the solar position engine
+ *
+ * @param [out] block pointer to site_block_t struct, release with site_block_free()
+ * @param [out] events pointer to events_t struct set up when events_mode is set
+ * @param [in] num_threads number of threads
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ * @param [in] events_mode use events_day() instead of every minute
+ */
+static void site_block_init(site_block_t *block, events_t *events, long num_threads, double zone_min, double zone_max, int events_mode)
+{
+	memset(block, 0, sizeof(*block));
+	num_bins = (uint32_t)(TRACKER_ROM/ANGLE_BIN_SIZE) + 1;
+	block->zone_min = zone_min;
+	block->zone_max = zone_max;
+	if (events_mode)
+	{
+		events_init(events, &tracker_kernel, zone_min, zone_max, ANGLE_BIN_SIZE, num_bins);
+		block->events = events;
+	}
+	else
+	{
+		// every site shares the site independent terms of each UTC minute
+		build_ephemeris();
+	}
+	
+	block->entries = calloc(SITES_BLOCK, sizeof(site_entry_t));
+	block->results = malloc(SITES_BLOCK * (num_bins + 1) * sizeof(double));
+	block->workers = calloc(num_threads, sizeof(site_worker_t));
+	if (block->entries == NULL || block->results == NULL || block->workers == NULL)
+	{
+		printf("Error allocating site data\n");
+		exit(1);
+	}
+	block->num_threads = num_threads;
+	long w;
+	for (w=0; w<num_threads; w++)
+	{
+		block->workers[w].block = block;
+		angle_histogram_init(&block->workers[w].hist, -TRACKER_ROM, TRACKER_ROM, HISTOGRAM_BIN_SIZE);
+	}
+}
+
+
+/**
+ * @brief
+ *  Calculate the sites in a block, split across the workers, the main thread is worker 0
+ *
+ * @param [in,out] block pointer to site_block_t struct with count sites filled in
+ */
+static void site_block_compute(site_block_t *block)
+{
+	long w;
+	block->next = 0;
+	long block_threads = (block->num_threads < (long)block->count) ? block->num_threads : (long)block->count;
+	for (w=1; w<block_threads; w++)
+	{
+		if (pthread_create(&block->workers[w].thread, NULL, site_worker_main, &block->workers[w]) != 0)
+		{
+			printf("Error starting worker thread\n");
+			exit(1);
+		}
+	}
+	site_worker_main(&block->workers[0]);
+	for (w=1; w<block_threads; w++)
+	{
+		pthread_join(block->workers[w].thread, NULL);
+	}
+}
+
+
+static void site_block_free(site_block_t *block)
+{
+	long w;
+	for (w=0; w<block->num_threads; w++)
+	{
+		angle_histogram_free(&block->workers[w].hist);
+	}
+	free(block->workers);
+	free(block->results);
+	free(block->entries);
+	ephemeris_free(&ephemeris);
+}
+
+
+/**
+ * @brief
+ *  Site list mode, every site in a CSV file, see sites.h
+ *
+ *  The list is read SITES_BLOCK sites at a time, each block is split across
+ * the worker threads and its results are appended to SiteSummary.csv, one row
+ * per site in the order of the list, before the next block is read. Memory
+ * use and the number of open files do not grow with the length of the list,
+ * and no per-site files are written.
+ *
+ * @param [in] path site list file name, "-" for standard input
+ * @param [in] num_threads number of threads
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ * @param [in] events_mode use events_day() instead of every minute
+ */
+static void run_sites(const char *path, long num_threads, double zone_min, double zone_max, int events_mode)
+{
+	site_reader_t reader;
+	if (site_reader_open(&reader, path) != 0)
+	{
+		printf("Error opening site list %s\n", path);
+		exit(1);
+	}
+	
+	site_block_t block;
+	events_t events;
+	site_block_init(&block, &events, num_threads, zone_min, zone_max, events_mode);
+	
+	FILE *summary_file = fopen("SiteSummary.csv", "w");
+	if (summary_file == NULL)
+	{
+		printf("Error opening site summary file!\n");
+		exit(1);
+	}
+	fprintf(summary_file, "LOCATION,LATITUDE,LONGITUDE,TIMEZONE,PERCENT_IN_ZONE");
+	uint32_t j;
+	for (j=0; j<num_bins; j++)
+	{
+		fprintf(summary_file, ",BIN_%.1f", j*ANGLE_BIN_SIZE);
+	}
+	fprintf(summary_file, "\n");
+	
+	printf("Calculating sites from %s with %ld thread(s), %s tracker%s\n", path, num_threads,
+		tracker_geometry_name(tracker_kernel.geometry), events_mode ? ", bin edge crossings" : "");
+	uint64_t num_sites = 0;
+	double compute_time = 0, write_time = 0;
+	int status = 1;
+	while (status == 1)
+	{
+		// Read the next block
+		block.count = 0;
+		while (block.count < SITES_BLOCK && (status = site_reader_next(&reader, &block.entries[block.count])) == 1)
+		{
+			block.count++;
+		}
+		if (status < 0)
+		{
+			printf("Invalid site on line %" PRIu64 " of %s, expected NAME,LATITUDE,LONGITUDE,TIMEZONE\n", reader.line, path);
+			exit(1);
+		}
+		
+		double start_time = now_seconds();
+		site_block_compute(&block);
+		compute_time += now_seconds() - start_time;
+		
+		// Write it in list order
+		start_time = now_seconds();
+		uint32_t n;
+		for (n=0; n<block.count; n++)
+		{
+			const site_entry_t *entry = &block.entries[n];
+			const double *result = &block.results[n * (num_bins + 1)];
+			fprintf(summary_file, "%s,%.6f,%.6f,%d", entry->name, entry->site.latitude, entry->site.longitude, entry->site.timezone);
+			for (j=0; j<=num_bins; j++)
+			{
+				fprintf(summary_file, ",%.3f", result[j]);
+			}
+			fprintf(summary_file, "\n");
+		}
+		write_time += now_seconds() - start_time;
+		num_sites += block.count;
+	}
+	
+	if (fclose(summary_file) != 0)
+	{
+		printf("Error writing site summary file!\n");
+		exit(1);
+	}
+	site_reader_close(&reader);
+	site_block_free(&block);
+	
+	printf("%" PRIu64 " sites written to SiteSummary.csv, %% in zone [%.1f, %.1f)\n", num_sites, zone_min, zone_max);
+	printf("\nCalculation %.2f s (%.1f ms per site), output %.2f s\n",
+		compute_time, (num_sites > 0) ? 1e3 * compute_time / num_sites : 0.0, write_time);
+}
+
+
+/**
+ * @brief
+ *  Raster mode, % in zone and |angle| histogram maps over a latitude/longitude grid
+ *
+ *  Cells are generated in file order (south to north, west to east)
+ * SITES_BLOCK at a time and calculated like a site list, each cell at its
+ * centre with the nominal time zone of its longitude. The site independent
+ * solar terms of every UTC minute come from the shared ephemeris table, so
+ * each cell only repeats the hour angle, elevation and azimuth step. Results
+ * go straight to the raster file, see raster_file.h, so memory does not grow
+ * with the grid.
+ *
+ * @param [in] path output raster file name
+ * @param [in] lat_min southern edge in degrees
+ * @param [in] lon_min western edge in degrees
+ * @param [in] resolution cell size in degrees
+ * @param [in] rows number of rows
+ * @param [in] cols number of columns
+ * @param [in] num_threads number of threads
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ * @param [in] events_mode use events_day() instead of every minute
+ */
+static void run_raster(const char *path, double lat_min, double lon_min, double resolution, uint32_t rows, uint32_t cols,
+	long num_threads, double zone_min, double zone_max, int events_mode)
+{
+	site_block_t block;
+	events_t events;
+	site_block_init(&block, &events, num_threads, zone_min, zone_max, events_mode);
+	
+	raster_file_header_t header;
+	raster_file_header_init(&header, lat_min, lon_min, resolution, rows, cols, num_bins + 1);
+	header.year = year;
+	header.zone_min = zone_min;
+	header.zone_max = zone_max;
+	header.bin_size = ANGLE_BIN_SIZE;
+	header.events = events_mode;
+	raster_writer_t writer;
+	if (raster_file_create(&writer, path, &header) != 0)
+	{
+		printf("Error opening raster file %s\n", path);
+		exit(1);
+	}
+	
+	uint64_t num_cells = (uint64_t)rows * cols;
+	printf("Calculating %" PRIu32 " x %" PRIu32 " raster (%" PRIu64 " cells) with %ld thread(s), %s tracker%s\n",
+		rows, cols, num_cells, num_threads, tracker_geometry_name(tracker_kernel.geometry), events_mode ? ", bin edge crossings" : "");
+	double compute_time = 0, write_time = 0;
+	double zone_low = 100.0, zone_high = 0.0, zone_sum = 0.0;
+	uint64_t cell = 0;
+	while (cell < num_cells)
+	{
+		// Next block of cells
+		block.count = 0;
+		while (block.count < SITES_BLOCK && cell < num_cells)
+		{
+			uint32_t r = cell / cols, c = cell % cols;
+			solarpos_site_t *site = &block.entries[block.count].site;
+			site->latitude = lat_min + (r + 0.5) * resolution;
+			site->longitude = lon_min + (c + 0.5) * resolution;
+			site->timezone = (int8_t)lround(site->longitude / 15.0);
+			block.count++;
+			cell++;
+		}
+		
+		double start_time = now_seconds();
+		site_block_compute(&block);
+		compute_time += now_seconds() - start_time;
+		
+		start_time = now_seconds();
+		raster_file_write_cells(&writer, block.results, block.count);
+		uint32_t n;
+		for (n=0; n<block.count; n++)
+		{
+			double zone = block.results[n * (num_bins + 1)];
+			zone_low = (zone < zone_low) ? zone : zone_low;
+			zone_high = (zone > zone_high) ? zone : zone_high;
+			zone_sum += zone;
+		}
+		write_time += now_seconds() - start_time;
+	}
+	
+	if (raster_file_finish(&writer) != 0)
+	{
+		printf("Error writing raster file %s\n", path);
+		exit(1);
+	}
+	site_block_free(&block);
+	
+	printf("%" PRIu64 " cells written to %s, %% in zone [%.1f, %.1f) min %.2f, mean %.2f, max %.2f\n",
+		num_cells, path, zone_min, zone_max, zone_low, zone_sum / num_cells, zone_high);
+	printf("\nCalculation %.2f s (%.1f ms per cell), output %.2f s\n",
+		compute_time, 1e3 * compute_time / num_cells, write_time);
+}
+
+
+/**
+ * @brief
+ *  Tracker angle at every timestamp of a weather file time series
+ *
+ *  The timestamps are streamed from the memory mapped file TIMESERIES_BATCH
+ * rows at a time, see timeseries.h, and each batch goes through the batch
+ * solar position and the tracker with shade avoidance in one
+ * trackerangle_batch() call. TrackerAngle_Input.csv gets one row per input
+ * row in the same order, the timestamp as it was in the file and the angle,
+ * formatted into a fixed buffer. Memory does not grow with the file.
+ *
+ * @param [in] path time series file name
+ * @param [in] site pointer to solarpos_site_t struct
+ */
+static void run_input(const char *path, const solarpos_site_t *site)
+{
+	timeseries_t series;
+	int status = timeseries_open(&series, path, site->timezone);
+	if (status != 0)
+	{
+		if (status == -1)
+		{
+			printf("Error opening time series %s\n", path);
+		}
+		else
+		{
+			printf("No timestamp in the first %d lines of %s\n", TIMESERIES_MAX_HEADER, path);
+		}
+		exit(1);
+	}
+	FILE *file = fopen("TrackerAngle_Input.csv", "w");
+	if (file == NULL)
+	{
+		printf("Error opening TrackerAngle_Input.csv\n");
+		exit(1);
+	}
+	fprintf(file, "TIMESTAMP,ANGLE\n");
+	
+	trackerangle_t config;
+	trackerangle_init(&config, &tracker, site);
+	printf("Calculating %s at %.6f, %.6f (UTC%+d), %s tracker\n", path, site->latitude, site->longitude,
+		site->timezone, tracker_geometry_name(tracker_kernel.geometry));
+	
+	static timeseries_field_t fields[TIMESERIES_BATCH];
+	static double time[TIMESERIES_BATCH];
+	static double angle[TIMESERIES_BATCH];
+	static char buf[RAW_CSV_BUFFER];
+	size_t len = 0, count, i;
+	uint64_t rows = 0;
+	double compute_time = 0, write_time = 0;
+	int ok = 1;
+	for (;;)
+	{
+		if (timeseries_read(&series, fields, time, TIMESERIES_BATCH, &count) != 0)
+		{
+			printf("Invalid timestamp in %s line %" PRIu64 "\n", path, series.line);
+			exit(1);
+		}
+		if (count == 0)
+		{
+			break;
+		}
+		double start_time = now_seconds();
+		trackerangle_batch(&config, time, count, angle);
+		compute_time += now_seconds() - start_time;
+		
+		start_time = now_seconds();
+		for (i=0; i<count; i++)
+		{
+			if (len + TIMESERIES_MAX_FIELD + RAW_CSV_MAX_ANGLE + 2 > sizeof(buf))
+			{
+				ok &= (fwrite(buf, 1, len, file) == len);
+				len = 0;
+			}
+			// a TMY3 date and time in two fields is written as one, "MM/DD/YYYY HH:MM"
+			const char *text = fields[i].text;
+			uint32_t n = fields[i].len, k;
+			if (memchr(text, ',', n) == NULL && memchr(text, '"', n) == NULL)
+			{
+				memcpy(buf + len, text, n);
+				len += n;
+			}
+			else
+			{
+				for (k=0; k<n; k++)
+				{
+					if (text[k] != '"')
+					{
+						buf[len++] = (text[k] == ',') ? ' ' : text[k];
+					}
+				}
+			}
+			buf[len++] = ',';
+			len += raw_csv_format_angle(buf + len, angle[i]);
+			buf[len++] = '\n';
+		}
+		rows += count;
+		write_time += now_seconds() - start_time;
+	}
+	ok &= (fwrite(buf, 1, len, file) == len);
+	if (fclose(file) != 0 || !ok)
+	{
+		printf("Error writing TrackerAngle_Input.csv\n");
+		exit(1);
+	}
+	timeseries_close(&series);
+	
+	printf("%" PRIu64 " rows written to TrackerAngle_Input.csv\n", rows);
+	printf("\nCalculation %.2f s (%.1f ns per row), input and output %.2f s\n",
+		compute_time, (rows > 0) ? 1e9 * compute_time / rows : 0.0, write_time);
+}
+
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [--threads N] [--binary] [--summary-only] [--decimate N] [--zone A:B] [--sweep SPEC] [--cache DIR] [--events] [--sites FILE] [--raster SPEC] [--plant FILE] [--input FILE --site LAT,LON,TZ]\n", prog);
+	printf("  -t, --threads N   number of worker threads, 0 = one per CPU (default 1)\n");
+	printf("  -b, --binary      write TrackerAngle_<site>.bin (see angle_file.h) instead of .csv\n");
+	printf("  -s, --summary-only  only write the summary files, no per-minute raw data\n");
+	printf("  -d, --decimate N  keep every Nth minute in the raw data file, also with --summary-only\n");
+	printf("  -z, --zone A:B    angle range in degrees for the %% in zone table (default -5:5)\n");
+	printf("  -w, --sweep SPEC  evaluate a grid of tracker configurations instead, e.g.\n");
+	printf("                    gcr=0.3:0.5:0.05,rom=45:60:5,stow=-10,alpha=0,beta=0:10:5\n");
+	printf("  -c, --cache DIR   keep each location's solar position in DIR and reuse it on later runs\n");
+	printf("  -e, --events      time in each bin from the bin edge crossings instead of every minute,\n");
+	printf("                    writes EventSummary_All.csv\n");
+	printf("  -l, --sites FILE  every site in a NAME,LATITUDE,LONGITUDE,TIMEZONE list instead of the\n");
+	printf("                    built in locations (- for stdin), writes SiteSummary.csv only\n");
+	printf("  -r, --raster SPEC %% in zone and histogram maps over LAT_MIN:LAT_MAX:LON_MIN:LON_MAX:RES\n");
+	printf("                    degrees, writes ZoneRaster.bin (see raster_file.h) only\n");
+	printf("  -p, --plant FILE  every tracker row in a NAME,ALPHA,BETA,SLOPE,PITCH,WIDTH row table, with\n");
+	printf("                    terrain-aware backtracking, writes PlantSummary_<site>.csv,\n");
+	printf("                    PlantHistogram_<site>.csv and PlantFleet_All.csv\n");
+	printf("  -i, --input FILE  angle at every timestamp of a weather file time series (ISO 8601 or TMY3\n");
+	printf("                    date and time columns) at --site, writes TrackerAngle_Input.csv only\n");
+	printf("  -a, --site LAT,LON,TZ  site of --input, degrees and local standard time zone in hours\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	uint8_t month;
+	tracker.rom = TRACKER_ROM;
+	tracker.gcr = TRACKER_GCR;
+	tracker.night_stow = TRACKER_STOW;
+	tracker.alpha = 0;
+	tracker.beta = 0;
+	
+	long num_threads = 1;
+	int binary_output = 0;
+	int summary_only = 0;
+	const char *sweep_text = NULL;
+	const char *cache_dir = NULL;
+	int events_mode = 0;
+	const char *sites_path = NULL;
+	const char *raster_text = NULL;
+	const char *plant_path = NULL;
+	const char *input_path = NULL;
+	solarpos_site_t input_site;
+	int have_site = 0;
+	double zone_min = -5.0, zone_max = 5.0;
+	static const struct option long_options[] = {
+		{"threads", required_argument, NULL, 't'},
+		{"binary",  no_argument,       NULL, 'b'},
+		{"summary-only", no_argument,  NULL, 's'},
+		{"decimate", required_argument, NULL, 'd'},
+		{"zone",    required_argument, NULL, 'z'},
+		{"sweep",   required_argument, NULL, 'w'},
+		{"cache",   required_argument, NULL, 'c'},
+		{"events",  no_argument,       NULL, 'e'},
+		{"sites",   required_argument, NULL, 'l'},
+		{"raster",  required_argument, NULL, 'r'},
+		{"plant",   required_argument, NULL, 'p'},
+		{"input",   required_argument, NULL, 'i'},
+		{"site",    required_argument, NULL, 'a'},
+		{"help",    no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "t:bsd:z:w:c:el:r:p:i:a:h", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 't':
+				num_threads = strtol(optarg, NULL, 10);
+				if (num_threads == 0)
+				{
+					num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+				}
+				if (num_threads < 1)
+				{
+					printf("Invalid thread count %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'b':
+				binary_output = 1;
+				break;
+			case 's':
+				summary_only = 1;
+				break;
+			case 'd':
+				raw_step = strtoul(optarg, NULL, 10);
+				if (raw_step < 1)
+				{
+					printf("Invalid decimation %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'z':
+				if (sscanf(optarg, "%lf:%lf", &zone_min, &zone_max) != 2 || zone_max <= zone_min)
+				{
+					printf("Invalid zone %s, expected MIN:MAX in degrees\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'w':
+				sweep_text = optarg;
+				break;
+			case 'c':
+				cache_dir = optarg;
+				break;
+			case 'e':
+				events_mode = 1;
+				break;
+			case 'l':
+				sites_path = optarg;
+				break;
+			case 'r':
+				raster_text = optarg;
+				break;
+			case 'p':
+				plant_path = optarg;
+				break;
+			case 'i':
+				input_path = optarg;
+				break;
+			case 'a':
+			{
+				int tz;
+				if (sscanf(optarg, "%lf,%lf,%d", &input_site.latitude, &input_site.longitude, &tz) != 3
+					|| input_site.latitude < -90.0 || input_site.latitude > 90.0 || tz < -12 || tz > 14)
+				{
+					printf("Invalid site %s, expected LAT,LON,TZ\n", optarg);
+					exit(1);
+				}
+				input_site.timezone = tz;
+				have_site = 1;
+				break;
+			}
+			case 'h':
+				usage(argv[0]);
+				exit(0);
+			default:
+				usage(argv[0]);
+				exit(1);
+		}
+	}
+	
+	tracker_kernel_init(&tracker_kernel, &tracker);
+	
+	if (input_path != NULL)
+	{
+		if (!have_site)
+		{
+			printf("--input needs --site LAT,LON,TZ\n");
+			exit(1);
+		}
+		if (sweep_text != NULL || sites_path != NULL || raster_text != NULL || plant_path != NULL || events_mode || cache_dir != NULL)
+		{
+			printf("--input cannot be combined with --sweep, --sites, --raster, --plant, --events or --cache\n");
+			exit(1);
+		}
+		run_input(input_path, &input_site);
+		exit(0);
+	}
+	
+	if (plant_path != NULL)
+	{
+		if (sweep_text != NULL || sites_path != NULL || raster_text != NULL || events_mode)
+		{
+			printf("--plant cannot be combined with --sweep, --sites, --raster or --events\n");
+			exit(1);
+		}
+		if (cache_dir != NULL)
+		{
+			load_solar_caches(cache_dir);
+		}
+		else
+		{
+			build_ephemeris();
+		}
+		run_plant(plant_path, num_threads, zone_min, zone_max);
+		ephemeris_free(&ephemeris);
+		exit(0);
+	}
+	
+	if (sites_path != NULL || raster_text != NULL)
+	{
+		if (sweep_text != NULL || (sites_path != NULL && raster_text != NULL))
+		{
+			printf("--sites, --raster and --sweep cannot be combined\n");
+			exit(1);
+		}
+		if (cache_dir != NULL)
+		{
+			printf("Note: --cache is not used with --sites or --raster\n");
+		}
+		if (sites_path != NULL)
+		{
+			run_sites(sites_path, num_threads, zone_min, zone_max, events_mode);
+			exit(0);
+		}
+		
+		double lat_min, lat_max, lon_min, lon_max, resolution;
+		if (sscanf(raster_text, "%lf:%lf:%lf:%lf:%lf", &lat_min, &lat_max, &lon_min, &lon_max, &resolution) != 5
+			|| lat_min < -90.0 || lat_max > 90.0 || lat_max <= lat_min
+			|| lon_min < -180.0 || lon_max > 180.0 || lon_max <= lon_min || resolution <= 0.0)
+		{
+			printf("Invalid raster %s, expected LAT_MIN:LAT_MAX:LON_MIN:LON_MAX:RES in degrees\n", raster_text);
+			exit(1);
+		}
+		double rows = ceil((lat_max - lat_min) / resolution - 1e-9);
+		double cols = ceil((lon_max - lon_min) / resolution - 1e-9);
+		if (rows * cols > UINT32_MAX)
+		{
+			printf("Invalid raster %s, too many cells\n", raster_text);
+			exit(1);
+		}
+		run_raster("ZoneRaster.bin", lat_min, lon_min, resolution, (uint32_t)rows, (uint32_t)cols,
+			num_threads, zone_min, zone_max, events_mode);
+		exit(0);
+	}
+	
+	if (events_mode)
+	{
+		run_events(zone_min, zone_max);
+		exit(0);
+	}
+	
+	if (sweep_text != NULL)
+	{
+		sweep_spec_t spec;
+		if (sweep_parse(sweep_text, &tracker, &spec) != 0)
+		{
+			printf("Invalid sweep %s\n", sweep_text);
+			exit(1);
+		}
+		if (cache_dir != NULL)
+		{
+			load_solar_caches(cache_dir);
+		}
+		else
+		{
+			build_ephemeris();
+		}
+		run_sweep(&spec, num_threads, zone_min, zone_max);
+		ephemeris_free(&ephemeris);
+		exit(0);
+	}
+	
+	if (summary_only && raw_step == 1)
+	{
+		raw_step = 0;
+	}
+	uint32_t raw_count = (raw_step != 0) ? (MINUTES_PER_YEAR + raw_step - 1) / raw_step : 0;
+	
+	FILE *summary_file = fopen("AngleSummary_All.csv", "w");
+	if (summary_file == NULL)
+	{
+		printf("Error opening summary file!\n");
+		exit(1);
+	}
+	fprintf(summary_file, "LOCATION,ANGLE_BIN,COUNT,PERCENT_OF_TIME\n");
+	
+	// Site independent solar terms for the whole year, shared by every location,
+	// or the saved solar position of each location when caching
+	if (cache_dir != NULL)
+	{
+		load_solar_caches(cache_dir);
+	}
+	else
+	{
+		build_ephemeris();
+	}
+	
+	month_start[0] = 0;
+	for (month=1; month<12; month++)
+	{
+		month_start[month] = month_start[month-1] + month_days[month-1] * MINUTES_PER_DAY;
+	}
+	
+	// Raw CSV rows are written by the writer thread from the output ring while the
+	// workers run, the binary file needs the whole year of each location
+	uint8_t i;
+	pthread_t writer;
+	if (raw_step != 0 && !binary_output)
+	{
+		ring_slots = num_threads + OUTPUT_RING_DEPTH;
+		ring = malloc((size_t)ring_slots * MAX_MONTH_MINUTES * sizeof(double));
+		ring_done = calloc(ring_slots, 1);
+		if (ring == NULL || ring_done == NULL)
+		{
+			printf("Error allocating output ring\n");
+			exit(1);
+		}
+		if (pthread_create(&writer, NULL, writer_main, NULL) != 0)
+		{
+			printf("Error starting writer thread\n");
+			exit(1);
+		}
+	}
+	for (i=0; i<NUM_LOCATIONS && raw_count != 0 && ring_slots == 0; i++)
+	{
+		angles[i] = malloc(raw_count * sizeof(double));
+		if (angles[i] == NULL)
+		{
+			printf("Error allocating angle data for %s \n", locations[i].name);
+			exit(1);
+		}
+	}
+	num_bins = (uint32_t)(TRACKER_ROM/ANGLE_BIN_SIZE) + 1;
+	
+	// Calculate every location x month chunk, the main thread is worker 0
+	printf("Calculating data for %d locations with %ld thread(s), %s tracker\n",
+		NUM_LOCATIONS, num_threads, tracker_geometry_name(tracker_kernel.geometry));
+	double start_time = now_seconds();
+	worker_t *workers = calloc(num_threads, sizeof(worker_t));
+	if (workers == NULL)
+	{
+		printf("Error allocating workers\n");
+		exit(1);
+	}
+	long w;
+	for (w=0; w<num_threads; w++)
+	{
+		workers[w].counts = calloc(NUM_LOCATIONS * num_bins, sizeof(uint32_t));
+		if (workers[w].counts == NULL)
+		{
+			printf("Error allocating worker histogram\n");
+			exit(1);
+		}
+		for (i=0; i<NUM_LOCATIONS; i++)
+		{
+			angle_histogram_init(&workers[w].hist[i], -TRACKER_ROM, TRACKER_ROM, HISTOGRAM_BIN_SIZE);
+		}
+		if (w > 0 && pthread_create(&workers[w].thread, NULL, worker_main, &workers[w]) != 0)
+		{
+			printf("Error starting worker thread\n");
+			exit(1);
+		}
+	}
+	worker_main(&workers[0]);
+	for (w=1; w<num_threads; w++)
+	{
+		pthread_join(workers[w].thread, NULL);
+	}
+	double compute_time = now_seconds() - start_time;
+	start_time = now_seconds();
+	if (ring_slots != 0)
+	{
+		pthread_join(writer, NULL);
+		free(ring);
+		free(ring_done);
+	}
+	
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		printf("Writing data for %s\n", locations[i].name);
+		
+		// Merge the worker histograms into the summary struct
+		location_summary_t location_summary[num_bins];
+		uint32_t j;
+		for (j=0; j<num_bins; j++)
+		{
+			location_summary[j].angle_bin = j*ANGLE_BIN_SIZE;
+			location_summary[j].count = 0;
+			for (w=0; w<num_threads; w++)
+			{
+				location_summary[j].count += workers[w].counts[i*num_bins + j];
+			}
+		}
+		
+		// Save to raw data file, the writer thread has already written the CSV one
+		char fname[4096];
+		if (raw_step != 0 && binary_output)
+		{
+			angle_file_header_t header;
+			angle_file_header_init(&header, locations[i].name, locations[i].latitude, locations[i].longitude, locations[i].timezone);
+			header.year = year;
+			header.count = raw_count;
+			header.step_seconds = 60 * raw_step;
+			
+			snprintf(fname, sizeof(fname), "TrackerAngle_%s.bin", locations[i].name);
+			if (angle_file_write(fname, &header, angles[i]) != 0)
+			{
+				printf("Error writing output file for %s \n", locations[i].name);
+				exit(1);
+			}
+		}
+		free(angles[i]);
+		
+		// Write angle summary file
+		snprintf(fname, sizeof(fname), "AngleSummary_%s.csv", locations[i].name);
+		FILE *location_summary_file = fopen(fname, "w");
+		if (location_summary_file == NULL)
+		{
+			printf("Error opening output file for %s \n", locations[i].name);
+			exit(1);
+		}
+		fprintf(location_summary_file, "LOCATION,ANGLE_BIN,COUNT,PERCENT_OF_TIME\n");
+		for (j=0; j<num_bins; j++)
+		{
+			fprintf(location_summary_file, "%s,%.1f,%d,%.3f\n",
+				locations[i].name, location_summary[j].angle_bin, location_summary[j].count, (100 * (double)location_summary[j].count/(365*24*60)) );
+				
+			fprintf(summary_file, "%s,%.1f,%d,%.3f\n",
+				locations[i].name, location_summary[j].angle_bin, location_summary[j].count, (100 * (double)location_summary[j].count/(365*24*60)) );
+		}
+		fclose(location_summary_file);
+		
+		// Merge the fine histograms and save them next to the summary
+		angle_histogram_t *hist = &workers[0].hist[i];
+		for (w=1; w<num_threads; w++)
+		{
+			angle_histogram_merge(hist, &workers[w].hist[i]);
+		}
+		angle_histogram_finalize(hist);
+		
+		snprintf(fname, sizeof(fname), "AngleHistogram_%s.csv", locations[i].name);
+		FILE *histogram_file = fopen(fname, "w");
+		if (histogram_file == NULL)
+		{
+			printf("Error opening output file for %s \n", locations[i].name);
+			exit(1);
+		}
+		angle_histogram_write(hist, locations[i].name, histogram_file);
+		fclose(histogram_file);
+		
+		// Calculate percent of time this location's tracker is within the range of interest
+		locations[i].percent_in_zone = 100.0 * angle_histogram_fraction(hist, zone_min, zone_max);
+	}
+	
+	fclose(summary_file);
+	ephemeris_free(&ephemeris);
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		solar_cache_close(&solar_caches[i]);
+	}
+	double write_time = now_seconds() - start_time;
+	for (w=0; w<num_threads; w++)
+	{
+		free(workers[w].counts);
+		for (i=0; i<NUM_LOCATIONS; i++)
+		{
+			angle_histogram_free(&workers[w].hist[i]);
+		}
+	}
+	free(workers);
+	
+	// Print a table showing percent of time at +/- 5 degrees for each location
+	printf("\nLocation           %% in Zone [%.1f, %.1f)\n", zone_min, zone_max);
+	for (i=0; i<NUM_LOCATIONS; i++)
+	{
+		printf("%-18s %.2f\n", locations[i].name, locations[i].percent_in_zone);
+	}
+	
+	printf("\nCalculation %.2f s%s, output %.2f s\n", compute_time,
+		(raw_step != 0 && !binary_output) ? " with the raw data written alongside" : "", write_time);
+	if (raw_step != 1)
+	{
+		// Estimate what the full per-minute output would have cost
+		uint64_t skipped_rows = (uint64_t)NUM_LOCATIONS * (MINUTES_PER_YEAR - raw_count);
+		if (binary_output)
+		{
+			printf("Skipped %" PRIu64 " raw samples (%.1f MB of binary)\n",
+				skipped_rows, skipped_rows * sizeof(int16_t) / 1e6);
+		}
+		else
+		{
+			double row_bytes, row_seconds;
+			measure_raw_row_cost(&row_bytes, &row_seconds);
+			printf("Skipped %" PRIu64 " raw rows (~%.1f MB of CSV), est. %.2f s of output saved\n",
+				skipped_rows, skipped_rows * row_bytes / 1e6, skipped_rows * row_seconds);
+		}
 	}
 	
 	exit(0);
@@ -0,0 +1,466 @@
+/**
+ * @file	plant.c
+ *
+ * @brief
+ *   Per-row tracker angles and histograms for a plant layout
+ *
+ *  A plant layout is a CSV file with one tracker row per line,
+ *
+ *     NAME,ALPHA,BETA,SLOPE,PITCH,WIDTH
+ *
+ * with the axis yaw and tilt as in tracker_t, the cross-axis slope of the
+ * ground the row stands on, the row to row pitch and the collector width.
+ * The first line may be a column header, blank lines and lines starting with
+ * '#' are skipped. Range of motion and night stow are the same for every row.
+ *
+ *  Backtracking on sloped ground follows the terrain-aware form of
+ * shade_avoidance_angle(): a row at ideal angle R with cross-axis slope S
+ * backtracks while
+ *
+ *     x = |cos(R - S)| * pitch / (width * cos(S)) < 1
+ *
+ * to R -/+ acos(x), which on flat ground is the usual cos(R) / gcr test.
+ *
+ *  Rows are kept in structure of arrays form and evaluated PLANT_ROW_BLOCK at
+ * a time against each sun vector, so one sun position is shared by the
+ * whole block and the block's row data and counts stay in cache while the
+ * year of sun vectors streams past.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <assert.h>
+
+#include "plant.h"
+#include "angle_conversions.h"
+
+#define PLANT_FIELDS	6
+
+
+/// strip leading and trailing white space in place
+static char *trim(char *text)
+{
+	while (isspace((unsigned char)*text))
+	{
+		text++;
+	}
+	char *end = text + strlen(text);
+	while (end > text && isspace((unsigned char)end[-1]))
+	{
+		end--;
+	}
+	*end = '\0';
+	return(text);
+}
+
+
+/// parse a whole field as a number, 0 on success
+static int parse_number(const char *text, double *value)
+{
+	char *end;
+	*value = strtod(text, &end);
+	return((end == text || *end != '\0') ? -1 : 0);
+}
+
+
+/**
+ * @brief
+ *  Parse one line of a plant layout
+ *
+ * @param [in,out] text line, split in place
+ * @param [out] row pointer to plant_row_t struct
+ *
+ * @return 1 for a row, 0 for a line without numbers (a header), -1 if the line is not valid
+ */
+static int parse_row(char *text, plant_row_t *row)
+{
+	char *field[PLANT_FIELDS];
+	int n = 0;
+	char *next = text;
+	while (n < PLANT_FIELDS && next != NULL)
+	{
+		field[n++] = next;
+		next = strchr(next, ',');
+		if (next != NULL)
+		{
+			*next++ = '\0';
+		}
+	}
+	if (n != PLANT_FIELDS || next != NULL)
+	{
+		return(-1);
+	}
+	for (n=0; n<PLANT_FIELDS; n++)
+	{
+		field[n] = trim(field[n]);
+	}
+
+	if (parse_number(field[1], &row->alpha) != 0)
+	{
+		return(0);
+	}
+	if (parse_number(field[2], &row->beta) != 0 || parse_number(field[3], &row->slope) != 0 ||
+		parse_number(field[4], &row->pitch) != 0 || parse_number(field[5], &row->width) != 0)
+	{
+		return(-1);
+	}
+	if (*field[0] == '\0' || strlen(field[0]) >= PLANT_MAX_NAME ||
+		fabs(row->beta) >= 90.0 || fabs(row->slope) >= 90.0 ||
+		!(row->width > 0.0) || !(row->pitch >= row->width))
+	{
+		return(-1);
+	}
+	strcpy(row->name, field[0]);
+	return(1);
+}
+
+
+/**
+ * @brief
+ *  Prepare a plant layout for plant_evaluate()
+ *
+ * @param [out] plant pointer to plant_t struct, release with plant_free()
+ * @param [in] rows array of num_rows rows, copied
+ * @param [in] num_rows number of rows
+ * @param [in] tracker pointer to tracker_t struct, rom and night_stow are used for every row
+ */
+void plant_init(plant_t *plant, const plant_row_t *rows, size_t num_rows, const tracker_t *tracker)
+{
+	size_t n = num_rows;
+	memset(plant, 0, sizeof(*plant));
+	plant->num_rows = n;
+	plant->rows = malloc(n * sizeof(plant_row_t));
+	plant->rom = tracker->rom;
+	plant->night_stow = tracker->night_stow;
+	plant->sin_alpha = malloc(n * sizeof(double));
+	plant->cos_alpha = malloc(n * sizeof(double));
+	plant->sin_beta = malloc(n * sizeof(double));
+	plant->cos_beta = malloc(n * sizeof(double));
+	plant->sin_slope = malloc(n * sizeof(double));
+	plant->cos_slope = malloc(n * sizeof(double));
+	plant->axis_ratio = malloc(n * sizeof(double));
+	plant->stow_angle = malloc(n * sizeof(double));
+	assert((plant->rows != NULL && plant->sin_alpha != NULL && plant->cos_alpha != NULL && plant->sin_beta != NULL &&
+		plant->cos_beta != NULL && plant->sin_slope != NULL && plant->cos_slope != NULL && plant->axis_ratio != NULL &&
+		plant->stow_angle != NULL) || n == 0);
+
+	size_t r;
+	for (r=0; r<n; r++)
+	{
+		const plant_row_t *row = &rows[r];
+		plant->rows[r] = *row;
+		plant->sin_alpha[r] = sin(deg2rad(row->alpha));
+		plant->cos_alpha[r] = cos(deg2rad(row->alpha));
+		plant->sin_beta[r] = sin(deg2rad(row->beta));
+		plant->cos_beta[r] = cos(deg2rad(row->beta));
+		plant->sin_slope[r] = sin(deg2rad(row->slope));
+		plant->cos_slope[r] = cos(deg2rad(row->slope));
+		plant->axis_ratio[r] = row->pitch / (row->width * plant->cos_slope[r]);
+		plant->stow_angle[r] = plant_backtrack_exact(plant->night_stow, row->slope, plant->axis_ratio[r], plant->rom);
+	}
+}
+
+
+/**
+ * @brief
+ *  Read a plant layout and prepare it for plant_evaluate()
+ *
+ * @param [out] plant pointer to plant_t struct, release with plant_free()
+ * @param [in] path file name
+ * @param [in] tracker pointer to tracker_t struct, rom and night_stow are used for every row
+ * @param [out] error_line line number of the first invalid line, 0 if the file could not be read
+ *
+ * @return 0 on success, -1 on error
+ */
+int plant_read(plant_t *plant, const char *path, const tracker_t *tracker, uint64_t *error_line)
+{
+	memset(plant, 0, sizeof(*plant));
+	*error_line = 0;
+
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+	{
+		return(-1);
+	}
+
+	plant_row_t *rows = NULL;
+	size_t num_rows = 0, capacity = 0;
+	char *buf = NULL;
+	size_t buf_size = 0;
+	uint64_t line = 0;
+	while (getline(&buf, &buf_size, file) != -1)
+	{
+		line++;
+		char *text = trim(buf);
+		if (*text == '\0' || *text == '#')
+		{
+			continue;
+		}
+
+		if (num_rows == capacity)
+		{
+			capacity = (capacity == 0) ? 1024 : 2 * capacity;
+			rows = realloc(rows, capacity * sizeof(plant_row_t));
+			assert(rows != NULL);
+		}
+		int parsed = parse_row(text, &rows[num_rows]);
+		if (parsed == 0 && line == 1)
+		{
+			continue;		// column header
+		}
+		if (parsed != 1)
+		{
+			*error_line = line;
+			break;
+		}
+		num_rows++;
+	}
+	free(buf);
+	fclose(file);
+	if (*error_line == 0 && num_rows == 0)
+	{
+		*error_line = (line != 0) ? line : 1;
+	}
+	if (*error_line != 0)
+	{
+		free(rows);
+		return(-1);
+	}
+
+	plant_init(plant, rows, num_rows, tracker);
+	free(rows);
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Release a plant layout
+ *
+ * @param [in] plant pointer to plant_t struct
+ */
+void plant_free(plant_t *plant)
+{
+	free(plant->rows);
+	free(plant->sin_alpha);
+	free(plant->cos_alpha);
+	free(plant->sin_beta);
+	free(plant->cos_beta);
+	free(plant->sin_slope);
+	free(plant->cos_slope);
+	free(plant->axis_ratio);
+	free(plant->stow_angle);
+	memset(plant, 0, sizeof(*plant));
+}
+
+
+/**
+ * @brief
+ *  Allocate zeroed results for count rows
+ *
+ * @param [out] stats pointer to plant_stats_t struct, release with plant_stats_free()
+ * @param [in] count number of rows
+ * @param [in] rom range of motion in degrees, sets the number of |angle| bins and the fleet histogram range
+ * @param [in] zone_min lower end of the zone of interest in degrees
+ * @param [in] zone_max upper end of the zone of interest in degrees
+ * @param [in] bin_size width of the |angle| bins in degrees
+ */
+void plant_stats_init(plant_stats_t *stats, size_t count, double rom, double zone_min, double zone_max, double bin_size)
+{
+	stats->zone_min = zone_min;
+	stats->zone_max = zone_max;
+	stats->bin_size = bin_size;
+	stats->num_bins = (uint32_t)(rom / bin_size) + 1;
+	stats->counts = calloc(count * stats->num_bins, sizeof(uint32_t));
+	stats->zone_minutes = calloc(count, sizeof(uint32_t));
+	assert((stats->counts != NULL && stats->zone_minutes != NULL) || count == 0);
+	angle_histogram_init(&stats->fleet, -rom, rom, HISTOGRAM_BIN_SIZE);
+}
+
+
+/**
+ * @brief
+ *  Release results from plant_stats_init()
+ *
+ * @param [in] stats pointer to plant_stats_t struct
+ */
+void plant_stats_free(plant_stats_t *stats)
+{
+	free(stats->counts);
+	free(stats->zone_minutes);
+	angle_histogram_free(&stats->fleet);
+	stats->counts = NULL;
+	stats->zone_minutes = NULL;
+}
+
+
+/**
+ * @brief
+ *  Terrain-aware backtracking by direct evaluation
+ *
+ *  Reference form of the backtracking done in plant_angles(), also used for
+ * the night stow angle. With slope 0 and axis_ratio 1 / gcr it gives
+ * shade_avoidance_angle().
+ *
+ * @param [in] tracker_angle Ideal tracker angle in degrees without shade avoidance
+ * @param [in] slope cross-axis ground slope in degrees
+ * @param [in] axis_ratio pitch / (width cos(slope))
+ * @param [in] rom range of motion in degrees
+ *
+ * @return Tracker angle in degrees with shade avoidance, within +/- rom
+ */
+double plant_backtrack_exact(double tracker_angle, double slope, double axis_ratio, double rom)
+{
+	double angle = tracker_angle;
+	double x = fabs(cos(deg2rad(tracker_angle - slope))) * axis_ratio;
+	if (x < 1.0)
+	{
+		double correction = rad2deg(acos(x));
+		angle = (tracker_angle < 0) ? tracker_angle + correction : tracker_angle - correction;
+	}
+
+	// keep angle within range of motion
+	if (angle < -rom)
+	{
+		return(-rom);
+	}
+	if (angle > rom)
+	{
+		return(rom);
+	}
+	return(angle);
+}
+
+
+/**
+ * @brief
+ *  Backtracked angle of a run of rows at one sun position
+ *
+ *  The ideal angle is tracker_angle_vector()'s. cos(R - S) for the
+ * backtracking test comes from the same A and B terms, sin(R) = -A / |(A, B)|
+ * and cos(R) = |B| / |(A, B)|, so the only calls per row are atan(), sqrt()
+ * and, for rows that backtrack, acos().
+ *
+ * @param [in] plant pointer to plant_t struct from plant_read()
+ * @param [in] first first row
+ * @param [in] count number of rows
+ * @param [in] sun pointer to sun_vector_t struct
+ * @param [out] angle count tracker angles in degrees with shade avoidance
+ */
+void plant_angles(const plant_t *plant, size_t first, size_t count, const sun_vector_t *sun, double *angle)
+{
+	// every row goes to its night stow angle when the sun is below the horizon
+	if (sun->z <= 0.0)
+	{
+		memcpy(angle, &plant->stow_angle[first], count * sizeof(double));
+		return;
+	}
+
+	const double *sin_alpha = &plant->sin_alpha[first];
+	const double *cos_alpha = &plant->cos_alpha[first];
+	const double *sin_beta = &plant->sin_beta[first];
+	const double *cos_beta = &plant->cos_beta[first];
+	const double *sin_slope = &plant->sin_slope[first];
+	const double *cos_slope = &plant->cos_slope[first];
+	const double *axis_ratio = &plant->axis_ratio[first];
+	double rom = plant->rom;
+	size_t r;
+
+	for (r=0; r<count; r++)
+	{
+		double A = cos_alpha[r] * sun->y - sin_alpha[r] * sun->x;
+		double B = sin_beta[r] * (sin_alpha[r] * sun->y + cos_alpha[r] * sun->x) + cos_beta[r] * sun->z;
+		double ideal = -atan(A / B);
+		if (B < 0.0)
+		{
+			ideal = -ideal;
+		}
+		ideal = rad2deg(ideal);
+
+		double a = ideal;
+		double x = fabs(fabs(B) * cos_slope[r] - A * sin_slope[r]) / sqrt(A * A + B * B) * axis_ratio[r];
+		if (x < 1.0)
+		{
+			double correction = rad2deg(acos(x));
+			a = (ideal < 0) ? ideal + correction : ideal - correction;
+		}
+
+		// keep angle within range of motion
+		if (a < -rom)
+		{
+			a = -rom;
+		}
+		else if (a > rom)
+		{
+			a = rom;
+		}
+		angle[r] = a;
+	}
+}
+
+
+/**
+ * @brief
+ *  Add every row's angle at every sun position to the row and fleet results
+ *
+ *  Night samples give every row its stow angle, so they are counted once
+ * and added per row at the end rather than evaluated.
+ *
+ * @param [in] plant pointer to plant_t struct from plant_read()
+ * @param [in] first first row
+ * @param [in] count number of rows, stats row 0 is row first
+ * @param [in] sun array of num_samples sun vectors
+ * @param [in] num_samples number of sun vectors
+ * @param [in,out] stats pointer to plant_stats_t struct from plant_stats_init() for count rows
+ */
+void plant_evaluate(const plant_t *plant, size_t first, size_t count,
+	const sun_vector_t *sun, size_t num_samples, plant_stats_t *stats)
+{
+	double angle[PLANT_ROW_BLOCK];
+	uint32_t num_bins = stats->num_bins;
+	uint32_t night = 0;
+	size_t block, k, r;
+
+	for (k=0; k<num_samples; k++)
+	{
+		if (sun[k].z <= 0.0)
+		{
+			night++;
+		}
+	}
+
+	for (block=0; block<count; block+=PLANT_ROW_BLOCK)
+	{
+		size_t n = (count - block < PLANT_ROW_BLOCK) ? count - block : PLANT_ROW_BLOCK;
+		uint32_t *counts = &stats->counts[block * num_bins];
+		uint32_t *zone_minutes = &stats->zone_minutes[block];
+
+		for (k=0; k<num_samples; k++)
+		{
+			if (sun[k].z <= 0.0)
+			{
+				continue;
+			}
+			plant_angles(plant, first + block, n, &sun[k], angle);
+			for (r=0; r<n; r++)
+			{
+				uint32_t bin = (uint32_t)(fabs(angle[r]) / stats->bin_size);
+				counts[r * num_bins + (bin < num_bins ? bin : num_bins - 1)]++;
+				zone_minutes[r] += (angle[r] >= stats->zone_min && angle[r] < stats->zone_max);
+				angle_histogram_add(&stats->fleet, angle[r]);
+			}
+		}
+
+		for (r=0; r<n; r++)
+		{
+			double stow = plant->stow_angle[first + block + r];
+			uint32_t bin = (uint32_t)(fabs(stow) / stats->bin_size);
+			counts[r * num_bins + (bin < num_bins ? bin : num_bins - 1)] += night;
+			zone_minutes[r] += (stow >= stats->zone_min && stow < stats->zone_max) ? night : 0;
+			angle_histogram_add_n(&stats->fleet, stow, night);
+		}
+	}
+}
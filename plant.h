@@ -0,0 +1,66 @@
+/**
+ * @file	plant.h
+ *
+ * @brief
+ *   Header for the per-row plant layout evaluation
+ */
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "tracking_algorithm.h"
+#include "histogram.h"
+
+#define PLANT_MAX_NAME		64		// longest row name, including the terminator
+#define PLANT_ROW_BLOCK		256		// rows evaluated together against each sun vector
+
+/// one row of a plant layout as read from the row table
+typedef struct {
+	char name[PLANT_MAX_NAME];
+	double alpha;				/// axis yaw in degrees, as tracker_t
+	double beta;				/// axis tilt in degrees, as tracker_t
+	double slope;				/// cross-axis ground slope in degrees, positive rising towards the side faced at positive angles
+	double pitch;				/// row to row spacing, same units as width
+	double width;				/// collector width across the axis
+} plant_row_t;
+
+/// plant layout, the rows as read plus what the evaluation needs in structure of arrays form
+typedef struct {
+	size_t num_rows;
+	plant_row_t *rows;
+	double rom;					/// Range of motion in degrees, every row
+	double night_stow;			/// Night stow angle in degrees, every row
+	double *sin_alpha;
+	double *cos_alpha;
+	double *sin_beta;
+	double *cos_beta;
+	double *sin_slope;
+	double *cos_slope;
+	double *axis_ratio;			/// pitch / (width cos(slope)), 1 / gcr on flat ground
+	double *stow_angle;			/// night stow with shade avoidance in degrees
+} plant_t;
+
+/// per-row and fleet results of plant_evaluate(), rows indexed from the first row evaluated
+typedef struct {
+	double zone_min;			/// zone of interest [zone_min, zone_max) in degrees
+	double zone_max;
+	double bin_size;			/// width of the |angle| bins in degrees
+	uint32_t num_bins;			/// |angle| bins per row, larger angles go to the last
+	uint32_t *counts;			/// num_bins minutes per row
+	uint32_t *zone_minutes;		/// minutes in the zone per row
+	angle_histogram_t fleet;	/// signed histogram over every row and minute
+} plant_stats_t;
+
+void plant_init(plant_t *plant, const plant_row_t *rows, size_t num_rows, const tracker_t *tracker);
+int plant_read(plant_t *plant, const char *path, const tracker_t *tracker, uint64_t *error_line);
+void plant_free(plant_t *plant);
+void plant_stats_init(plant_stats_t *stats, size_t count, double rom, double zone_min, double zone_max, double bin_size);
+void plant_stats_free(plant_stats_t *stats);
+double plant_backtrack_exact(double tracker_angle, double slope, double axis_ratio, double rom);
+void plant_angles(const plant_t *plant, size_t first, size_t count, const sun_vector_t *sun, double *angle);
+void plant_evaluate(const plant_t *plant, size_t first, size_t count,
+	const sun_vector_t *sun, size_t num_samples, plant_stats_t *stats);
+
+#endif
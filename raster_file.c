@@ -0,0 +1,196 @@
+/**
+ * @file	raster_file.c
+ *
+ * @brief
+ *   Binary time in zone raster format, see raster_file.h for the layout
+ *
+ *  The writer takes cells in file order as they are calculated, so a raster
+ * of any size is written without holding it in memory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "raster_file.h"
+
+_Static_assert(sizeof(raster_file_header_t) == 128, "raster_file_header_t layout changed");
+
+#define WRITE_CHUNK		4096	// values converted per fwrite()
+
+
+/**
+ * @brief
+ *  Fill a header for a grid, one year of minutes at 0.01%
+ *
+ *  The caller sets year, zone_min, zone_max, bin_size and events.
+ *
+ * @param [out] header pointer to raster_file_header_t struct
+ * @param [in] lat_min southern edge in degrees
+ * @param [in] lon_min western edge in degrees
+ * @param [in] resolution cell size in degrees
+ * @param [in] rows number of rows, south to north
+ * @param [in] cols number of columns, west to east
+ * @param [in] layers values per cell, 1 + number of bins
+ */
+void raster_file_header_init(raster_file_header_t *header, double lat_min, double lon_min, double resolution,
+	uint32_t rows, uint32_t cols, uint32_t layers)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, RASTER_FILE_MAGIC, sizeof(header->magic));
+	header->version = RASTER_FILE_VERSION;
+	header->header_size = sizeof(raster_file_header_t);
+	header->lat_min = lat_min;
+	header->lon_min = lon_min;
+	header->resolution = resolution;
+	header->rows = rows;
+	header->cols = cols;
+	header->layers = layers;
+	header->units_per_percent = RASTER_FILE_UNITS_PER_PERCENT;
+}
+
+
+/**
+ * @brief
+ *  Create a raster file and write its header
+ *
+ * @param [out] writer pointer to raster_writer_t struct, finish with raster_file_finish()
+ * @param [in] path output file name
+ * @param [in] header pointer to a filled raster_file_header_t struct, kept until raster_file_finish()
+ *
+ * @return 0 on success, -1 on error with errno set
+ */
+int raster_file_create(raster_writer_t *writer, const char *path, const raster_file_header_t *header)
+{
+	writer->header = header;
+	writer->file = fopen(path, "wb");
+	if (writer->file == NULL)
+	{
+		return(-1);
+	}
+	writer->ok = (fwrite(header, sizeof(*header), 1, writer->file) == 1);
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Append cells in file order
+ *
+ *  Errors are reported by raster_file_finish().
+ *
+ * @param [in,out] writer pointer to raster_writer_t struct
+ * @param [in] values count x header->layers values in percent
+ * @param [in] count number of cells
+ */
+void raster_file_write_cells(raster_writer_t *writer, const double *values, size_t count)
+{
+	uint16_t buf[WRITE_CHUNK];
+	size_t i = 0, total = count * writer->header->layers;
+	while (writer->ok && i < total)
+	{
+		size_t k, n = (total - i < WRITE_CHUNK) ? total - i : WRITE_CHUNK;
+		for (k=0; k<n; k++)
+		{
+			double v = nearbyint(values[i + k] * writer->header->units_per_percent);
+			buf[k] = (v < 0.0) ? 0 : (v > UINT16_MAX) ? UINT16_MAX : (uint16_t)v;
+		}
+		writer->ok = (fwrite(buf, sizeof(uint16_t), n, writer->file) == n);
+		i += n;
+	}
+}
+
+
+/**
+ * @brief
+ *  Close a raster file being written
+ *
+ * @param [in] writer pointer to raster_writer_t struct
+ *
+ * @return 0 if every write succeeded, -1 otherwise
+ */
+int raster_file_finish(raster_writer_t *writer)
+{
+	int ok = writer->ok;
+	if (fclose(writer->file) != 0)
+	{
+		ok = 0;
+	}
+	writer->file = NULL;
+	return(ok ? 0 : -1);
+}
+
+
+/**
+ * @brief
+ *  Map a raster file for reading
+ *
+ * @param [in] path file name
+ * @param [out] file pointer to raster_file_t struct, release with raster_file_close()
+ *
+ * @return 0 on success, -1 if the file can't be read or isn't a valid raster file
+ */
+int raster_file_open(const char *path, raster_file_t *file)
+{
+	memset(file, 0, sizeof(*file));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return(-1);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(raster_file_header_t))
+	{
+		close(fd);
+		return(-1);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return(-1);
+	}
+
+	const raster_file_header_t *header = map;
+	if (memcmp(header->magic, RASTER_FILE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != RASTER_FILE_VERSION
+		|| header->header_size < sizeof(raster_file_header_t)
+		|| header->header_size > (size_t)st.st_size
+		|| header->header_size % sizeof(uint16_t) != 0
+		|| header->units_per_percent == 0
+		|| ((size_t)st.st_size - header->header_size) / sizeof(uint16_t) < (uint64_t)header->rows * header->cols * header->layers)
+	{
+		munmap(map, st.st_size);
+		return(-1);
+	}
+
+	file->header = header;
+	file->cells = (const uint16_t *)((const char *)map + header->header_size);
+	file->map = map;
+	file->map_size = st.st_size;
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Unmap a file opened with raster_file_open()
+ *
+ * @param [in] file pointer to raster_file_t struct
+ */
+void raster_file_close(raster_file_t *file)
+{
+	if (file->map != NULL)
+	{
+		munmap(file->map, file->map_size);
+	}
+	memset(file, 0, sizeof(*file));
+}
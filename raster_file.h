@@ -0,0 +1,71 @@
+/**
+ * @file	raster_file.h
+ *
+ * @brief
+ *   Header for the binary time in zone raster format
+ *
+ *  A file is one raster_file_header_t followed by rows x cols cells of
+ * layers uint16 values each, in 1/units_per_percent percent of the year
+ * (0.01% by default). Layer 0 is the percent of time in [zone_min, zone_max),
+ * layer 1 + j the percent of time with |angle| in bin j of bin_size degrees,
+ * the last bin also holding anything larger. Row 0 is the southern edge and
+ * cells run west to east, cell (r, c) covers latitudes lat_min + r * resolution
+ * to lat_min + (r+1) * resolution and is calculated at its centre. All fields
+ * are in host byte order and the cells start on an 8 byte boundary, so the
+ * whole file can be mapped and read in place.
+ */
+
+#ifndef RASTER_FILE_H
+#define RASTER_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#define RASTER_FILE_MAGIC				"TRKRSTR\0"
+#define RASTER_FILE_VERSION				1
+#define RASTER_FILE_UNITS_PER_PERCENT	100		// 0.01% resolution
+
+typedef struct {
+	char     magic[8];					/// RASTER_FILE_MAGIC
+	uint32_t version;					/// RASTER_FILE_VERSION
+	uint32_t header_size;				/// bytes before the first cell
+	double   lat_min;					/// southern edge of row 0 in degrees
+	double   lon_min;					/// western edge of column 0 in degrees
+	double   resolution;				/// cell size in degrees
+	double   zone_min;					/// zone of layer 0 in degrees
+	double   zone_max;
+	double   bin_size;					/// |angle| bin width of layers 1 and up in degrees
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t layers;					/// values per cell
+	uint32_t units_per_percent;			/// cell value of 1% of the year
+	uint16_t year;
+	uint8_t  events;					/// 1 if calculated from bin edge crossings, 0 every minute
+	uint8_t  reserved[45];
+} raster_file_header_t;
+
+/// a file being written row by row with raster_file_create()
+typedef struct {
+	FILE *file;
+	const raster_file_header_t *header;
+	int ok;
+} raster_writer_t;
+
+/// a file opened for reading with raster_file_open()
+typedef struct {
+	const raster_file_header_t *header;	/// points into the mapping
+	const uint16_t *cells;				/// rows x cols x layers values
+	void *map;
+	size_t map_size;
+} raster_file_t;
+
+void raster_file_header_init(raster_file_header_t *header, double lat_min, double lon_min, double resolution,
+	uint32_t rows, uint32_t cols, uint32_t layers);
+int raster_file_create(raster_writer_t *writer, const char *path, const raster_file_header_t *header);
+void raster_file_write_cells(raster_writer_t *writer, const double *values, size_t count);
+int raster_file_finish(raster_writer_t *writer);
+int raster_file_open(const char *path, raster_file_t *file);
+void raster_file_close(raster_file_t *file);
+
+#endif
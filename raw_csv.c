@@ -0,0 +1,204 @@
+/**
+ * @file	raw_csv.c
+ *
+ * @brief
+ *   Per-minute raw data CSV writer
+ *
+ *  Writes the rows main.c has always written with
+ *
+ *     fprintf(file, "%s,%02d,%02d,%02d,%02d,%02d,%.1f\n", name, year, month, day, hour, minute, angle)
+ *
+ * byte for byte, without fprintf(). The "<name>,<year>," prefix is rendered
+ * once, the two digit fields come from a table and the angle is rounded to
+ * tenths in fixed point, and rows are built in a RAW_CSV_BUFFER byte buffer
+ * that goes to the file with one fwrite().
+ *
+ *  "%.1f" rounds the exact binary value of the angle to the nearest tenth,
+ * ties to even, and keeps the sign of negative values that round to zero
+ * (and of -0.0). angle * 10 is rounded once more, so on its own it can land
+ * on or off a tie the exact value is not on, e.g. 0.15 is stored as
+ * 0.1499999... and prints "0.1" but 0.15 * 10 rounds to 1.5. The rounding
+ * error of the product is recovered exactly with fma() and decides those
+ * cases, see raw_csv_format_angle().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "raw_csv.h"
+
+#define RAW_CSV_FIXED_LIMIT		1e14	// larger angles go through snprintf(), keeps angle * 10 below 2^53
+
+static const char digits2[200] =
+	"00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+
+/**
+ * @brief
+ *  Format an angle as printf("%.1f") does
+ *
+ * @param [out] out buffer of at least RAW_CSV_MAX_ANGLE bytes, not terminated
+ * @param [in] angle angle in degrees
+ *
+ * @return number of bytes written
+ */
+size_t raw_csv_format_angle(char *out, double angle)
+{
+	double a = fabs(angle);
+	if (!(a < RAW_CSV_FIXED_LIMIT))
+	{
+		char text[RAW_CSV_MAX_ANGLE + 1];
+		int n = snprintf(text, sizeof(text), "%.1f", angle);
+		memcpy(out, text, n);
+		return(n);
+	}
+
+	// nearest number of tenths to the exact value of a, ties to even
+	double x = a * 10.0;
+	double err = fma(a, 10.0, -x);		// a * 10 == x + err exactly
+	double t = floor(x);
+	double d = (x - t) - 0.5;			// exact, a multiple of the ulp of x when x >= 1
+	uint64_t tenths = (uint64_t)t;
+	if (d > 0.0 || (d == 0.0 && (err > 0.0 || (err == 0.0 && (tenths & 1)))))
+	{
+		tenths++;
+	}
+
+	char *p = out;
+	if (signbit(angle))
+	{
+		*p++ = '-';
+	}
+	char whole[20];
+	int n = 0;
+	uint64_t v = tenths / 10;
+	do
+	{
+		whole[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v != 0);
+	while (n > 0)
+	{
+		*p++ = whole[--n];
+	}
+	*p++ = '.';
+	*p++ = '0' + tenths % 10;
+	return(p - out);
+}
+
+
+static void flush(raw_csv_t *csv)
+{
+	if (csv->ok && csv->len != 0)
+	{
+		csv->ok = (fwrite(csv->buf, 1, csv->len, csv->file) == csv->len);
+	}
+	csv->len = 0;
+}
+
+
+/**
+ * @brief
+ *  Create a raw data CSV file and write its column header
+ *
+ * @param [out] csv pointer to raw_csv_t struct, finish with raw_csv_close()
+ * @param [in] path output file name
+ * @param [in] name location name, the first column of every row
+ * @param [in] year year column of every row
+ *
+ * @return 0 on success, -1 on error
+ */
+int raw_csv_open(raw_csv_t *csv, const char *path, const char *name, uint16_t year)
+{
+	memset(csv, 0, sizeof(*csv));
+	csv->prefix_len = strlen(name) + 8;
+	csv->prefix = malloc(csv->prefix_len);
+	csv->buf = malloc(RAW_CSV_BUFFER);
+	if (csv->prefix == NULL || csv->buf == NULL)
+	{
+		free(csv->prefix);
+		free(csv->buf);
+		return(-1);
+	}
+	csv->prefix_len = snprintf(csv->prefix, csv->prefix_len, "%s,%02d,", name, year);
+
+	csv->file = fopen(path, "w");
+	if (csv->file == NULL)
+	{
+		free(csv->prefix);
+		free(csv->buf);
+		return(-1);
+	}
+	csv->ok = 1;
+	memcpy(csv->buf, RAW_CSV_HEADER, strlen(RAW_CSV_HEADER));
+	csv->len = strlen(RAW_CSV_HEADER);
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Append one row
+ *
+ *  Errors are reported by raw_csv_close().
+ *
+ * @param [in,out] csv pointer to raw_csv_t struct
+ * @param [in] month month column, 0-99, main.c writes 0 = January
+ * @param [in] day day of the month, 0-99
+ * @param [in] hour hour, 0-99
+ * @param [in] minute minute, 0-99
+ * @param [in] angle angle in degrees
+ */
+void raw_csv_row(raw_csv_t *csv, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, double angle)
+{
+	if (csv->len + csv->prefix_len + 13 + RAW_CSV_MAX_ANGLE > RAW_CSV_BUFFER)
+	{
+		flush(csv);
+	}
+
+	char *p = csv->buf + csv->len;
+	memcpy(p, csv->prefix, csv->prefix_len);
+	p += csv->prefix_len;
+	memcpy(p, &digits2[2 * month], 2);
+	p[2] = ',';
+	memcpy(p + 3, &digits2[2 * day], 2);
+	p[5] = ',';
+	memcpy(p + 6, &digits2[2 * hour], 2);
+	p[8] = ',';
+	memcpy(p + 9, &digits2[2 * minute], 2);
+	p[11] = ',';
+	p += 12;
+	p += raw_csv_format_angle(p, angle);
+	*p++ = '\n';
+	csv->len = p - csv->buf;
+}
+
+
+/**
+ * @brief
+ *  Write out the buffered rows and close the file
+ *
+ * @param [in] csv pointer to raw_csv_t struct
+ *
+ * @return 0 if every write succeeded, -1 otherwise
+ */
+int raw_csv_close(raw_csv_t *csv)
+{
+	flush(csv);
+	int ok = csv->ok;
+	if (fclose(csv->file) != 0)
+	{
+		ok = 0;
+	}
+	free(csv->prefix);
+	free(csv->buf);
+	csv->file = NULL;
+	csv->prefix = NULL;
+	csv->buf = NULL;
+	return(ok ? 0 : -1);
+}
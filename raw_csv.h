@@ -0,0 +1,34 @@
+/**
+ * @file	raw_csv.h
+ *
+ * @brief
+ *   Header for the per-minute raw data CSV writer
+ */
+
+#ifndef RAW_CSV_H
+#define RAW_CSV_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#define RAW_CSV_HEADER		"LOCATION,YEAR,MONTH,DAY,HOUR,MINUTE,ANGLE\n"
+#define RAW_CSV_BUFFER		(1 << 20)	// bytes formatted before each fwrite()
+#define RAW_CSV_MAX_ANGLE	320			// longest formatted angle, any double with the sign
+
+/// TrackerAngle_<site>.csv being written, see raw_csv_open()
+typedef struct {
+	FILE *file;
+	char *prefix;				/// "<name>,<year>," shared by every row
+	size_t prefix_len;
+	char *buf;					/// RAW_CSV_BUFFER bytes
+	size_t len;					/// bytes in buf
+	int ok;						/// every write so far succeeded
+} raw_csv_t;
+
+int raw_csv_open(raw_csv_t *csv, const char *path, const char *name, uint16_t year);
+void raw_csv_row(raw_csv_t *csv, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, double angle);
+int raw_csv_close(raw_csv_t *csv);
+size_t raw_csv_format_angle(char *out, double angle);
+
+#endif
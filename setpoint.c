@@ -0,0 +1,169 @@
+/**
+ * @file	setpoint.c
+ *
+ * @brief
+ *   Live tracker setpoints for arbitrary times, see tracker_setpointd
+ *
+ *  The site independent terms (sidereal time, right ascension, declination)
+ * are built once per local day with solar_ephemeris_batch() at every minute
+ * from midnight to the next midnight. A setpoint then interpolates the terms
+ * with a quadratic through the three minutes around its time and does only
+ * the per-site step (solar_position_site_batch()) and the tracker kernel with
+ * backtracking. Linear interpolation would leave ~1e-11 in sin(declination),
+ * which the acos() azimuth of the reference algorithm turns into ~2e-5 deg of
+ * tracker angle at solar noon; the quadratic is exact to rounding and the
+ * result matches trackerangle_batch() within SETPOINT_TOLERANCE.
+ *
+ *  The current and the next day are kept, so a caller that runs
+ * setpoint_prepare() off its hot path, e.g. when idle, never builds a table
+ * in setpoint_angle() as the day rolls over. Any other day goes to a third,
+ * spare table, so replaying history between live requests costs one table
+ * per replayed day and leaves the live ones alone. Nothing here uses heap
+ * memory.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "setpoint.h"
+
+
+/**
+ * @brief
+ *  Set up a tracker at a site, no day tables yet
+ *
+ * @param [out] setpoint pointer to setpoint_t struct
+ * @param [in] tracker pointer to tracker_t struct, not referenced after the call
+ * @param [in] site pointer to solarpos_site_t struct, not referenced after the call
+ */
+void setpoint_init(setpoint_t *setpoint, const tracker_t *tracker, const solarpos_site_t *site)
+{
+	memset(setpoint, 0, sizeof(*setpoint));
+	trackerangle_init(&setpoint->config, tracker, site);
+	setpoint->today = INT64_MIN;
+	setpoint->days[0].day = INT64_MIN;
+	setpoint->days[1].day = INT64_MIN;
+	setpoint->days[2].day = INT64_MIN;
+}
+
+
+/**
+ * @brief
+ *  Local day of a time at the setpoint's site
+ *
+ * @param [in] setpoint pointer to setpoint_t struct
+ * @param [in] unix_seconds seconds since 00:00 1 Jan 1970 UT
+ *
+ * @return local standard time days since 1 Jan 1970
+ */
+int64_t setpoint_local_day(const setpoint_t *setpoint, double unix_seconds)
+{
+	return((int64_t)floor((unix_seconds + 3600.0 * setpoint->config.site.timezone) / 86400.0));
+}
+
+
+/// ephemeris terms at every minute of a local day into a table
+static void build_day(setpoint_t *setpoint, setpoint_day_t *table, int64_t day)
+{
+	double midnight = trackerangle_time_unix(86400.0 * day - 3600.0 * setpoint->config.site.timezone);
+	double time[SETPOINT_TABLE_SIZE];
+	size_t k;
+
+	for (k=0; k<SETPOINT_TABLE_SIZE; k++)
+	{
+		time[k] = midnight + (double)k / SETPOINT_MINUTES_PER_DAY;
+	}
+	solarpos_ephem_t eph = {table->gmst, table->ra, table->sin_dec, table->cos_dec, table->declination};
+	solar_ephemeris_batch(time, SETPOINT_TABLE_SIZE, &eph);
+	table->day = day;
+	setpoint->day_builds++;
+}
+
+
+/**
+ * @brief
+ *  Build the tables of the local day of a time and of the day after, where missing
+ *
+ *  Meant to be called off the hot path, e.g. once a second, so the next day
+ * is ready before its midnight.
+ *
+ * @param [in,out] setpoint pointer to setpoint_t struct
+ * @param [in] unix_seconds seconds since 00:00 1 Jan 1970 UT, normally now
+ */
+void setpoint_prepare(setpoint_t *setpoint, double unix_seconds)
+{
+	int64_t day = setpoint_local_day(setpoint, unix_seconds);
+	int64_t d;
+	setpoint->today = day;
+	for (d=day; d<=day+1; d++)
+	{
+		if (setpoint->days[d & 1].day != d)
+		{
+			build_day(setpoint, &setpoint->days[d & 1], d);
+		}
+	}
+}
+
+
+/// quadratic through the values one minute before, at and after a table minute, x in minutes from it
+static inline double interpolate(double prev, double at, double next, double x)
+{
+	return(at + x * (0.5 * (next - prev) + x * (0.5 * (next + prev) - at)));
+}
+
+
+/**
+ * @brief
+ *  Tracker angle with shade avoidance at a time
+ *
+ *  Builds the day's table first if setpoint_prepare() has not, which takes
+ * about as long as three hundred setpoints.
+ *
+ * @param [in,out] setpoint pointer to setpoint_t struct
+ * @param [in] unix_seconds seconds since 00:00 1 Jan 1970 UT
+ *
+ * @return tracker angle in degrees, the backtracked night stow angle with the sun down
+ */
+double setpoint_angle(setpoint_t *setpoint, double unix_seconds)
+{
+	int64_t day = setpoint_local_day(setpoint, unix_seconds);
+	setpoint_day_t *table = &setpoint->days[day & 1];
+	if (table->day != day)
+	{
+		// other days, e.g. replayed history, go to the spare table and leave today's and tomorrow's alone
+		int live = (day == setpoint->today || day == setpoint->today + 1);
+		table = live ? table : &setpoint->days[2];
+		if (table->day != day)
+		{
+			build_day(setpoint, table, day);
+		}
+	}
+
+	// nearest table minute and the offset from it in minutes, in [-1, 1] only at the ends of the day
+	double minutes = (unix_seconds + 3600.0 * setpoint->config.site.timezone) / 60.0 - (double)day * SETPOINT_MINUTES_PER_DAY;
+	double nearest = floor(minutes + 0.5);
+	size_t i = (nearest < 1.0) ? 1 : (nearest > SETPOINT_MINUTES_PER_DAY - 1) ? SETPOINT_MINUTES_PER_DAY - 1 : (size_t)nearest;
+	double x = minutes - (double)i;
+
+	// sidereal time and right ascension wrap at most once over the three minutes
+	double gmst_prev = table->gmst[i - 1], gmst_next = table->gmst[i + 1];
+	double ra_prev = table->ra[i - 1], ra_next = table->ra[i + 1];
+	gmst_prev -= (gmst_prev > table->gmst[i]) ? 24.0 : 0.0;
+	gmst_next += (gmst_next < table->gmst[i]) ? 24.0 : 0.0;
+	ra_prev -= (ra_prev > table->ra[i] + M_PI) ? 2.0 * M_PI : 0.0;
+	ra_next += (ra_next < table->ra[i] - M_PI) ? 2.0 * M_PI : 0.0;
+
+	double gmst = interpolate(gmst_prev, table->gmst[i], gmst_next, x);
+	double ra = interpolate(ra_prev, table->ra[i], ra_next, x);
+	double sin_dec = interpolate(table->sin_dec[i - 1], table->sin_dec[i], table->sin_dec[i + 1], x);
+	double cos_dec = interpolate(table->cos_dec[i - 1], table->cos_dec[i], table->cos_dec[i + 1], x);
+	double declination = interpolate(table->declination[i - 1], table->declination[i], table->declination[i + 1], x);
+
+	double azimuth, zenith, elevation, dec_deg, angle;
+	solarpos_ephem_t eph = {&gmst, &ra, &sin_dec, &cos_dec, &declination};
+	solarpos_batch_t out = {&azimuth, &zenith, &elevation, &dec_deg};
+	solar_position_site_batch(&setpoint->config.site, &eph, 0, 1, &out);
+	trackerangle_batch_positions(&setpoint->config, &azimuth, &zenith, 1, &angle);
+	return(angle);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file	setpoint.h
+ *
+ * @brief
+ *   Header for the live tracker setpoint engine used by tracker_setpointd
+ */
+
+#ifndef SETPOINT_H
+#define SETPOINT_H
+
+#include <inttypes.h>
+#include "solarpos.h"
+#include "solarpos_batch.h"
+#include "tracking_algorithm.h"
+#include "trackerangle.h"
+
+#define SETPOINT_MINUTES_PER_DAY	(24*60)
+#define SETPOINT_TABLE_SIZE			(SETPOINT_MINUTES_PER_DAY + 1)	// both ends of every minute of the day
+
+/// Largest difference in degrees from trackerangle_batch(), as TRACKERANGLE_TOLERANCE
+#define SETPOINT_TOLERANCE			1e-6
+
+/// ephemeris terms at every minute of one local day
+typedef struct {
+	int64_t day;							/// local days since 1 Jan 1970, INT64_MIN when empty
+	double gmst[SETPOINT_TABLE_SIZE];		/// Greenwich mean sidereal time in hours
+	double ra[SETPOINT_TABLE_SIZE];			/// right ascension in radians
+	double sin_dec[SETPOINT_TABLE_SIZE];	/// sine of the declination
+	double cos_dec[SETPOINT_TABLE_SIZE];	/// cosine of the declination
+	double declination[SETPOINT_TABLE_SIZE];	/// declination in degrees
+} setpoint_day_t;
+
+/// one tracker at one site, with the tables of the current and the next local day
+typedef struct {
+	trackerangle_t config;
+	int64_t today;				/// local day of the last setpoint_prepare(), INT64_MIN before
+	setpoint_day_t days[3];		/// today and tomorrow by the day's parity, then any other day asked for
+	uint64_t day_builds;		/// tables built, including those built by setpoint_angle()
+} setpoint_t;
+
+void setpoint_init(setpoint_t *setpoint, const tracker_t *tracker, const solarpos_site_t *site);
+int64_t setpoint_local_day(const setpoint_t *setpoint, double unix_seconds);
+void setpoint_prepare(setpoint_t *setpoint, double unix_seconds);
+double setpoint_angle(setpoint_t *setpoint, double unix_seconds);
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * Live tracker setpoints for one tracker design at one site.
+ *
+ *     tracker_setpointd [--site LAT,LON,TZ] [--tracker SPEC] [--socket PATH]
+ *
+ * Requests are lines on stdin, or on any number of connections to a local
+ * UNIX socket, and each gets one reply line in order:
+ *
+ *     1500000000.5   Unix time in seconds UT  ->  backtracked tracker angle in degrees
+ *     (empty), now   the current time         ->  backtracked tracker angle in degrees
+ *     stats          -> latency percentiles of the requests so far
+ *
+ * Malformed requests get "error". The day tables (setpoint.h) are built for
+ * today and tomorrow while idle, so midnight does not land on a request, and
+ * answering a request uses no heap memory. Latency is measured from the read
+ * that delivered a request to the write of its reply, and p50/p99/p999 are
+ * printed to stderr at exit (end of stdin, SIGINT or SIGTERM).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "setpoint.h"
+#include "latency.h"
+#include "sweep.h"
+
+#define MAX_CLIENTS		16			// socket connections served at once
+#define LINE_BUFFER		4096		// bytes of unanswered request text per connection
+#define MAX_REPLY		160			// longest reply line, including the newline
+#define IDLE_MS			1000		// poll timeout, the day tables are checked at least this often
+
+// tracker_calc's defaults, its first location and tracker
+#define DEFAULT_SITE	{47.608358, -122.323175, -8}
+#define TRACKER_ROM		60
+#define TRACKER_GCR		0.35
+#define TRACKER_STOW	-10
+
+/// one request stream, stdin/stdout or a socket connection
+typedef struct {
+	int in_fd;					/// -1 when the slot is free
+	int out_fd;
+	size_t len;					/// bytes in buf
+	int discard;				/// dropping the rest of an overlong line
+	char buf[LINE_BUFFER];
+} client_t;
+
+static setpoint_t setpoint;
+static latency_hist_t latency;
+static client_t clients[MAX_CLIENTS];
+static char reply_buf[LINE_BUFFER * MAX_REPLY];
+static volatile sig_atomic_t stop = 0;
+
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+
+static uint64_t now_ns(int clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+
+static double now_unix(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+
+/// latency summary, one line with its newline
+static size_t format_stats(char *out, size_t size)
+{
+	int n = snprintf(out, size, "requests %" PRIu64 " p50 %.1f us p99 %.1f us p999 %.1f us max %.1f us day tables %" PRIu64 "\n",
+		latency.count, latency_percentile(&latency, 50.0) * 1e-3, latency_percentile(&latency, 99.0) * 1e-3,
+		latency_percentile(&latency, 99.9) * 1e-3, latency.max_ns * 1e-3, setpoint.day_builds);
+	return((n < 0) ? 0 : ((size_t)n < size) ? (size_t)n : size - 1);
+}
+
+
+/// reply to one request line, not terminated, returns the reply length and whether it was a setpoint
+static size_t answer(char *line, size_t len, char *out, int *timed)
+{
+	while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' '))
+	{
+		len--;
+	}
+	line[len] = '\0';
+	*timed = 0;
+
+	if (strcmp(line, "stats") == 0)
+	{
+		return(format_stats(out, MAX_REPLY));
+	}
+
+	double t;
+	if (len == 0 || strcmp(line, "now") == 0)
+	{
+		t = now_unix();
+	}
+	else
+	{
+		char *end;
+		t = strtod(line, &end);
+		if (end == line || *end != '\0' || !(t > -1e12 && t < 1e12))
+		{
+			memcpy(out, "error\n", 6);
+			return(6);
+		}
+	}
+
+	*timed = 1;
+	int n = snprintf(out, MAX_REPLY, "%.3f\n", setpoint_angle(&setpoint, t));
+	return((size_t)n);
+}
+
+
+/// write all of a buffer, 0 on success
+static int write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return(-1);
+		}
+		buf += n;
+		len -= n;
+	}
+	return(0);
+}
+
+
+/// read what is waiting on a client and answer every complete line, -1 at end of stream or error
+static int serve(client_t *client)
+{
+	ssize_t n = read(client->in_fd, client->buf + client->len, LINE_BUFFER - 1 - client->len);
+	uint64_t start = now_ns(CLOCK_MONOTONIC);
+	if (n < 0 && errno == EINTR)
+	{
+		return(0);
+	}
+	if (n <= 0)
+	{
+		return(-1);
+	}
+	client->len += n;
+
+	size_t reply_len = 0, done = 0, pos;
+	uint32_t timed_count = 0;
+	for (pos=0; pos<client->len; pos++)
+	{
+		if (client->buf[pos] != '\n')
+		{
+			continue;
+		}
+		int timed = 0;
+		if (client->discard)
+		{
+			client->discard = 0;
+			memcpy(reply_buf + reply_len, "error\n", 6);
+			reply_len += 6;
+		}
+		else
+		{
+			reply_len += answer(client->buf + done, pos - done, reply_buf + reply_len, &timed);
+		}
+		timed_count += timed;
+		done = pos + 1;
+	}
+
+	// keep a partial line, or drop it if it can never fit
+	memmove(client->buf, client->buf + done, client->len - done);
+	client->len -= done;
+	if (client->len == LINE_BUFFER - 1)
+	{
+		client->len = 0;
+		client->discard = 1;
+	}
+
+	if (reply_len > 0 && write_all(client->out_fd, reply_buf, reply_len) != 0)
+	{
+		return(-1);
+	}
+	uint64_t elapsed = now_ns(CLOCK_MONOTONIC) - start;
+	for (; timed_count > 0; timed_count--)
+	{
+		latency_add(&latency, elapsed);
+	}
+	return(0);
+}
+
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [--site LAT,LON,TZ] [--tracker SPEC] [--socket PATH]\n", prog);
+	printf("  -l, --site LAT,LON,TZ  site latitude and longitude in degrees, timezone in hours\n");
+	printf("                         (default tracker_calc's Seattle)\n");
+	printf("  -k, --tracker SPEC     tracker as gcr=0.35,rom=60,stow=-10,alpha=0,beta=0, fields\n");
+	printf("                         left out keep these defaults\n");
+	printf("  -s, --socket PATH      serve a UNIX socket at PATH instead of stdin/stdout\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+	solarpos_site_t site = DEFAULT_SITE;
+	tracker_t tracker = {0};
+	tracker.rom = TRACKER_ROM;
+	tracker.gcr = TRACKER_GCR;
+	tracker.night_stow = TRACKER_STOW;
+	const char *socket_path = NULL;
+
+	static const struct option long_options[] = {
+		{"site",    required_argument, NULL, 'l'},
+		{"tracker", required_argument, NULL, 'k'},
+		{"socket",  required_argument, NULL, 's'},
+		{"help",    no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "l:k:s:h", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'l':
+			{
+				int tz;
+				if (sscanf(optarg, "%lf,%lf,%d", &site.latitude, &site.longitude, &tz) != 3
+					|| site.latitude < -90.0 || site.latitude > 90.0 || tz < -12 || tz > 14)
+				{
+					printf("Invalid site %s\n", optarg);
+					exit(1);
+				}
+				site.timezone = tz;
+				break;
+			}
+			case 'k':
+			{
+				sweep_spec_t spec;
+				if (sweep_parse(optarg, &tracker, &spec) != 0 || spec.gcr.max != spec.gcr.min || spec.rom.max != spec.rom.min
+					|| spec.night_stow.max != spec.night_stow.min || spec.alpha.max != spec.alpha.min || spec.beta.max != spec.beta.min)
+				{
+					printf("Invalid tracker %s, single values only\n", optarg);
+					exit(1);
+				}
+				tracker.gcr = spec.gcr.min;
+				tracker.rom = spec.rom.min;
+				tracker.night_stow = spec.night_stow.min;
+				tracker.alpha = spec.alpha.min;
+				tracker.beta = spec.beta.min;
+				break;
+			}
+			case 's':
+				socket_path = optarg;
+				break;
+			case 'h':
+				usage(argv[0]);
+				exit(0);
+			default:
+				usage(argv[0]);
+				exit(1);
+		}
+	}
+	if (optind != argc)
+	{
+		usage(argv[0]);
+		exit(1);
+	}
+
+	setpoint_init(&setpoint, &tracker, &site);
+	setpoint_prepare(&setpoint, now_unix());
+	latency_clear(&latency);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_signal;		// no SA_RESTART, so poll() returns on a signal
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	size_t c;
+	for (c=0; c<MAX_CLIENTS; c++)
+	{
+		clients[c].in_fd = -1;
+	}
+
+	int listen_fd = -1;
+	if (socket_path == NULL)
+	{
+		clients[0].in_fd = STDIN_FILENO;
+		clients[0].out_fd = STDOUT_FILENO;
+	}
+	else
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(socket_path) >= sizeof(addr.sun_path))
+		{
+			printf("Socket path too long %s\n", socket_path);
+			exit(1);
+		}
+		strcpy(addr.sun_path, socket_path);
+		unlink(socket_path);
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, MAX_CLIENTS) != 0)
+		{
+			printf("Error listening on %s\n", socket_path);
+			exit(1);
+		}
+		fprintf(stderr, "Listening on %s\n", socket_path);
+	}
+
+	struct pollfd fds[MAX_CLIENTS + 1];
+	size_t owner[MAX_CLIENTS + 1];
+	while (!stop)
+	{
+		nfds_t nfds = 0;
+		if (listen_fd >= 0)
+		{
+			fds[nfds].fd = listen_fd;
+			fds[nfds].events = POLLIN;
+			owner[nfds++] = MAX_CLIENTS;
+		}
+		for (c=0; c<MAX_CLIENTS; c++)
+		{
+			if (clients[c].in_fd >= 0)
+			{
+				fds[nfds].fd = clients[c].in_fd;
+				fds[nfds].events = POLLIN;
+				owner[nfds++] = c;
+			}
+		}
+		if (nfds == 0)
+		{
+			break;		// stdin closed
+		}
+
+		int ready = poll(fds, nfds, IDLE_MS);
+		if (ready < 0 && errno != EINTR)
+		{
+			perror("poll");
+			break;
+		}
+
+		nfds_t f;
+		for (f=0; f<nfds && ready > 0; f++)
+		{
+			if (fds[f].revents == 0)
+			{
+				continue;
+			}
+			if (owner[f] == MAX_CLIENTS)
+			{
+				int fd = accept(listen_fd, NULL, NULL);
+				for (c=0; c<MAX_CLIENTS && clients[c].in_fd >= 0; c++)
+				{
+				}
+				if (fd >= 0 && c == MAX_CLIENTS)
+				{
+					close(fd);		// full
+				}
+				else if (fd >= 0)
+				{
+					clients[c].in_fd = fd;
+					clients[c].out_fd = fd;
+					clients[c].len = 0;
+					clients[c].discard = 0;
+				}
+			}
+			else if (serve(&clients[owner[f]]) != 0)
+			{
+				if (listen_fd >= 0)
+				{
+					close(clients[owner[f]].in_fd);
+				}
+				clients[owner[f]].in_fd = -1;
+			}
+		}
+
+		// off the hot path, have today's and tomorrow's tables ready
+		setpoint_prepare(&setpoint, now_unix());
+	}
+
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		unlink(socket_path);
+	}
+	char stats[MAX_REPLY * 2];
+	format_stats(stats, sizeof(stats));
+	fputs(stats, stderr);
+	return(0);
+}
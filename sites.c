@@ -0,0 +1,169 @@
+/**
+ * @file	sites.c
+ *
+ * @brief
+ *   Streaming site list reader
+ *
+ *  A site list is a CSV file with one site per line,
+ *
+ *     NAME,LATITUDE,LONGITUDE,TIMEZONE
+ *
+ * latitude and longitude in decimal degrees (west negative) and the time zone
+ * as whole hours from UTC. The first line may be a column header, blank lines
+ * and lines starting with '#' are skipped. Lines are read one at a time, so a
+ * list of any length is handled in constant memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#include "sites.h"
+
+#define SITES_FIELDS	4
+
+
+/// strip leading and trailing white space in place
+static char *trim(char *text)
+{
+	while (isspace((unsigned char)*text))
+	{
+		text++;
+	}
+	char *end = text + strlen(text);
+	while (end > text && isspace((unsigned char)end[-1]))
+	{
+		end--;
+	}
+	*end = '\0';
+	return(text);
+}
+
+
+/// parse a whole field as a number, 0 on success
+static int parse_number(const char *text, double *value)
+{
+	char *end;
+	*value = strtod(text, &end);
+	return((end == text || *end != '\0') ? -1 : 0);
+}
+
+
+/**
+ * @brief
+ *  Open a site list
+ *
+ * @param [out] reader pointer to site_reader_t struct, release with site_reader_close()
+ * @param [in] path file name, "-" for standard input
+ *
+ * @return 0 on success, -1 if the file could not be opened
+ */
+int site_reader_open(site_reader_t *reader, const char *path)
+{
+	memset(reader, 0, sizeof(*reader));
+	if (strcmp(path, "-") == 0)
+	{
+		reader->file = stdin;
+		return(0);
+	}
+
+	reader->file = fopen(path, "r");
+	if (reader->file == NULL)
+	{
+		return(-1);
+	}
+	reader->close = 1;
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Read the next site
+ *
+ * @param [in,out] reader pointer to site_reader_t struct
+ * @param [out] entry pointer to site_entry_t struct
+ *
+ * @return 1 if a site was read, 0 at the end of the list, -1 if line reader->line is not a valid site
+ */
+int site_reader_next(site_reader_t *reader, site_entry_t *entry)
+{
+	while (getline(&reader->buf, &reader->buf_size, reader->file) != -1)
+	{
+		reader->line++;
+		char *text = trim(reader->buf);
+		if (*text == '\0' || *text == '#')
+		{
+			continue;
+		}
+
+		char *field[SITES_FIELDS];
+		int n = 0;
+		char *next = text;
+		while (n < SITES_FIELDS && next != NULL)
+		{
+			field[n++] = next;
+			next = strchr(next, ',');
+			if (next != NULL)
+			{
+				*next++ = '\0';
+			}
+		}
+		if (n != SITES_FIELDS || next != NULL)
+		{
+			return(-1);
+		}
+		for (n=0; n<SITES_FIELDS; n++)
+		{
+			field[n] = trim(field[n]);
+		}
+
+		double latitude, longitude, timezone;
+		if (parse_number(field[1], &latitude) != 0)
+		{
+			if (reader->line == 1)
+			{
+				continue;		// column header
+			}
+			return(-1);
+		}
+		if (parse_number(field[2], &longitude) != 0 || parse_number(field[3], &timezone) != 0)
+		{
+			return(-1);
+		}
+		if (*field[0] == '\0' || strlen(field[0]) >= SITES_MAX_NAME ||
+			latitude < -90.0 || latitude > 90.0 || longitude < -180.0 || longitude > 180.0 ||
+			timezone != (int)timezone || timezone < -12 || timezone > 14)
+		{
+			return(-1);
+		}
+
+		strcpy(entry->name, field[0]);
+		entry->site.latitude = latitude;
+		entry->site.longitude = longitude;
+		entry->site.timezone = (int8_t)timezone;
+		return(1);
+	}
+
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Close a site list
+ *
+ * @param [in] reader pointer to site_reader_t struct
+ */
+void site_reader_close(site_reader_t *reader)
+{
+	if (reader->close)
+	{
+		fclose(reader->file);
+	}
+	free(reader->buf);
+	reader->buf = NULL;
+	reader->file = NULL;
+}
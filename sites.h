@@ -0,0 +1,36 @@
+/**
+ * @file	sites.h
+ *
+ * @brief
+ *   Header for the streaming site list reader
+ */
+
+#ifndef SITES_H
+#define SITES_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "solarpos.h"
+
+#define SITES_MAX_NAME		256		// longest site name, including the terminator
+
+/// one site from a site list
+typedef struct {
+	char name[SITES_MAX_NAME];
+	solarpos_site_t site;
+} site_entry_t;
+
+/// site list being read one line at a time, see site_reader_open()
+typedef struct {
+	FILE *file;
+	int close;					/// file was opened by site_reader_open()
+	uint64_t line;				/// line number of the last line read
+	char *buf;					/// getline() buffer
+	size_t buf_size;
+} site_reader_t;
+
+int site_reader_open(site_reader_t *reader, const char *path);
+int site_reader_next(site_reader_t *reader, site_entry_t *entry);
+void site_reader_close(site_reader_t *reader);
+
+#endif
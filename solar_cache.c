@@ -0,0 +1,219 @@
+/**
+ * @file	solar_cache.c
+ *
+ * @brief
+ *   On-disk solar position cache, see solar_cache.h for the layout
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "solar_cache.h"
+
+_Static_assert(sizeof(solar_cache_header_t) == 128, "solar_cache_header_t layout changed");
+
+#define FNV_OFFSET		0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+
+/// 64 bit FNV-1a over size bytes, continuing from hash
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	size_t i;
+	for (i=0; i<size; i++)
+	{
+		hash = (hash ^ p[i]) * FNV_PRIME;
+	}
+	return(hash);
+}
+
+
+/**
+ * @brief
+ *  Hash of a cache key and the cache format version
+ *
+ *  Each field is hashed separately so struct padding never reaches the hash.
+ *
+ * @param [in] key pointer to solar_cache_key_t struct
+ *
+ * @return 64 bit hash
+ */
+uint64_t solar_cache_hash(const solar_cache_key_t *key)
+{
+	uint32_t version = SOLAR_CACHE_VERSION;
+	uint64_t hash = FNV_OFFSET;
+	hash = fnv1a(hash, &version, sizeof(version));
+	hash = fnv1a(hash, &key->latitude, sizeof(key->latitude));
+	hash = fnv1a(hash, &key->longitude, sizeof(key->longitude));
+	hash = fnv1a(hash, &key->timezone, sizeof(key->timezone));
+	hash = fnv1a(hash, &key->year, sizeof(key->year));
+	hash = fnv1a(hash, &key->step_seconds, sizeof(key->step_seconds));
+	hash = fnv1a(hash, &key->count, sizeof(key->count));
+	hash = fnv1a(hash, &key->precision, sizeof(key->precision));
+	return(hash);
+}
+
+
+/**
+ * @brief
+ *  File name of the cache for a key, unique per key
+ *
+ * @param [out] path buffer for the file name
+ * @param [in] size size of the buffer
+ * @param [in] dir cache directory
+ * @param [in] key pointer to solar_cache_key_t struct
+ *
+ * @return 0 on success, -1 if the name doesn't fit
+ */
+int solar_cache_path(char *path, size_t size, const char *dir, const solar_cache_key_t *key)
+{
+	int len = snprintf(path, size, "%s/SolarPos_%u_%016" PRIx64 ".cache", dir, key->year, solar_cache_hash(key));
+	return((len < 0 || (size_t)len >= size) ? -1 : 0);
+}
+
+
+/**
+ * @brief
+ *  Write a cache file
+ *
+ *  The data goes to a temporary file which is renamed into place, so a
+ * concurrent or interrupted run never sees a partial cache.
+ *
+ * @param [in] path cache file name, see solar_cache_path()
+ * @param [in] key pointer to solar_cache_key_t struct
+ * @param [in] azimuth key->count azimuths in degrees
+ * @param [in] zenith key->count zeniths in degrees
+ *
+ * @return 0 on success, -1 on error with errno set
+ */
+int solar_cache_write(const char *path, const solar_cache_key_t *key, const double *azimuth, const double *zenith)
+{
+	solar_cache_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SOLAR_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SOLAR_CACHE_VERSION;
+	header.header_size = sizeof(header);
+	header.hash = solar_cache_hash(key);
+	header.latitude = key->latitude;
+	header.longitude = key->longitude;
+	header.count = key->count;
+	header.timezone = key->timezone;
+	header.year = key->year;
+	header.step_seconds = key->step_seconds;
+	header.precision = key->precision;
+
+	char tmp_path[4096];
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp_path))
+	{
+		return(-1);
+	}
+
+	FILE *file = fopen(tmp_path, "wb");
+	if (file == NULL)
+	{
+		return(-1);
+	}
+
+	int ok = (fwrite(&header, sizeof(header), 1, file) == 1)
+		&& (fwrite(azimuth, sizeof(double), key->count, file) == key->count)
+		&& (fwrite(zenith, sizeof(double), key->count, file) == key->count);
+
+	if (fclose(file) != 0)
+	{
+		ok = 0;
+	}
+	if (ok && rename(tmp_path, path) != 0)
+	{
+		ok = 0;
+	}
+	if (!ok)
+	{
+		unlink(tmp_path);
+	}
+	return(ok ? 0 : -1);
+}
+
+
+/**
+ * @brief
+ *  Map a cache file for reading and check it matches the key
+ *
+ * @param [in] path cache file name
+ * @param [in] key pointer to solar_cache_key_t struct the data must be for
+ * @param [out] cache pointer to solar_cache_t struct, release with solar_cache_close()
+ *
+ * @return 0 on success, -1 if the file is missing, truncated or for another key
+ */
+int solar_cache_open(const char *path, const solar_cache_key_t *key, solar_cache_t *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return(-1);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(solar_cache_header_t))
+	{
+		close(fd);
+		return(-1);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return(-1);
+	}
+
+	const solar_cache_header_t *header = map;
+	if (memcmp(header->magic, SOLAR_CACHE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != SOLAR_CACHE_VERSION
+		|| header->header_size < sizeof(solar_cache_header_t)
+		|| header->header_size > (size_t)st.st_size
+		|| header->header_size % sizeof(double) != 0
+		|| header->hash != solar_cache_hash(key)
+		|| header->latitude != key->latitude
+		|| header->longitude != key->longitude
+		|| header->timezone != key->timezone
+		|| header->year != key->year
+		|| header->step_seconds != key->step_seconds
+		|| header->count != key->count
+		|| header->precision != key->precision
+		|| ((size_t)st.st_size - header->header_size) / (2 * sizeof(double)) < header->count)
+	{
+		munmap(map, st.st_size);
+		return(-1);
+	}
+
+	cache->header = header;
+	cache->azimuth = (const double *)((const char *)map + header->header_size);
+	cache->zenith = cache->azimuth + header->count;
+	cache->map = map;
+	cache->map_size = st.st_size;
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Unmap a file opened with solar_cache_open()
+ *
+ * @param [in] cache pointer to solar_cache_t struct
+ */
+void solar_cache_close(solar_cache_t *cache)
+{
+	if (cache->map != NULL)
+	{
+		munmap(cache->map, cache->map_size);
+	}
+	memset(cache, 0, sizeof(*cache));
+}
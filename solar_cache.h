@@ -0,0 +1,70 @@
+/**
+ * @file	solar_cache.h
+ *
+ * @brief
+ *   Header for the on-disk solar position cache
+ *
+ *  A cache file holds the sun azimuth and zenith for every sample of one site
+ * and year, so later runs can map it instead of recomputing solar position.
+ * The file is one solar_cache_header_t followed by count double azimuths and
+ * then count double zeniths, sample i at 1 Jan 00:00 local standard time
+ * + i * step_seconds. Fields are in host byte order and both arrays start on
+ * an 8 byte boundary so the file is read in place.
+ *
+ *  The header carries a hash of the key (site, year, step, count, the
+ * precision of the solar position arithmetic and SOLAR_CACHE_VERSION). A file whose hash or key doesn't match is ignored and
+ * rebuilt, so bump SOLAR_CACHE_VERSION whenever the solar position results
+ * change.
+ */
+
+#ifndef SOLAR_CACHE_H
+#define SOLAR_CACHE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define SOLAR_CACHE_MAGIC		"TRKSOLC\0"
+#define SOLAR_CACHE_VERSION		2
+
+/// what a cache file was computed for
+typedef struct {
+	double   latitude;						/// Decimal latitude
+	double   longitude;						/// Decimal longitude
+	int8_t   timezone;						/// time zone, west longitudes negative
+	uint16_t year;							/// Calendar year, starting 1 Jan 00:00 local standard time
+	uint32_t step_seconds;					/// time between samples
+	uint64_t count;							/// number of samples
+	uint8_t  precision;						/// bits of the solar position arithmetic, 64 or 32 (TRACKER_FLOAT32)
+} solar_cache_key_t;
+
+typedef struct {
+	char     magic[8];						/// SOLAR_CACHE_MAGIC
+	uint32_t version;						/// SOLAR_CACHE_VERSION
+	uint32_t header_size;					/// bytes before the first azimuth
+	uint64_t hash;							/// solar_cache_hash() of the key fields below
+	double   latitude;
+	double   longitude;
+	uint64_t count;
+	int16_t  timezone;
+	uint16_t year;
+	uint32_t step_seconds;
+	uint8_t  precision;
+	uint8_t  reserved[71];					/// zero
+} solar_cache_header_t;
+
+/// a cache file opened with solar_cache_open()
+typedef struct {
+	const solar_cache_header_t *header;		/// points into the mapping
+	const double *azimuth;					/// header->count azimuths in degrees
+	const double *zenith;					/// header->count zeniths in degrees
+	void *map;
+	size_t map_size;
+} solar_cache_t;
+
+uint64_t solar_cache_hash(const solar_cache_key_t *key);
+int solar_cache_path(char *path, size_t size, const char *dir, const solar_cache_key_t *key);
+int solar_cache_write(const char *path, const solar_cache_key_t *key, const double *azimuth, const double *zenith);
+int solar_cache_open(const char *path, const solar_cache_key_t *key, solar_cache_t *cache);
+void solar_cache_close(solar_cache_t *cache);
+
+#endif
@@ -28,7 +28,7 @@
  * 
  * @return jday Integer julian day of the year
 */
-static inline int julian(solarpos_inputs_t *solarpos_inputs) 
+static inline int julian(const solarpos_inputs_t *solarpos_inputs) 
 {
 	int i=1, jday=0, k;
 	int nday[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
@@ -61,6 +61,54 @@ static inline int julian(solarpos_inputs_t *solarpos_inputs)
 }
 
 
+/**
+ * @brief 
+ *  Converts local standard time to zulu time and the day count used by the algorithm
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct
+ * @param [out] zulu_out zulu time in hours
+ * 
+ * @return Time in days referenced from noon 1 Jan 2000 UT
+*/
+static inline double zulu_time(const solarpos_inputs_t *solarpos_inputs, double *zulu_out) 
+{
+	int jday = julian(solarpos_inputs);	// Get julian day of year
+	double zulu = solarpos_inputs->hour + solarpos_inputs->minute / 60.0 - solarpos_inputs->timezone;	// Convert local time to zulu time
+	
+	if (zulu < 0.0) 
+	{
+		zulu = zulu + 24.0; // Force time between 0-24 hrs             
+		jday = jday - 1; // Adjust julian day if needed
+	}
+	else if (zulu > 24.0) 
+	{
+		zulu = zulu - 24.0;
+		jday = jday + 1;
+	}
+	int delta = solarpos_inputs->year - 1949;
+	int leap = delta/4;
+	double jd = 32916.5 + delta * 365.0 + leap + jday + zulu / 24.0;
+	
+	*zulu_out = zulu;
+	return(jd - 51545.0);     		// Time in days referenced from noon 1 Jan 2000
+}
+
+
+/**
+ * @brief 
+ *  Converts a local standard time to the time scale used by the algorithm
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct, only the date, time and timezone are used
+ * 
+ * @return Time in days referenced from noon 1 Jan 2000 UT
+*/
+double solarpos_time(const solarpos_inputs_t *solarpos_inputs) 
+{
+	double zulu;
+	return(zulu_time(solarpos_inputs, &zulu));
+}
+
+
 /**
  * @brief
  *   Calculate solar position at the given time of day and coordinates
@@ -83,32 +131,26 @@ static inline int julian(solarpos_inputs_t *solarpos_inputs)
  * to allow an elevation of 90 degrees without crashing the program and prevented
  * elevation from exceeding 90 degrees after refraction correction.
  * 
- * This function calls the function julian to get the julian day of year.
+ * This function calls the function zulu_time (and through it julian) to get
+ * the time in days referenced from noon 1 Jan 2000.
+ * 
+ * Only the fields in the mask are calculated and written, the rest of the
+ * struct is left as it was. The orbital terms and declination are always
+ * needed; the sidereal time, hour angle and elevation only for the azimuth,
+ * zenith and elevation, the refraction correction only for the latter two,
+ * and the equation of time and sunrise hour angle only for the day terms.
  * 
  * List of Parameters Passed to Function:
  * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct with location and time
+ * @param [in] fields SOLARPOS_* bits of the fields to fill
+ * @param [out] solarpos pointer to caller-owned solarpos_t struct
+ * @param [out] eot equation of time in hours, set if any of the sunrise, sunset or true time fields
+ *   is requested in fields
  */
-solarpos_t *solar_position_calc(solarpos_inputs_t *solarpos_inputs) 
+static inline void position(const solarpos_inputs_t *solarpos_inputs, uint32_t fields, solarpos_t *solarpos, double *eot) 
 {
-	double elv, azm, refrac, E, ws, sunrise, sunset, tst;
-
-	int jday = julian(solarpos_inputs);	// Get julian day of year
-	double zulu = solarpos_inputs->hour + solarpos_inputs->minute / 60.0 - solarpos_inputs->timezone;	// Convert local time to zulu time
-	
-	if (zulu < 0.0) 
-	{
-		zulu = zulu + 24.0; // Force time between 0-24 hrs             
-		jday = jday - 1; // Adjust julian day if needed
-	}
-	else if (zulu > 24.0) 
-	{
-		zulu = zulu - 24.0;
-		jday = jday + 1;
-	}
-	int delta = solarpos_inputs->year - 1949;
-	int leap = delta/4;
-	double jd = 32916.5 + delta * 365.0 + leap + jday + zulu / 24.0;
-	double time = jd - 51545.0;     		// Time in days referenced from noon 1 Jan 2000
+	double zulu;
+	double time = zulu_time(solarpos_inputs, &zulu);
 
 	double mnlong = 280.46 + 0.9856474*time;
 	mnlong = fmod(mnlong,360.0);		// Finds floating point remainder
@@ -147,133 +189,253 @@ solarpos_t *solar_position_calc(solarpos_inputs_t *solarpos_inputs)
 	}
 
 	double dec = asin( sin(oblqec)*sin(eclong) );       /* Declination in radians */
-
-	double gmst = 6.697375 + 0.0657098242*time + zulu;
-	gmst = fmod(gmst,24.0);
-	if ( gmst < 0.0 ) 
-	{
-		gmst = gmst + 24.0;         /* Greenwich mean sidereal time in hours */
-	}
-
-	double lmst = gmst + solarpos_inputs->longitude/15.0;
-	lmst = fmod(lmst,24.0);
-	if ( lmst < 0.0 ) 
-	{
-		lmst = lmst + 24.0;
-	}
-	lmst = deg2rad( lmst * 15.0 );         /* Local mean sidereal time in radians */
-
-	double ha = lmst - ra;
-	if ( ha < -M_PI ) 
-	{
-		ha = ha + 2 * M_PI;
-	} 
-	else if( ha > M_PI ) 
-	{
-		ha = ha - 2 * M_PI;             /* Hour angle in radians between -pi and pi */
-	}
-
 	double latrad = deg2rad(solarpos_inputs->latitude);                /* Change latitude to radians */
 
-	double arg = sin(dec)*sin(latrad) + cos(dec)*cos(latrad)*cos(ha);  /* For elevation in radians */
-	if ( arg > 1.0 ) 
+	if (fields & (SOLARPOS_AZIMUTH | SOLARPOS_ZENITH | SOLARPOS_ELEVATION))
 	{
-		elv = M_PI / 2.0;
-	} 
-	else if ( arg < -1.0 ) 
-	{
-		elv = -M_PI / 2.0;
-	} 
-	else 
-	{
-		elv = asin(arg);
-	}
+		double elv, azm, refrac;
 
-	if ( cos(elv) == 0.0 ) 
-	{ 	// Assign azimuth = 180 deg if elv = 90 or -90 
-		azm = M_PI;         
-	} 
-	else 
-	{	// For solar azimuth in radians per Iqbal 
-		arg = ((sin(elv)*sin(latrad)-sin(dec))/(cos(elv)*cos(latrad))); /* for azimuth */
-		
-		if( arg > 1.0 )
+		double gmst = 6.697375 + 0.0657098242*time + zulu;
+		gmst = fmod(gmst,24.0);
+		if ( gmst < 0.0 ) 
 		{
-			azm = 0.0;              /* Azimuth(radians)*/
+			gmst = gmst + 24.0;         /* Greenwich mean sidereal time in hours */
 		}
-		else if( arg < -1.0 )
+
+		double lmst = gmst + solarpos_inputs->longitude/15.0;
+		lmst = fmod(lmst,24.0);
+		if ( lmst < 0.0 ) 
 		{
-			azm = M_PI;
+			lmst = lmst + 24.0;
 		}
-		else
+		lmst = deg2rad( lmst * 15.0 );         /* Local mean sidereal time in radians */
+
+		double ha = lmst - ra;
+		if ( ha < -M_PI ) 
+		{
+			ha = ha + 2 * M_PI;
+		} 
+		else if( ha > M_PI ) 
 		{
-			azm = acos(arg);
+			ha = ha - 2 * M_PI;             /* Hour angle in radians between -pi and pi */
 		}
 
-		if( ( ha <= 0.0 && ha >= -M_PI) || ha >= M_PI )
+		double arg = sin(dec)*sin(latrad) + cos(dec)*cos(latrad)*cos(ha);  /* For elevation in radians */
+		if ( arg > 1.0 ) 
 		{
-			azm = M_PI - azm;
+			elv = M_PI / 2.0;
+		} 
+		else if ( arg < -1.0 ) 
+		{
+			elv = -M_PI / 2.0;
+		} 
+		else 
+		{
+			elv = asin(arg);
 		}
-		else
+
+		if (fields & SOLARPOS_AZIMUTH)
 		{
-			azm = M_PI + azm;
+			if ( cos(elv) == 0.0 ) 
+			{ 	// Assign azimuth = 180 deg if elv = 90 or -90 
+				azm = M_PI;         
+			} 
+			else 
+			{	// For solar azimuth in radians per Iqbal 
+				arg = ((sin(elv)*sin(latrad)-sin(dec))/(cos(elv)*cos(latrad))); /* for azimuth */
+				
+				if( arg > 1.0 )
+				{
+					azm = 0.0;              /* Azimuth(radians)*/
+				}
+				else if( arg < -1.0 )
+				{
+					azm = M_PI;
+				}
+				else
+				{
+					azm = acos(arg);
+				}
+
+				if( ( ha <= 0.0 && ha >= -M_PI) || ha >= M_PI )
+				{
+					azm = M_PI - azm;
+				}
+				else
+				{
+					azm = M_PI + azm;
+				}
+			}
+			solarpos->azimuth = rad2deg(azm);
 		}
-	}
-		
-		
 
-	elv = rad2deg(elv);          /* Change to degrees for atmospheric correction */
-	if( elv > -0.56 )
-		refrac = 3.51561 * ( 0.1594 + 0.0196 * elv + 0.00002 * pow( elv, 2 ) )/( 1.0 + 0.505 * elv + 0.0845 * pow( elv, 2 ) );
-	else
-		refrac = 0.56;
-	if( elv + refrac > 90.0 )
-	{
-		elv = deg2rad(90.0);
-	}
-	else
-	{
-		elv = deg2rad( ( elv + refrac ) ); /* Atmospheric corrected elevation(radians) */
+		if (fields & (SOLARPOS_ZENITH | SOLARPOS_ELEVATION))
+		{
+			elv = rad2deg(elv);          /* Change to degrees for atmospheric correction */
+			if( elv > -0.56 )
+				refrac = 3.51561 * ( 0.1594 + 0.0196 * elv + 0.00002 * ( elv * elv ) )/( 1.0 + 0.505 * elv + 0.0845 * ( elv * elv ) );	// what pow( elv, 2 ) compiles to
+			else
+				refrac = 0.56;
+			if( elv + refrac > 90.0 )
+			{
+				elv = deg2rad(90.0);
+			}
+			else
+			{
+				elv = deg2rad( ( elv + refrac ) ); /* Atmospheric corrected elevation(radians) */
+			}
+			if (fields & SOLARPOS_ZENITH)
+			{
+				solarpos->zenith = rad2deg(0.5 * M_PI - elv);   //  Zenith
+			}
+			if (fields & SOLARPOS_ELEVATION)
+			{
+				solarpos->elevation = rad2deg(elv);
+			}
+		}
 	}
 
-	E = ( mnlong - rad2deg(ra) ) / 15.0;       /* Equation of time in hours */
-	
-	if( E < - 0.33 )   /* Adjust for error occuring if mnlong and ra are in quadrants I and IV */
-	{
-		E = E + 24.0;
-	}
-	else if( E > 0.33 )
+	if (fields & SOLARPOS_DECLINATION)
 	{
-		E = E - 24.0;
+		solarpos->declination = rad2deg(dec);
 	}
 
-	arg = -tan(latrad)*tan(dec);
-	
-	if (arg >= 1.0)
-	{
-		ws = 0.0;                         /* No sunrise, continuous nights */
-	}
-	else if (arg <= -1.0)
+	if (fields & (SOLARPOS_SUNRISE | SOLARPOS_SUNSET | SOLARPOS_TRUE_TIME))
 	{
-		ws = M_PI;                          /* No sunset, continuous days */
+		double E = ( mnlong - rad2deg(ra) ) / 15.0;       /* Equation of time in hours */
+		
+		if( E < - 0.33 )   /* Adjust for error occuring if mnlong and ra are in quadrants I and IV */
+		{
+			E = E + 24.0;
+		}
+		else if( E > 0.33 )
+		{
+			E = E - 24.0;
+		}
+		*eot = E;
+
+		if (fields & (SOLARPOS_SUNRISE | SOLARPOS_SUNSET))
+		{
+			double ws;
+			double arg = -tan(latrad)*tan(dec);
+			
+			if (arg >= 1.0)
+			{
+				ws = 0.0;                         /* No sunrise, continuous nights */
+			}
+			else if (arg <= -1.0)
+			{
+				ws = M_PI;                          /* No sunset, continuous days */
+			}
+			else
+			{
+				ws = acos(arg);                   /* Sunrise hour angle in radians */
+			}
+
+			solarpos->sunrise = 12.0 - ( rad2deg(ws) ) / 15.0 - ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone) - E;
+			solarpos->sunset  = 12.0 + ( rad2deg(ws) ) / 15.0 - ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone) - E;
+		}
+
+		if (fields & SOLARPOS_TRUE_TIME)
+		{
+			solarpos->true_time = solarpos_inputs->hour + solarpos_inputs->minute / 60.0 + ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone ) + E;	// True solar time (hr) 
+		}
 	}
-	else
+
+	if (fields & SOLARPOS_ECCENTRICITY)
 	{
-		ws = acos(arg);                   /* Sunrise hour angle in radians */
+		double Eo = 1.00014 - 0.01671 * cos(mnanom) - 0.00014 * cos( 2.0 * mnanom);  // Earth-sun distance (AU)
+		solarpos->eccentricity = 1.0 / ( Eo * Eo );	// Eccentricity correction factor
 	}
-	
-	double Eo = 1.00014 - 0.01671 * cos(mnanom) - 0.00014 * cos( 2.0 * mnanom);  // Earth-sun distance (AU)
+}
+
+
+/**
+ * @brief
+ *   Calculate solar position at the given time of day and coordinates
+ * 
+ *  Fills every field, see position() for the algorithm. This is the
+ * reentrant form: no heap memory is used and the results are written to the
+ * caller's solarpos_t, which may live on the stack or in a preallocated array.
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct with location and time
+ * @param [out] solarpos pointer to caller-owned solarpos_t struct to fill
+ */
+void solar_position_calc_r(const solarpos_inputs_t *solarpos_inputs, solarpos_t *solarpos) 
+{
+	double eot;
+	position(solarpos_inputs, SOLARPOS_ALL, solarpos, &eot);
+}
+
+
+/**
+ * @brief
+ *   Calculate only some fields of the solar position
+ * 
+ *  Same results as solar_position_calc_r() for the fields asked for, e.g.
+ * SOLARPOS_AZIMUTH | SOLARPOS_ZENITH for tracking, which skips the equation
+ * of time, the sunrise hour angle and the eccentricity. Fields not asked for
+ * are left as they were. The day terms are cheaper from solar_position_day()
+ * once per day.
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct with location and time
+ * @param [in] fields SOLARPOS_* bits of the fields to fill
+ * @param [out] solarpos pointer to caller-owned solarpos_t struct
+ */
+void solar_position_calc_fields(const solarpos_inputs_t *solarpos_inputs, uint32_t fields, solarpos_t *solarpos) 
+{
+	double eot;
+	position(solarpos_inputs, fields, solarpos, &eot);
+}
+
+
+/**
+ * @brief
+ *   Calculate the day terms of the solar position
+ * 
+ *  Evaluated at 12:00 local standard time on the date in solarpos_inputs, the
+ * hour and minute are ignored. Sunrise and sunset are what
+ * solar_position_calc_r() gives at that time. The true solar time of any
+ * minute of the day is
+ * 
+ *     hour + minute / 60.0 + (longitude / 15.0 - timezone) + equation_of_time
+ * 
+ * to within the change of the equation of time over half a day.
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct with location and date
+ * @param [out] day pointer to solarpos_day_t struct to fill
+ */
+void solar_position_day(const solarpos_inputs_t *solarpos_inputs, solarpos_day_t *day) 
+{
+	solarpos_inputs_t noon = *solarpos_inputs;
+	noon.hour = 12;
+	noon.minute = 0;
+
+	solarpos_t solarpos;
+	position(&noon, SOLARPOS_DECLINATION | SOLARPOS_SUNRISE | SOLARPOS_SUNSET | SOLARPOS_ECCENTRICITY, &solarpos, &day->equation_of_time);
+	day->sunrise = solarpos.sunrise;
+	day->sunset = solarpos.sunset;
+	day->declination = solarpos.declination;
+	day->eccentricity = solarpos.eccentricity;
+}
+
 
+/**
+ * @brief
+ *   Calculate solar position at the given time of day and coordinates
+ * 
+ *  Legacy wrapper around solar_position_calc_r(). The returned struct is
+ * allocated with malloc() and must be released by the caller with free().
+ * 
+ * @param [in] solarpos_inputs pointer to solarpos_inputs_t struct with location and time
+ * 
+ * @return pointer to newly allocated solarpos_t struct
+ */
+solarpos_t *solar_position_calc(const solarpos_inputs_t *solarpos_inputs) 
+{
 	solarpos_t *solarpos = malloc(sizeof(solarpos_t));
 	assert(solarpos != NULL);
-	solarpos->sunrise = 12.0 - ( rad2deg(ws) ) / 15.0 - ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone) - E;
-	solarpos->sunset  = 12.0 + ( rad2deg(ws) ) / 15.0 - ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone) - E;
-	solarpos->eccentricity = 1.0 / ( Eo * Eo );	// Eccentricity correction factor
-	solarpos->true_time = solarpos_inputs->hour + solarpos_inputs->minute / 60.0 + ( solarpos_inputs->longitude / 15.0 - solarpos_inputs->timezone ) + E;	// True solar time (hr) 
-	solarpos->azimuth = rad2deg(azm);                        
-	solarpos->zenith = rad2deg(0.5 * M_PI - elv);   //  Zenith
-	solarpos->elevation = rad2deg(elv);
-	solarpos->declination = rad2deg(dec);
+	solar_position_calc_r(solarpos_inputs, solarpos);
 	
 	return(solarpos);
 }
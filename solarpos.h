@@ -12,6 +12,19 @@
 #ifndef SOLARPOS_H
 #define SOLARPOS_H
 
+#include <inttypes.h>
+
+/// solarpos_t fields for solar_position_calc_fields(), or'ed together
+#define SOLARPOS_AZIMUTH		(1u << 0)
+#define SOLARPOS_ZENITH			(1u << 1)
+#define SOLARPOS_ELEVATION		(1u << 2)
+#define SOLARPOS_DECLINATION	(1u << 3)
+#define SOLARPOS_SUNRISE		(1u << 4)
+#define SOLARPOS_SUNSET			(1u << 5)
+#define SOLARPOS_ECCENTRICITY	(1u << 6)
+#define SOLARPOS_TRUE_TIME		(1u << 7)
+#define SOLARPOS_ALL			0xffu
+
 /// elements to return sun parameters to calling function
 typedef struct {
 	double azimuth; 			/// sun azimuth in degrees, measured east from north
@@ -24,6 +37,15 @@ typedef struct {
 	double true_time; 			/// true solar time (hrs) 
 } solarpos_t;
 
+/// terms that change little over a day, see solar_position_day()
+typedef struct {
+	double sunrise; 			/// sunrise in local standard time (hrs), not corrected for refraction
+	double sunset; 				/// sunset in local standard time (hrs), not corrected for refraction
+	double declination; 		/// sun declination at local noon in degrees
+	double eccentricity; 		/// Eo, eccentricity correction factor
+	double equation_of_time;	/// true solar time minus local mean solar time (hrs)
+} solarpos_day_t;
+
 typedef struct {
 	uint16_t year;				/// Year, e.g. 2017
 	uint8_t  month; 			/// Calendar month of year (e.g. 1=Jan)
@@ -36,7 +58,18 @@ typedef struct {
 	double longitude;			/// Decimal longitude
 } solarpos_inputs_t;
 
-solarpos_t *solar_position_calc(solarpos_inputs_t *solarpos_inputs);
+/// fixed location used by the batch and table driven calculations
+typedef struct {
+	double latitude;			/// Decimal latitude
+	double longitude;			/// Decimal longitude
+	int8_t timezone;			/// time zone, west longitudes negative
+} solarpos_site_t;
+
+double solarpos_time(const solarpos_inputs_t *solarpos_inputs);
+void solar_position_calc_r(const solarpos_inputs_t *solarpos_inputs, solarpos_t *solarpos);
+void solar_position_calc_fields(const solarpos_inputs_t *solarpos_inputs, uint32_t fields, solarpos_t *solarpos);
+void solar_position_day(const solarpos_inputs_t *solarpos_inputs, solarpos_day_t *day);
+solarpos_t *solar_position_calc(const solarpos_inputs_t *solarpos_inputs);
 
 #endif
 
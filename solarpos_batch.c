@@ -0,0 +1,256 @@
+/**
+ * @file	solarpos_batch.c
+ *
+ * @brief
+ *   Batched (structure of arrays) solar position engine
+ *
+ *  The same kernel source (solarpos_batch_kernel.h) is compiled for a scalar
+ * fallback and, on x86, for SSE2 and AVX2. The widest kernel the CPU
+ * supports is picked the first time solar_position_batch() is called.
+ *
+ *  All kernels agree with solar_position_calc_r() to within
+ * SOLARPOS_BATCH_TOLERANCE degrees for azimuth, zenith, elevation and
+ * declination. Measured over a full year for every site in main.c the max
+ * difference is ~1e-9 deg for zenith and elevation and ~8e-7 deg for azimuth,
+ * whose acos() is ill-conditioned for the few samples closest to solar noon.
+ * The only exception is a sample sitting within rounding error of
+ * the -0.56 deg refraction cutoff, where the two code paths can land on
+ * opposite sides of the step in the refraction model.
+ *
+ *  solar_position_site_batch_f32() is a single precision version of the
+ * per-site step (solarpos_batch_kernel_f32.h) with twice the lanes, agreeing
+ * with the double kernels to within SOLARPOS_BATCH_F32_TOLERANCE degrees.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOLARPOS_BATCH_X86
+#endif
+
+#include "angle_conversions.h"
+#include "solarpos_batch.h"
+
+#define SPB_ROUND_MAGIC		6755399441055744.0		// 1.5 * 2^52, see v_round()
+#define SPF_ROUND_MAGIC		12582912.0f				// 1.5 * 2^23, see vf_round()
+
+
+/****************************************************************************/
+// Scalar fallback, one lane
+
+#define SPB_LANES		1
+#define SPB_FN(x)		x##_scalar
+#define SPB_SQRT(x)		((vd){ sqrt((x)[0]) })
+#define SPF_LANES		1
+#define SPF_SQRT(x)		((vf){ sqrtf((x)[0]) })
+#include "solarpos_batch_kernel.h"
+#include "solarpos_batch_kernel_f32.h"
+#undef SPB_LANES
+#undef SPB_FN
+#undef SPB_SQRT
+#undef SPF_LANES
+#undef SPF_SQRT
+
+#ifdef SOLARPOS_BATCH_X86
+
+/****************************************************************************/
+// SSE2, two lanes (four in single precision)
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#define SPB_LANES		2
+#define SPB_FN(x)		x##_sse2
+#define SPB_SQRT(x)		((vd)_mm_sqrt_pd((__m128d)(x)))
+#define SPF_LANES		4
+#define SPF_SQRT(x)		((vf)_mm_sqrt_ps((__m128)(x)))
+#include "solarpos_batch_kernel.h"
+#include "solarpos_batch_kernel_f32.h"
+#undef SPB_LANES
+#undef SPB_FN
+#undef SPB_SQRT
+#undef SPF_LANES
+#undef SPF_SQRT
+#pragma GCC pop_options
+
+/****************************************************************************/
+// AVX2, four lanes (eight in single precision)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SPB_LANES		4
+#define SPB_FN(x)		x##_avx2
+#define SPB_SQRT(x)		((vd)_mm256_sqrt_pd((__m256d)(x)))
+#define SPF_LANES		8
+#define SPF_SQRT(x)		((vf)_mm256_sqrt_ps((__m256)(x)))
+#include "solarpos_batch_kernel.h"
+#include "solarpos_batch_kernel_f32.h"
+#undef SPB_LANES
+#undef SPB_FN
+#undef SPB_SQRT
+#undef SPF_LANES
+#undef SPF_SQRT
+#pragma GCC pop_options
+
+#endif
+
+/****************************************************************************/
+
+/// one set of kernels per instruction set
+typedef struct {
+	solarpos_isa_t isa;
+	void (*batch)(const solarpos_site_t *site, const double *time, size_t n, solarpos_batch_t *out);
+	void (*ephem)(const double *time, size_t n, solarpos_ephem_t *out);
+	void (*site)(const solarpos_site_t *site, const solarpos_ephem_t *eph, size_t first, size_t n, solarpos_batch_t *out);
+	void (*site_f32)(const solarpos_site_t *site, const solarpos_ephem_f32_t *eph, size_t first, size_t n, solarpos_batch_f32_t *out);
+} solarpos_kernels_t;
+
+static const solarpos_kernels_t kernels_scalar = {SOLARPOS_ISA_SCALAR, solarpos_batch_scalar, ephem_batch_scalar, site_batch_scalar,
+	site_batch_f32_scalar};
+#ifdef SOLARPOS_BATCH_X86
+static const solarpos_kernels_t kernels_sse2 = {SOLARPOS_ISA_SSE2, solarpos_batch_sse2, ephem_batch_sse2, site_batch_sse2,
+	site_batch_f32_sse2};
+static const solarpos_kernels_t kernels_avx2 = {SOLARPOS_ISA_AVX2, solarpos_batch_avx2, ephem_batch_avx2, site_batch_avx2,
+	site_batch_f32_avx2};
+#endif
+
+// selected kernels, NULL until the first call, only accessed atomically
+static const solarpos_kernels_t *kernels = NULL;
+
+
+/**
+ * @brief
+ *  Select the kernel used by solar_position_batch()
+ *
+ *  Requests for an instruction set the CPU does not support fall back to the
+ * next narrower one. Intended to be called once at start-up (or by a
+ * benchmark comparing kernels). The selection is a single atomic pointer, so
+ * it is safe from any thread, and a batch call already running finishes with
+ * the kernels it started with. Without a call the widest available set is
+ * selected on first use.
+ *
+ * @param [in] isa instruction set to use, SOLARPOS_ISA_AUTO for the widest available
+ *
+ * @return instruction set actually selected
+ */
+solarpos_isa_t solarpos_batch_set_isa(solarpos_isa_t isa)
+{
+	const solarpos_kernels_t *selected = &kernels_scalar;
+#ifdef SOLARPOS_BATCH_X86
+	__builtin_cpu_init();
+	if ((isa == SOLARPOS_ISA_AUTO || isa == SOLARPOS_ISA_AVX2) && __builtin_cpu_supports("avx2"))
+	{
+		selected = &kernels_avx2;
+	}
+	else if (isa != SOLARPOS_ISA_SCALAR && __builtin_cpu_supports("sse2"))
+	{
+		selected = &kernels_sse2;
+	}
+#endif
+	(void)isa;
+
+	__atomic_store_n(&kernels, selected, __ATOMIC_RELEASE);
+	return(selected->isa);
+}
+
+
+/// the selected kernels, selecting the widest available on first use
+static const solarpos_kernels_t *current_kernels(void)
+{
+	const solarpos_kernels_t *current = __atomic_load_n(&kernels, __ATOMIC_ACQUIRE);
+	if (current == NULL)
+	{
+		solarpos_batch_set_isa(SOLARPOS_ISA_AUTO);
+		current = __atomic_load_n(&kernels, __ATOMIC_ACQUIRE);
+	}
+	return(current);
+}
+
+
+/**
+ * @brief
+ *  Name of the kernel used by solar_position_batch(), for reports
+ *
+ * @return "scalar", "sse2" or "avx2"
+ */
+const char *solarpos_batch_isa_name(void)
+{
+	switch (current_kernels()->isa)
+	{
+		case SOLARPOS_ISA_AVX2:	return("avx2");
+		case SOLARPOS_ISA_SSE2:	return("sse2");
+		default:				return("scalar");
+	}
+}
+
+
+/**
+ * @brief
+ *   Calculate solar position for many times at one site
+ *
+ *  Same algorithm as solar_position_calc_r(), evaluated several samples at a
+ * time and written to structure of arrays output. No heap memory is used.
+ *
+ * @param [in] site pointer to solarpos_site_t struct with the location
+ * @param [in] time array of n times in days referenced from noon 1 Jan 2000 UT, see solarpos_time()
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_t whose arrays hold at least n elements
+ */
+void solar_position_batch(const solarpos_site_t *site, const double *time, size_t n, solarpos_batch_t *out)
+{
+	current_kernels()->batch(site, time, n, out);
+}
+
+
+/**
+ * @brief
+ *   Calculate the site independent ephemeris terms for many times
+ *
+ *  These depend only on the UT instant, so one set can be shared by every
+ * site evaluated at the same times, see solar_position_site_batch().
+ *
+ * @param [in] time array of n times in days referenced from noon 1 Jan 2000 UT
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_ephem_t whose arrays hold at least n elements
+ */
+void solar_ephemeris_batch(const double *time, size_t n, solarpos_ephem_t *out)
+{
+	current_kernels()->ephem(time, n, out);
+}
+
+
+/**
+ * @brief
+ *   Calculate solar position for one site from precomputed ephemeris terms
+ *
+ *  Only the hour angle, elevation and azimuth step is done per sample. Gives
+ * the same results as solar_position_batch() for the same times.
+ *
+ * @param [in] site pointer to solarpos_site_t struct with the location
+ * @param [in] eph pointer to solarpos_ephem_t, e.g. from an ephemeris_t table
+ * @param [in] first index of the first ephemeris entry to use
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_t whose arrays hold at least n elements, filled from index 0
+ */
+void solar_position_site_batch(const solarpos_site_t *site, const solarpos_ephem_t *eph, size_t first, size_t n, solarpos_batch_t *out)
+{
+	current_kernels()->site(site, eph, first, n, out);
+}
+
+
+/**
+ * @brief
+ *   Single precision solar_position_site_batch(), azimuth and zenith only
+ *
+ * @param [in] site pointer to solarpos_site_t struct with the location
+ * @param [in] eph pointer to solarpos_ephem_f32_t, e.g. from ephemeris_init_f32()
+ * @param [in] first index of the first ephemeris entry to use
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_f32_t whose arrays hold at least n elements, filled from index 0
+ */
+void solar_position_site_batch_f32(const solarpos_site_t *site, const solarpos_ephem_f32_t *eph, size_t first, size_t n, solarpos_batch_f32_t *out)
+{
+	current_kernels()->site_f32(site, eph, first, n, out);
+}
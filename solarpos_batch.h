@@ -0,0 +1,67 @@
+/**
+ * @file	solarpos_batch.h
+ *
+ * @brief
+ *   Header for the batched (structure of arrays) solar position engine
+ */
+
+#ifndef SOLARPOS_BATCH_H
+#define SOLARPOS_BATCH_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "solarpos.h"
+
+/// Largest difference in degrees between the batch kernels and solar_position_calc_r()
+#define SOLARPOS_BATCH_TOLERANCE	1e-6
+
+/// Largest difference in degrees between solar_position_site_batch_f32() and solar_position_site_batch(), azimuth scaled by sin(zenith)
+#define SOLARPOS_BATCH_F32_TOLERANCE	5e-4
+
+/// caller-owned output arrays, each must hold at least n elements
+typedef struct {
+	double *azimuth; 			/// sun azimuth in degrees, measured east from north
+	double *zenith; 			/// sun zenith in degrees
+	double *elevation; 			/// sun elevation in degrees
+	double *declination; 		/// sun declination in degrees
+} solarpos_batch_t;
+
+/// caller-owned site independent terms, one entry per time sample
+typedef struct {
+	double *gmst;				/// Greenwich mean sidereal time in hours
+	double *ra;					/// right ascension in radians
+	double *sin_dec;			/// sine of the declination
+	double *cos_dec;			/// cosine of the declination
+	double *declination;		/// declination in degrees
+} solarpos_ephem_t;
+
+/// single precision solarpos_batch_t, the fields the tracker angle needs
+typedef struct {
+	float *azimuth; 			/// sun azimuth in degrees, measured east from north
+	float *zenith; 				/// sun zenith in degrees
+} solarpos_batch_f32_t;
+
+/// single precision solarpos_ephem_t, without the declination in degrees
+typedef struct {
+	float *gmst;				/// Greenwich mean sidereal time in hours
+	float *ra;					/// right ascension in radians
+	float *sin_dec;				/// sine of the declination
+	float *cos_dec;				/// cosine of the declination
+} solarpos_ephem_f32_t;
+
+/// instruction sets the batch kernels are built for
+typedef enum {
+	SOLARPOS_ISA_AUTO = 0,		/// pick the widest one the CPU supports
+	SOLARPOS_ISA_SCALAR,		/// one lane, portable C
+	SOLARPOS_ISA_SSE2,			/// two lanes
+	SOLARPOS_ISA_AVX2			/// four lanes
+} solarpos_isa_t;
+
+void solar_position_batch(const solarpos_site_t *site, const double *time, size_t n, solarpos_batch_t *out);
+void solar_ephemeris_batch(const double *time, size_t n, solarpos_ephem_t *out);
+void solar_position_site_batch(const solarpos_site_t *site, const solarpos_ephem_t *eph, size_t first, size_t n, solarpos_batch_t *out);
+void solar_position_site_batch_f32(const solarpos_site_t *site, const solarpos_ephem_f32_t *eph, size_t first, size_t n, solarpos_batch_f32_t *out);
+solarpos_isa_t solarpos_batch_set_isa(solarpos_isa_t isa);
+const char *solarpos_batch_isa_name(void);
+
+#endif
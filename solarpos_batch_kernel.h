@@ -0,0 +1,414 @@
+/**
+ * @file	solarpos_batch_kernel.h
+ *
+ * @brief
+ *   Vector math and solar position kernels for the batch engine
+ *
+ *  This file is included once per instruction set by solarpos_batch.c, so it
+ * has no include guard. The includer defines:
+ *   SPB_LANES    number of doubles per vector (1, 2 or 4)
+ *   SPB_FN(x)    appends the instruction set suffix to a name
+ *   SPB_SQRT(x)  element-wise square root of a vector
+ *
+ * The trig kernels are the Cephes polynomials (sin.c, atan.c) written with
+ * GCC vector extensions and branch-free selects. asin and acos are built on
+ * atan2 so only two polynomial families are needed. Every function here is
+ * accurate to a few ulp over the argument ranges the solar position
+ * algorithm produces.
+ */
+
+typedef double  SPB_FN(vd_t) __attribute__ ((vector_size (8 * SPB_LANES)));
+typedef int64_t SPB_FN(vl_t) __attribute__ ((vector_size (8 * SPB_LANES)));
+
+#define vd			SPB_FN(vd_t)
+#define vl			SPB_FN(vl_t)
+#define V_SEL		SPB_FN(v_sel)
+#define V_NEG_IF	SPB_FN(v_neg_if)
+#define V_ROUND		SPB_FN(v_round)
+#define V_FMODP		SPB_FN(v_fmodp)
+#define V_SINCOS	SPB_FN(v_sincos)
+#define V_ATAN		SPB_FN(v_atan)
+#define V_ATAN2		SPB_FN(v_atan2)
+#define V_ASIN		SPB_FN(v_asin)
+#define V_ACOS		SPB_FN(v_acos)
+#define V_LOAD		SPB_FN(v_load)
+#define V_STORE		SPB_FN(v_store)
+
+#define VC(c)		((vd){0} + (c))		// broadcast a scalar constant
+
+
+/// select a where mask is set, else b
+static inline vd V_SEL(vl mask, vd a, vd b)
+{
+	return((vd)(((vl)a & mask) | ((vl)b & ~mask)));
+}
+
+/// flip the sign of x where mask is set
+static inline vd V_NEG_IF(vl mask, vd x)
+{
+	return((vd)((vl)x ^ (mask & ((vl){0} + INT64_MIN))));
+}
+
+/// round to nearest integer, valid for |x| < 2^51
+static inline vd V_ROUND(vd x)
+{
+	return((x + SPB_ROUND_MAGIC) - SPB_ROUND_MAGIC);
+}
+
+/// floating point remainder of x/m in [0, m), replaces fmod() plus the negative fix-up
+static inline vd V_FMODP(vd x, double m)
+{
+	vd q = V_ROUND(x / m);
+	vd r = x - q * m;
+	return(V_SEL(r < 0.0, r + m, r));
+}
+
+/// sine and cosine of x in radians
+static inline void V_SINCOS(vd x, vd *s, vd *c)
+{
+	vd t = x * (2.0 / M_PI) + SPB_ROUND_MAGIC;
+	vl q = (vl)t;						// integer quadrant lives in the low mantissa bits
+	vd j = t - SPB_ROUND_MAGIC;
+
+	vd y = ((x - j * 1.57079625129699707031E0) - j * 7.54978941586159635335E-8) - j * 5.39030285815811905290E-15;
+	vd z = y * y;
+
+	vd ps = ((((( 1.58962301576546568060E-10 * z
+				- 2.50507477628578072866E-8) * z
+				+ 2.75573136213857245213E-6) * z
+				- 1.98412698295895385996E-4) * z
+				+ 8.33333333332211858878E-3) * z
+				- 1.66666666666666307295E-1);
+	ps = y + y * z * ps;
+
+	vd pc = ((((( -1.13585365213876817300E-11 * z
+				+ 2.08757008419747316778E-9) * z
+				- 2.75573141792967388112E-7) * z
+				+ 2.48015872888517045348E-5) * z
+				- 1.38888888888730564116E-3) * z
+				+ 4.16666666666665929218E-2);
+	pc = 1.0 - 0.5 * z + z * z * pc;
+
+	vl swap = (q & 1) != 0;
+	*s = V_NEG_IF((q & 2) != 0, V_SEL(swap, pc, ps));
+	*c = V_NEG_IF(((q + 1) & 2) != 0, V_SEL(swap, ps, pc));
+}
+
+/// arc tangent in radians
+static inline vd V_ATAN(vd x)
+{
+	vl neg = x < 0.0;
+	vd ax = V_SEL(neg, -x, x);
+	vl big = ax > 2.41421356237309504880;	// tan(3pi/8)
+	vl mid = (ax > 0.66) & ~big;
+
+	vd y = V_SEL(big, VC(M_PI / 2), V_SEL(mid, VC(M_PI / 4), VC(0.0)));
+	vd r = V_SEL(big, -1.0 / ax, V_SEL(mid, (ax - 1.0) / (ax + 1.0), ax));
+	vd z = r * r;
+
+	vd p = ((((-8.750608600031904122785E-1 * z
+			- 1.615753718733365076637E1) * z
+			- 7.500855792314704667340E1) * z
+			- 1.228866684490136173410E2) * z
+			- 6.485021904942025371773E1);
+	vd q = (((((z
+			+ 2.485846490142306297962E1) * z
+			+ 1.650270098316988542046E2) * z
+			+ 4.328810604912902668951E2) * z
+			+ 4.853903996359136964868E2) * z
+			+ 1.945506571482613964425E2);
+
+	z = r * (z * p / q) + r;
+	z += V_SEL(big, VC(6.123233995736765886130E-17), V_SEL(mid, VC(0.5 * 6.123233995736765886130E-17), VC(0.0)));
+	y += z;
+
+	return(V_NEG_IF(neg, y));
+}
+
+/// four quadrant arc tangent of y/x in radians
+static inline vd V_ATAN2(vd y, vd x)
+{
+	vd a = V_ATAN(y / x);
+	vl xneg = x < 0.0;
+	a += V_SEL(xneg & (y >= 0.0), VC(M_PI), VC(0.0));
+	a -= V_SEL(xneg & (y < 0.0), VC(M_PI), VC(0.0));
+	return(V_SEL((x == 0.0) & (y == 0.0), VC(0.0), a));
+}
+
+/// arc sine in radians, x must be within [-1, 1]
+static inline vd V_ASIN(vd x)
+{
+	return(V_ATAN2(x, SPB_SQRT((1.0 - x) * (1.0 + x))));
+}
+
+/// arc cosine in radians, x must be within [-1, 1]
+static inline vd V_ACOS(vd x)
+{
+	return(V_ATAN2(SPB_SQRT((1.0 - x) * (1.0 + x)), x));
+}
+
+static inline vd V_LOAD(const double *p)
+{
+	vd v;
+	memcpy(&v, p, sizeof(v));
+	return(v);
+}
+
+static inline void V_STORE(double *p, vd v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+
+/**
+ * @brief
+ *  Site independent (ephemeris) terms for SPB_LANES time samples
+ *
+ *  First half of solar_position_calc_r(), see solarpos.c for the description
+ * of each term.
+ *
+ * @param [in] time vector of times in days referenced from noon 1 Jan 2000 UT
+ * @param [out] gmst Greenwich mean sidereal time in hours
+ * @param [out] ra right ascension in radians
+ * @param [out] sin_dec sine of the declination
+ * @param [out] cos_dec cosine of the declination
+ * @param [out] dec_deg declination in degrees
+ */
+static inline void SPB_FN(ephem_lanes)(vd time, vd *gmst, vd *ra, vd *sin_dec, vd *cos_dec, vd *dec_deg)
+{
+	// zulu time recovered from the day count
+	vd dayfrac = V_FMODP(time + 0.5, 1.0);
+	vd zulu = dayfrac * 24.0;
+
+	vd mnlong = V_FMODP(280.46 + 0.9856474 * time, 360.0);
+	vd mnanom = V_FMODP(357.528 + 0.9856003 * time, 360.0) * DEG_TO_RAD;
+
+	vd sin_anom, cos_anom;
+	V_SINCOS(mnanom, &sin_anom, &cos_anom);
+	vd eclong = V_FMODP(mnlong + 1.915 * sin_anom + 0.020 * (2.0 * sin_anom * cos_anom), 360.0) * DEG_TO_RAD;
+
+	vd oblqec = (23.439 - 0.0000004 * time) * DEG_TO_RAD;
+	vd sin_eclong, cos_eclong, sin_oblqec, cos_oblqec;
+	V_SINCOS(eclong, &sin_eclong, &cos_eclong);
+	V_SINCOS(oblqec, &sin_oblqec, &cos_oblqec);
+
+	// right ascension in [0, 2pi) is atan2 of the same terms
+	*ra = V_ATAN2(cos_oblqec * sin_eclong, cos_eclong);
+	*ra = V_SEL(*ra < 0.0, *ra + 2.0 * M_PI, *ra);
+
+	*sin_dec = sin_oblqec * sin_eclong;
+	*cos_dec = SPB_SQRT((1.0 - *sin_dec) * (1.0 + *sin_dec));
+	*dec_deg = V_ASIN(*sin_dec) * RAD_TO_DEG;
+
+	*gmst = V_FMODP(6.697375 + 0.0657098242 * time + zulu, 24.0);
+}
+
+
+/**
+ * @brief
+ *  Site dependent terms (hour angle, elevation, azimuth) for SPB_LANES samples
+ *
+ *  Second half of solar_position_calc_r(), see solarpos.c for the description
+ * of each term.
+ *
+ * @param [in] gmst Greenwich mean sidereal time in hours
+ * @param [in] ra right ascension in radians
+ * @param [in] sin_dec sine of the declination
+ * @param [in] cos_dec cosine of the declination
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [out] azm_deg sun azimuth in degrees
+ * @param [out] zen_deg sun zenith in degrees
+ * @param [out] elv_deg sun elevation in degrees
+ */
+static inline void SPB_FN(site_lanes)(vd gmst, vd ra, vd sin_dec, vd cos_dec, const solarpos_site_t *site,
+	vd *azm_deg, vd *zen_deg, vd *elv_deg)
+{
+	vd lmst = V_FMODP(gmst + site->longitude / 15.0, 24.0) * (15.0 * DEG_TO_RAD);
+
+	vd ha = lmst - ra;
+	ha = V_SEL(ha < -M_PI, ha + 2.0 * M_PI, V_SEL(ha > M_PI, ha - 2.0 * M_PI, ha));
+
+	double latrad = deg2rad(site->latitude);
+	double sin_lat = sin(latrad);
+	double cos_lat = cos(latrad);
+
+	vd sin_ha, cos_ha;
+	V_SINCOS(ha, &sin_ha, &cos_ha);
+	(void)sin_ha;
+
+	vd arg = sin_dec * sin_lat + cos_dec * cos_lat * cos_ha;
+	arg = V_SEL(arg > 1.0, VC(1.0), V_SEL(arg < -1.0, VC(-1.0), arg));
+	vd elv = V_ASIN(arg);
+	vd cos_elv = SPB_SQRT((1.0 - arg) * (1.0 + arg));
+
+	arg = (arg * sin_lat - sin_dec) / (cos_elv * cos_lat);
+	arg = V_SEL(arg > 1.0, VC(1.0), V_SEL(arg < -1.0, VC(-1.0), arg));
+	vd azm = V_ACOS(arg);
+	vl morning = ((ha <= 0.0) & (ha >= -M_PI)) | (ha >= M_PI);
+	azm = V_SEL(morning, M_PI - azm, M_PI + azm);
+	azm = V_SEL(cos_elv == 0.0, VC(M_PI), azm);
+
+	// atmospheric refraction correction in degrees
+	elv = elv * RAD_TO_DEG;
+	vd refrac = 3.51561 * (0.1594 + 0.0196 * elv + 0.00002 * elv * elv) / (1.0 + 0.505 * elv + 0.0845 * elv * elv);
+	refrac = V_SEL(elv > -0.56, refrac, VC(0.56));
+	elv = elv + refrac;
+	elv = V_SEL(elv > 90.0, VC(90.0), elv);
+
+	*azm_deg = azm * RAD_TO_DEG;
+	*zen_deg = 90.0 - elv;
+	*elv_deg = elv;
+}
+
+
+/**
+ * @brief
+ *  Batch solar position for n time samples at one site
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] time array of n times in days referenced from noon 1 Jan 2000 UT
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_t with caller-owned arrays
+ */
+static void SPB_FN(solarpos_batch)(const solarpos_site_t *site, const double *time, size_t n, solarpos_batch_t *out)
+{
+	double t[SPB_LANES], a[SPB_LANES], z[SPB_LANES], e[SPB_LANES], d[SPB_LANES];
+	vd gmst, ra, sin_dec, cos_dec, dec, azm, zen, elv;
+	size_t i, k;
+
+	for (i=0; i<n; i+=SPB_LANES)
+	{
+		// the last partial vector is padded with copies of the final sample
+		size_t rem = (n - i < SPB_LANES) ? n - i : SPB_LANES;
+		for (k=0; k<SPB_LANES; k++)
+		{
+			t[k] = time[(k < rem) ? i + k : n - 1];
+		}
+
+		SPB_FN(ephem_lanes)(V_LOAD(t), &gmst, &ra, &sin_dec, &cos_dec, &dec);
+		SPB_FN(site_lanes)(gmst, ra, sin_dec, cos_dec, site, &azm, &zen, &elv);
+
+		V_STORE(a, azm);
+		V_STORE(z, zen);
+		V_STORE(e, elv);
+		V_STORE(d, dec);
+		for (k=0; k<rem; k++)
+		{
+			out->azimuth[i + k] = a[k];
+			out->zenith[i + k] = z[k];
+			out->elevation[i + k] = e[k];
+			out->declination[i + k] = d[k];
+		}
+	}
+}
+
+
+/**
+ * @brief
+ *  Batch ephemeris terms for n time samples, shared by every site
+ *
+ * @param [in] time array of n times in days referenced from noon 1 Jan 2000 UT
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_ephem_t with caller-owned arrays
+ */
+static void SPB_FN(ephem_batch)(const double *time, size_t n, solarpos_ephem_t *out)
+{
+	double t[SPB_LANES], g[SPB_LANES], r[SPB_LANES], s[SPB_LANES], c[SPB_LANES], d[SPB_LANES];
+	vd gmst, ra, sin_dec, cos_dec, dec;
+	size_t i, k;
+
+	for (i=0; i<n; i+=SPB_LANES)
+	{
+		size_t rem = (n - i < SPB_LANES) ? n - i : SPB_LANES;
+		for (k=0; k<SPB_LANES; k++)
+		{
+			t[k] = time[(k < rem) ? i + k : n - 1];
+		}
+
+		SPB_FN(ephem_lanes)(V_LOAD(t), &gmst, &ra, &sin_dec, &cos_dec, &dec);
+
+		V_STORE(g, gmst);
+		V_STORE(r, ra);
+		V_STORE(s, sin_dec);
+		V_STORE(c, cos_dec);
+		V_STORE(d, dec);
+		for (k=0; k<rem; k++)
+		{
+			out->gmst[i + k] = g[k];
+			out->ra[i + k] = r[k];
+			out->sin_dec[i + k] = s[k];
+			out->cos_dec[i + k] = c[k];
+			out->declination[i + k] = d[k];
+		}
+	}
+}
+
+
+/**
+ * @brief
+ *  Batch solar position for one site from precomputed ephemeris terms
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] eph pointer to solarpos_ephem_t holding at least first + n entries
+ * @param [in] first index of the first ephemeris entry to use
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_t with caller-owned arrays, indexed from 0
+ */
+static void SPB_FN(site_batch)(const solarpos_site_t *site, const solarpos_ephem_t *eph, size_t first, size_t n, solarpos_batch_t *out)
+{
+	vd azm, zen, elv;
+	size_t i = 0;
+
+	for (; i + SPB_LANES <= n; i += SPB_LANES)
+	{
+		size_t j = first + i;
+		SPB_FN(site_lanes)(V_LOAD(&eph->gmst[j]), V_LOAD(&eph->ra[j]), V_LOAD(&eph->sin_dec[j]), V_LOAD(&eph->cos_dec[j]),
+			site, &azm, &zen, &elv);
+		V_STORE(&out->azimuth[i], azm);
+		V_STORE(&out->zenith[i], zen);
+		V_STORE(&out->elevation[i], elv);
+		memcpy(&out->declination[i], &eph->declination[j], sizeof(vd));
+	}
+
+	if (i < n)
+	{
+		double g[SPB_LANES], r[SPB_LANES], s[SPB_LANES], c[SPB_LANES];
+		double a[SPB_LANES], z[SPB_LANES], e[SPB_LANES];
+		size_t k, rem = n - i;
+		for (k=0; k<SPB_LANES; k++)
+		{
+			size_t j = first + ((k < rem) ? i + k : n - 1);
+			g[k] = eph->gmst[j];
+			r[k] = eph->ra[j];
+			s[k] = eph->sin_dec[j];
+			c[k] = eph->cos_dec[j];
+		}
+		SPB_FN(site_lanes)(V_LOAD(g), V_LOAD(r), V_LOAD(s), V_LOAD(c), site, &azm, &zen, &elv);
+		V_STORE(a, azm);
+		V_STORE(z, zen);
+		V_STORE(e, elv);
+		for (k=0; k<rem; k++)
+		{
+			out->azimuth[i + k] = a[k];
+			out->zenith[i + k] = z[k];
+			out->elevation[i + k] = e[k];
+			out->declination[i + k] = eph->declination[first + i + k];
+		}
+	}
+}
+
+
+#undef VC
+#undef vd
+#undef vl
+#undef V_SEL
+#undef V_NEG_IF
+#undef V_ROUND
+#undef V_FMODP
+#undef V_SINCOS
+#undef V_ATAN
+#undef V_ATAN2
+#undef V_ASIN
+#undef V_ACOS
+#undef V_LOAD
+#undef V_STORE
@@ -0,0 +1,248 @@
+/**
+ * @file	solarpos_batch_kernel_f32.h
+ *
+ * @brief
+ *   Single precision site kernel for the batch engine
+ *
+ *  Included once per instruction set by solarpos_batch.c next to
+ * solarpos_batch_kernel.h, so it has no include guard. The includer defines:
+ *   SPF_LANES    number of floats per vector (1, 4 or 8)
+ *   SPB_FN(x)    appends the instruction set suffix to a name
+ *   SPF_SQRT(x)  element-wise square root of a vector
+ *
+ * Only the per-site step (hour angle, elevation, azimuth) is here; the
+ * ephemeris terms it reads are rounded from the double ones, see
+ * ephemeris_init_f32(). The trig kernels are the single precision Cephes
+ * polynomials (sinf.c, atanf.c). Elevation and azimuth both come from
+ * atan2() of the components of the sun vector rather than the asin() and
+ * acos() of solar_position_calc_r(), which in single precision would lose
+ * up to ~0.02 deg with the sun near the zenith or close to solar noon.
+ */
+
+typedef float   SPB_FN(vf_t) __attribute__ ((vector_size (4 * SPF_LANES)));
+typedef int32_t SPB_FN(vi_t) __attribute__ ((vector_size (4 * SPF_LANES)));
+
+#define vf			SPB_FN(vf_t)
+#define vi			SPB_FN(vi_t)
+#define VF_SEL		SPB_FN(vf_sel)
+#define VF_NEG_IF	SPB_FN(vf_neg_if)
+#define VF_ROUND	SPB_FN(vf_round)
+#define VF_FMODP	SPB_FN(vf_fmodp)
+#define VF_SINCOS	SPB_FN(vf_sincos)
+#define VF_ATAN		SPB_FN(vf_atan)
+#define VF_ATAN2	SPB_FN(vf_atan2)
+#define VF_LOAD		SPB_FN(vf_load)
+#define VF_STORE	SPB_FN(vf_store)
+
+#define VCF(c)		((vf){0} + (float)(c))	// broadcast a scalar constant
+
+#define SPF_PI		((float)M_PI)
+
+
+/// select a where mask is set, else b
+static inline vf VF_SEL(vi mask, vf a, vf b)
+{
+	return((vf)(((vi)a & mask) | ((vi)b & ~mask)));
+}
+
+/// flip the sign of x where mask is set
+static inline vf VF_NEG_IF(vi mask, vf x)
+{
+	return((vf)((vi)x ^ (mask & ((vi){0} + INT32_MIN))));
+}
+
+/// round to nearest integer, valid for |x| < 2^22
+static inline vf VF_ROUND(vf x)
+{
+	return((x + SPF_ROUND_MAGIC) - SPF_ROUND_MAGIC);
+}
+
+/// floating point remainder of x/m in [0, m)
+static inline vf VF_FMODP(vf x, float m)
+{
+	vf q = VF_ROUND(x / m);
+	vf r = x - q * m;
+	return(VF_SEL(r < 0.0f, r + m, r));
+}
+
+/// sine and cosine of x in radians, |x| up to a few turns
+static inline void VF_SINCOS(vf x, vf *s, vf *c)
+{
+	vf t = x * (float)(2.0 / M_PI) + SPF_ROUND_MAGIC;
+	vi q = (vi)t;						// integer quadrant lives in the low mantissa bits
+	vf j = t - SPF_ROUND_MAGIC;
+
+	vf y = ((x - j * 1.5703125f) - j * 4.837512969970703125e-4f) - j * 7.54978995489188216e-8f;
+	vf z = y * y;
+
+	vf ps = ((-1.9515295891E-4f * z
+			+ 8.3321608736E-3f) * z
+			- 1.6666654611E-1f);
+	ps = y + y * z * ps;
+
+	vf pc = ((2.443315711809948E-5f * z
+			- 1.388731625493765E-3f) * z
+			+ 4.166664568298827E-2f);
+	pc = 1.0f - 0.5f * z + z * z * pc;
+
+	vi swap = (q & 1) != 0;
+	*s = VF_NEG_IF((q & 2) != 0, VF_SEL(swap, pc, ps));
+	*c = VF_NEG_IF(((q + 1) & 2) != 0, VF_SEL(swap, ps, pc));
+}
+
+/// arc tangent in radians
+static inline vf VF_ATAN(vf x)
+{
+	vi neg = x < 0.0f;
+	vf ax = VF_SEL(neg, -x, x);
+	vi big = ax > 2.414213562373095f;		// tan(3pi/8)
+	vi mid = (ax > 0.4142135623730950f) & ~big;	// tan(pi/8)
+
+	vf y = VF_SEL(big, VCF(M_PI / 2), VF_SEL(mid, VCF(M_PI / 4), VCF(0.0)));
+	vf r = VF_SEL(big, -1.0f / ax, VF_SEL(mid, (ax - 1.0f) / (ax + 1.0f), ax));
+	vf z = r * r;
+
+	y += ((( 8.05374449538e-2f * z
+			- 1.38776856032E-1f) * z
+			+ 1.99777106478E-1f) * z
+			- 3.33329491539E-1f) * z * r + r;
+
+	return(VF_NEG_IF(neg, y));
+}
+
+/// four quadrant arc tangent of y/x in radians
+static inline vf VF_ATAN2(vf y, vf x)
+{
+	vf a = VF_ATAN(y / x);
+	vi xneg = x < 0.0f;
+	a += VF_SEL(xneg & (y >= 0.0f), VCF(M_PI), VCF(0.0));
+	a -= VF_SEL(xneg & (y < 0.0f), VCF(M_PI), VCF(0.0));
+	return(VF_SEL((x == 0.0f) & (y == 0.0f), VCF(0.0), a));
+}
+
+static inline vf VF_LOAD(const float *p)
+{
+	vf v;
+	memcpy(&v, p, sizeof(v));
+	return(v);
+}
+
+static inline void VF_STORE(float *p, vf v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+
+/**
+ * @brief
+ *  Site dependent terms (hour angle, elevation, azimuth) for SPF_LANES samples
+ *
+ * @param [in] gmst Greenwich mean sidereal time in hours
+ * @param [in] ra right ascension in radians
+ * @param [in] sin_dec sine of the declination
+ * @param [in] cos_dec cosine of the declination
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [out] azm_deg sun azimuth in degrees
+ * @param [out] zen_deg sun zenith in degrees
+ */
+static inline void SPB_FN(site_lanes_f32)(vf gmst, vf ra, vf sin_dec, vf cos_dec, const solarpos_site_t *site,
+	vf *azm_deg, vf *zen_deg)
+{
+	vf lmst = VF_FMODP(gmst + (float)(site->longitude / 15.0), 24.0f) * (float)(15.0 * DEG_TO_RAD);
+
+	vf ha = lmst - ra;
+	ha = VF_SEL(ha < -SPF_PI, ha + 2.0f * SPF_PI, VF_SEL(ha > SPF_PI, ha - 2.0f * SPF_PI, ha));
+
+	double latrad = deg2rad(site->latitude);
+	float sin_lat = (float)sin(latrad);
+	float cos_lat = (float)cos(latrad);
+
+	vf sin_ha, cos_ha;
+	VF_SINCOS(ha, &sin_ha, &cos_ha);
+
+	// east, north and up components of the sun vector, east and north are zero only with the sun overhead
+	vf east = -cos_dec * sin_ha;
+	vf north = sin_dec * cos_lat - cos_dec * sin_lat * cos_ha;
+	vf up = sin_dec * sin_lat + cos_dec * cos_lat * cos_ha;
+
+	// atan2() rather than asin(up), which loses ~0.004 deg in single precision near the zenith
+	vf elv = VF_ATAN2(up, SPF_SQRT(east * east + north * north));
+	vf azm = VF_ATAN2(east, north);
+	azm = VF_SEL(azm < 0.0f, azm + 2.0f * SPF_PI, azm);
+	azm = VF_SEL((east == 0.0f) & (north == 0.0f), VCF(M_PI), azm);
+
+	// atmospheric refraction correction in degrees
+	elv = elv * (float)RAD_TO_DEG;
+	vf refrac = 3.51561f * (0.1594f + 0.0196f * elv + 0.00002f * elv * elv) / (1.0f + 0.505f * elv + 0.0845f * elv * elv);
+	refrac = VF_SEL(elv > -0.56f, refrac, VCF(0.56));
+	elv = elv + refrac;
+	elv = VF_SEL(elv > 90.0f, VCF(90.0), elv);
+
+	*azm_deg = azm * (float)RAD_TO_DEG;
+	*zen_deg = 90.0f - elv;
+}
+
+
+/**
+ * @brief
+ *  Single precision batch solar position for one site from precomputed ephemeris terms
+ *
+ * @param [in] site pointer to solarpos_site_t struct
+ * @param [in] eph pointer to solarpos_ephem_f32_t holding at least first + n entries
+ * @param [in] first index of the first ephemeris entry to use
+ * @param [in] n number of samples
+ * @param [out] out pointer to solarpos_batch_f32_t with caller-owned arrays, indexed from 0
+ */
+static void SPB_FN(site_batch_f32)(const solarpos_site_t *site, const solarpos_ephem_f32_t *eph, size_t first, size_t n,
+	solarpos_batch_f32_t *out)
+{
+	vf azm, zen;
+	size_t i = 0;
+
+	for (; i + SPF_LANES <= n; i += SPF_LANES)
+	{
+		size_t j = first + i;
+		SPB_FN(site_lanes_f32)(VF_LOAD(&eph->gmst[j]), VF_LOAD(&eph->ra[j]), VF_LOAD(&eph->sin_dec[j]), VF_LOAD(&eph->cos_dec[j]),
+			site, &azm, &zen);
+		VF_STORE(&out->azimuth[i], azm);
+		VF_STORE(&out->zenith[i], zen);
+	}
+
+	if (i < n)
+	{
+		float g[SPF_LANES], r[SPF_LANES], s[SPF_LANES], c[SPF_LANES];
+		float a[SPF_LANES], z[SPF_LANES];
+		size_t k, rem = n - i;
+		for (k=0; k<SPF_LANES; k++)
+		{
+			size_t j = first + ((k < rem) ? i + k : n - 1);
+			g[k] = eph->gmst[j];
+			r[k] = eph->ra[j];
+			s[k] = eph->sin_dec[j];
+			c[k] = eph->cos_dec[j];
+		}
+		SPB_FN(site_lanes_f32)(VF_LOAD(g), VF_LOAD(r), VF_LOAD(s), VF_LOAD(c), site, &azm, &zen);
+		VF_STORE(a, azm);
+		VF_STORE(z, zen);
+		for (k=0; k<rem; k++)
+		{
+			out->azimuth[i + k] = a[k];
+			out->zenith[i + k] = z[k];
+		}
+	}
+}
+
+
+#undef SPF_PI
+#undef VCF
+#undef vf
+#undef vi
+#undef VF_SEL
+#undef VF_NEG_IF
+#undef VF_ROUND
+#undef VF_FMODP
+#undef VF_SINCOS
+#undef VF_ATAN
+#undef VF_ATAN2
+#undef VF_LOAD
+#undef VF_STORE
@@ -0,0 +1,253 @@
+/**
+ * @file	solarpos_step.c
+ *
+ * @brief
+ *   Minute by minute solar position stepper
+ *
+ *  Within a day the only fast changing term of solar_position_calc_r() is the
+ * hour angle, which advances by a nearly constant amount each minute. The
+ * stepper keeps the sine and cosine of the hour angle and advances them with
+ * a rotation,
+ *
+ *     cos(ha + d) = cos(ha) cos(d) - sin(ha) sin(d)
+ *     sin(ha + d) = sin(ha) cos(d) + cos(ha) sin(d)
+ *
+ * so a step costs a few multiplies instead of the fmod(), sin() and cos()
+ * calls of the ephemeris and hour angle. Every anchor_minutes the hour angle
+ * and declination are evaluated exactly (solar_ephemeris_batch()) at the
+ * anchor, half way to the next one and at the next one. Between anchors the
+ * hour angle and declination terms follow the quadratic through those three
+ * points: the declination terms by forward differences, and the hour angle by
+ * rotating the per-minute advance itself by a constant each minute. The
+ * declination has an annual curvature that a straight line between hourly
+ * anchors misses by ~1e-6 deg. Re-anchoring bounds the rounding drift of the
+ * recurrences and the error of the quadratic.
+ *
+ *  Elevation and azimuth are then worked out as in solar_position_calc_r(),
+ * with cos(elevation) from the square root identity, leaving one asin() and
+ * one acos() per minute.
+ *
+ *  tracker_bench measures the largest difference from solar_position_calc_r()
+ * over whole days at several anchor intervals, see check_solarpos_step().
+ * With SOLARPOS_STEP_ANCHOR it is ~1e-8 deg for zenith and ~5e-6 deg for
+ * azimuth (as an arc on the sky), the latter only with the sun within a degree
+ * or so of the zenith where the acos() azimuth of both is ill-conditioned.
+ * Anchoring every 15 minutes gives ~1e-9 and ~7e-8 deg, once a day ~6e-5 and
+ * ~4e-3 deg.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "angle_conversions.h"
+#include "solarpos_batch.h"
+#include "solarpos_step.h"
+
+#define MINUTES_PER_DAY		(24*60)
+
+
+/// exact hour angle and declination at a time, from the batch ephemeris
+static void exact_terms(const solarpos_site_t *site, double time, double *ha, double *sin_dec, double *cos_dec, double *dec_deg)
+{
+	double gmst, ra;
+	solarpos_ephem_t eph = {&gmst, &ra, sin_dec, cos_dec, dec_deg};
+	solar_ephemeris_batch(&time, 1, &eph);
+
+	double lmst = fmod(gmst + site->longitude / 15.0, 24.0);
+	if (lmst < 0.0)
+	{
+		lmst = lmst + 24.0;
+	}
+	*ha = deg2rad(lmst * 15.0) - ra;
+	if (*ha < -M_PI)
+	{
+		*ha = *ha + 2.0 * M_PI;
+	}
+	else if (*ha > M_PI)
+	{
+		*ha = *ha - 2.0 * M_PI;
+	}
+}
+
+
+/// first and second forward differences per minute of the quadratic through a, m at h minutes and b at 2h
+static void quadratic(double a, double m, double b, double h, double *d)
+{
+	double c = (a - 2.0 * m + b) / (2.0 * h * h);
+	d[0] = (m - a) / h - c * h + c;
+	d[1] = 2.0 * c;
+}
+
+
+/// the hour angle advance from ha to later, which is about expected, with the 2pi wrap undone
+static double advance(double ha, double later, double expected)
+{
+	double departure = later - ha - expected;
+	departure -= 2.0 * M_PI * floor((departure + M_PI) / (2.0 * M_PI));
+	return(expected + departure);
+}
+
+
+/// start a new interval at the exact terms computed for it, and look ahead to the next anchor
+static void anchor(solarpos_step_t *stepper)
+{
+	double ha = stepper->next_ha;
+	stepper->sin_ha = sin(ha);
+	stepper->cos_ha = cos(ha);
+	stepper->sin_dec = stepper->next_sin_dec;
+	stepper->cos_dec = stepper->next_cos_dec;
+	stepper->dec_deg = stepper->next_dec_deg;
+	stepper->steps = 0;
+
+	// exact terms half way and at the next anchor
+	double n = stepper->anchor_minutes;
+	double h = 0.5 * n;
+	double mid_ha, mid_sin_dec, mid_cos_dec, mid_dec_deg;
+	exact_terms(&stepper->site, stepper->start + (stepper->minute + h) / MINUTES_PER_DAY,
+		&mid_ha, &mid_sin_dec, &mid_cos_dec, &mid_dec_deg);
+	exact_terms(&stepper->site, stepper->start + (stepper->minute + n) / MINUTES_PER_DAY,
+		&stepper->next_ha, &stepper->next_sin_dec, &stepper->next_cos_dec, &stepper->next_dec_deg);
+
+	// the hour angle turns once per solar day, only the small departure from
+	// that rate comes from the wrapped difference of the exact values
+	double rate = 2.0 * M_PI / MINUTES_PER_DAY;
+	double d_ha[2];
+	quadratic(0.0, advance(ha, mid_ha, rate * h), advance(ha, stepper->next_ha, rate * n), h, d_ha);
+	stepper->sin_step = sin(d_ha[0]);
+	stepper->cos_step = cos(d_ha[0]);
+	stepper->sin_curve = sin(d_ha[1]);
+	stepper->cos_curve = cos(d_ha[1]);
+
+	quadratic(stepper->sin_dec, mid_sin_dec, stepper->next_sin_dec, h, stepper->d_sin_dec);
+	quadratic(stepper->cos_dec, mid_cos_dec, stepper->next_cos_dec, h, stepper->d_cos_dec);
+	quadratic(stepper->dec_deg, mid_dec_deg, stepper->next_dec_deg, h, stepper->d_dec_deg);
+}
+
+
+/**
+ * @brief
+ *  Start stepping solar position at a site and time
+ *
+ * @param [out] stepper pointer to solarpos_step_t struct
+ * @param [in] start pointer to solarpos_inputs_t struct with the site and the first minute
+ * @param [in] anchor_minutes minutes between exact re-anchors, 1 to SOLARPOS_STEP_MAX_ANCHOR,
+ *  0 for SOLARPOS_STEP_ANCHOR
+ */
+void solarpos_step_init(solarpos_step_t *stepper, const solarpos_inputs_t *start, uint32_t anchor_minutes)
+{
+	memset(stepper, 0, sizeof(*stepper));
+	stepper->site.latitude = start->latitude;
+	stepper->site.longitude = start->longitude;
+	stepper->site.timezone = start->timezone;
+
+	double latrad = deg2rad(start->latitude);
+	stepper->sin_lat = sin(latrad);
+	stepper->cos_lat = cos(latrad);
+
+	if (anchor_minutes == 0)
+	{
+		anchor_minutes = SOLARPOS_STEP_ANCHOR;
+	}
+	else if (anchor_minutes > SOLARPOS_STEP_MAX_ANCHOR)
+	{
+		anchor_minutes = SOLARPOS_STEP_MAX_ANCHOR;
+	}
+	stepper->anchor_minutes = anchor_minutes;
+
+	stepper->start = solarpos_time(start);
+	exact_terms(&stepper->site, stepper->start, &stepper->next_ha, &stepper->next_sin_dec, &stepper->next_cos_dec, &stepper->next_dec_deg);
+	anchor(stepper);
+}
+
+
+/**
+ * @brief
+ *  Solar position for the current minute, then advance one minute
+ *
+ *  Sets azimuth, zenith, elevation and declination as solar_position_calc_r()
+ * does. The daily terms (sunrise, sunset, eccentricity, true solar time) are
+ * not stepped and are left at 0, solar_position_day() has them per day.
+ *
+ * @param [in,out] stepper pointer to solarpos_step_t struct from solarpos_step_init()
+ * @param [out] solarpos pointer to solarpos_t struct to fill
+ */
+void solarpos_step(solarpos_step_t *stepper, solarpos_t *solarpos)
+{
+	memset(solarpos, 0, sizeof(*solarpos));
+
+	double arg = stepper->sin_dec * stepper->sin_lat + stepper->cos_dec * stepper->cos_lat * stepper->cos_ha;
+	if (arg > 1.0)
+	{
+		arg = 1.0;
+	}
+	else if (arg < -1.0)
+	{
+		arg = -1.0;
+	}
+	double elv = asin(arg);
+	double cos_elv = sqrt((1.0 - arg) * (1.0 + arg));
+
+	double azm;
+	if (cos_elv == 0.0)
+	{
+		azm = M_PI;		// Assign azimuth = 180 deg if elv = 90 or -90
+	}
+	else
+	{
+		// For solar azimuth in radians per Iqbal
+		arg = (arg * stepper->sin_lat - stepper->sin_dec) / (cos_elv * stepper->cos_lat);
+		if (arg > 1.0)
+		{
+			azm = 0.0;
+		}
+		else if (arg < -1.0)
+		{
+			azm = M_PI;
+		}
+		else
+		{
+			azm = acos(arg);
+		}
+
+		// hour angle in [-pi, 0] is morning
+		azm = (stepper->sin_ha <= 0.0) ? M_PI - azm : M_PI + azm;
+	}
+
+	// atmospheric refraction correction in degrees
+	elv = rad2deg(elv);
+	double refrac = 0.56;
+	if (elv > -0.56)
+	{
+		refrac = 3.51561 * (0.1594 + 0.0196 * elv + 0.00002 * elv * elv) / (1.0 + 0.505 * elv + 0.0845 * elv * elv);
+	}
+	elv = (elv + refrac > 90.0) ? 90.0 : elv + refrac;
+
+	solarpos->azimuth = rad2deg(azm);
+	solarpos->elevation = elv;
+	solarpos->zenith = 90.0 - elv;
+	solarpos->declination = stepper->dec_deg;
+
+	// advance the hour angle by one rotation step, then the step by its own
+	// rotation, and the declination terms by their forward differences
+	stepper->minute++;
+	if (++stepper->steps == stepper->anchor_minutes)
+	{
+		anchor(stepper);
+	}
+	else
+	{
+		double cos_ha = stepper->cos_ha * stepper->cos_step - stepper->sin_ha * stepper->sin_step;
+		stepper->sin_ha = stepper->sin_ha * stepper->cos_step + stepper->cos_ha * stepper->sin_step;
+		stepper->cos_ha = cos_ha;
+		double cos_step = stepper->cos_step * stepper->cos_curve - stepper->sin_step * stepper->sin_curve;
+		stepper->sin_step = stepper->sin_step * stepper->cos_curve + stepper->cos_step * stepper->sin_curve;
+		stepper->cos_step = cos_step;
+		stepper->sin_dec += stepper->d_sin_dec[0];
+		stepper->d_sin_dec[0] += stepper->d_sin_dec[1];
+		stepper->cos_dec += stepper->d_cos_dec[0];
+		stepper->d_cos_dec[0] += stepper->d_cos_dec[1];
+		stepper->dec_deg += stepper->d_dec_deg[0];
+		stepper->d_dec_deg[0] += stepper->d_dec_deg[1];
+	}
+}
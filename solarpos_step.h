@@ -0,0 +1,56 @@
+/**
+ * @file	solarpos_step.h
+ *
+ * @brief
+ *   Header for the minute by minute solar position stepper
+ */
+
+#ifndef SOLARPOS_STEP_H
+#define SOLARPOS_STEP_H
+
+#include <inttypes.h>
+#include "solarpos.h"
+
+#define SOLARPOS_STEP_ANCHOR		60		// default minutes between exact re-anchors
+#define SOLARPOS_STEP_MAX_ANCHOR	1440	// longest anchor interval supported
+
+/// Largest difference in degrees from solar_position_calc_r() over a day with SOLARPOS_STEP_ANCHOR
+#define SOLARPOS_STEP_TOLERANCE		1e-5
+
+/// solar position at one site advanced one minute at a time, see solarpos_step_init()
+typedef struct {
+	solarpos_site_t site;
+	double sin_lat;
+	double cos_lat;
+	double start;				/// solarpos_time() of the first minute
+	uint64_t minute;			/// minutes stepped since start
+	uint32_t anchor_minutes;	/// minutes between re-anchors
+	uint32_t steps;				/// minutes since the last anchor
+
+	// current minute
+	double sin_ha;				/// sine of the hour angle
+	double cos_ha;				/// cosine of the hour angle
+	double sin_dec;				/// sine of the declination
+	double cos_dec;				/// cosine of the declination
+	double dec_deg;				/// declination in degrees
+
+	// per minute until the next anchor, quadratic in time
+	double sin_step;			/// sine of the hour angle advance to the next minute
+	double cos_step;			/// cosine of the hour angle advance to the next minute
+	double sin_curve;			/// sine of the change in the advance per minute
+	double cos_curve;			/// cosine of the change in the advance per minute
+	double d_sin_dec[2];		/// first and second differences
+	double d_cos_dec[2];
+	double d_dec_deg[2];
+
+	// exact terms at the next anchor
+	double next_ha;				/// hour angle in radians
+	double next_sin_dec;
+	double next_cos_dec;
+	double next_dec_deg;
+} solarpos_step_t;
+
+void solarpos_step_init(solarpos_step_t *stepper, const solarpos_inputs_t *start, uint32_t anchor_minutes);
+void solarpos_step(solarpos_step_t *stepper, solarpos_t *solarpos);
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @file	sweep.c
+ *
+ * @brief
+ *   Tracker configuration parameter sweep
+ *
+ *  A sweep is given as a list of tracker_t fields and ranges, e.g.
+ * "gcr=0.30:0.50:0.05,rom=45:60:5,beta=0". Fields that are not listed keep
+ * their default value. The sun vectors of a site are computed once and every
+ * configuration in the grid is evaluated against them, so the solar position
+ * cost is paid once no matter how many configurations there are.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "sweep.h"
+
+#define SWEEP_BLOCK		1440	// sun vectors per block, one day of minutes fits in L1/L2
+
+
+/// number of values in an inclusive range
+static size_t range_count(const sweep_range_t *range)
+{
+	if (range->step <= 0.0 || range->max <= range->min)
+	{
+		return(1);
+	}
+	return((size_t)floor((range->max - range->min) / range->step + 1e-9) + 1);
+}
+
+
+static double range_value(const sweep_range_t *range, size_t k)
+{
+	return(range->min + k * range->step);
+}
+
+
+/**
+ * @brief
+ *  Parse a sweep description
+ *
+ *  The text is a comma separated list of field=value or field=min:max:step
+ * with fields gcr, rom, stow, alpha and beta.
+ *
+ * @param [in] text sweep description
+ * @param [in] defaults pointer to tracker_t struct with the values of fields that are not listed
+ * @param [out] spec pointer to sweep_spec_t struct
+ *
+ * @return 0 on success, -1 on a syntax error
+ */
+int sweep_parse(const char *text, const tracker_t *defaults, sweep_spec_t *spec)
+{
+	spec->gcr        = (sweep_range_t){defaults->gcr, defaults->gcr, 0};
+	spec->rom        = (sweep_range_t){defaults->rom, defaults->rom, 0};
+	spec->night_stow = (sweep_range_t){defaults->night_stow, defaults->night_stow, 0};
+	spec->alpha      = (sweep_range_t){defaults->alpha, defaults->alpha, 0};
+	spec->beta       = (sweep_range_t){defaults->beta, defaults->beta, 0};
+
+	while (*text != '\0')
+	{
+		char field[16];
+		sweep_range_t range = {0, 0, 0};
+		int used = 0;
+
+		if (sscanf(text, "%15[a-z]=%lf:%lf:%lf%n", field, &range.min, &range.max, &range.step, &used) == 4)
+		{
+			if (range.step <= 0.0 || range.max < range.min)
+			{
+				return(-1);
+			}
+		}
+		else if (sscanf(text, "%15[a-z]=%lf%n", field, &range.min, &used) == 2)
+		{
+			range.max = range.min;
+		}
+		else
+		{
+			return(-1);
+		}
+
+		if (strcmp(field, "gcr") == 0)			spec->gcr = range;
+		else if (strcmp(field, "rom") == 0)		spec->rom = range;
+		else if (strcmp(field, "stow") == 0)	spec->night_stow = range;
+		else if (strcmp(field, "alpha") == 0)	spec->alpha = range;
+		else if (strcmp(field, "beta") == 0)	spec->beta = range;
+		else									return(-1);
+
+		text += used;
+		if (*text == ',')
+		{
+			text++;
+		}
+		else if (*text != '\0')
+		{
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Expand a sweep into the list of tracker configurations
+ *
+ * @param [in] spec pointer to sweep_spec_t struct
+ * @param [out] configs set to a malloc'd array of tracker_t, free() when done
+ *
+ * @return number of configurations
+ */
+size_t sweep_expand(const sweep_spec_t *spec, tracker_t **configs)
+{
+	size_t n_gcr = range_count(&spec->gcr);
+	size_t n_rom = range_count(&spec->rom);
+	size_t n_stow = range_count(&spec->night_stow);
+	size_t n_alpha = range_count(&spec->alpha);
+	size_t n_beta = range_count(&spec->beta);
+	size_t n = n_gcr * n_rom * n_stow * n_alpha * n_beta;
+
+	*configs = malloc(n * sizeof(tracker_t));
+	assert(*configs != NULL);
+
+	size_t a, b, g, r, s, k = 0;
+	for (a=0; a<n_alpha; a++)
+	for (b=0; b<n_beta; b++)
+	for (g=0; g<n_gcr; g++)
+	for (r=0; r<n_rom; r++)
+	for (s=0; s<n_stow; s++)
+	{
+		tracker_t *config = &(*configs)[k++];
+		config->alpha = range_value(&spec->alpha, a);
+		config->beta = range_value(&spec->beta, b);
+		config->gamma = 0;
+		config->gcr = range_value(&spec->gcr, g);
+		config->rom = range_value(&spec->rom, r);
+		config->night_stow = range_value(&spec->night_stow, s);
+	}
+
+	return(n);
+}
+
+
+/**
+ * @brief
+ *  Add the backtracked angle of every configuration at every sun position to its histogram
+ *
+ *  The samples are walked one block at a time and every configuration is run
+ * over the block before moving on, so the block of sun vectors stays in
+ * cache while the configurations stream past it. Each configuration is
+ * resolved to its tracker_kernel_t once, up front.
+ *
+ * @param [in] sun array of num_samples sun vectors
+ * @param [in] num_samples number of sun vectors
+ * @param [in] configs array of num_configs tracker configurations
+ * @param [in,out] hists array of num_configs histograms, one per configuration
+ * @param [in] num_configs number of configurations
+ */
+void sweep_evaluate(const sun_vector_t *sun, size_t num_samples,
+	const tracker_t *configs, angle_histogram_t *hists, size_t num_configs)
+{
+	size_t block, c, k;
+
+	tracker_kernel_t *kernels = malloc(num_configs * sizeof(tracker_kernel_t));
+	assert(kernels != NULL || num_configs == 0);
+	for (c=0; c<num_configs; c++)
+	{
+		tracker_kernel_init(&kernels[c], &configs[c]);
+	}
+
+	for (block=0; block<num_samples; block+=SWEEP_BLOCK)
+	{
+		size_t end = (block + SWEEP_BLOCK < num_samples) ? block + SWEEP_BLOCK : num_samples;
+
+		for (c=0; c<num_configs; c++)
+		{
+			const tracker_kernel_t *kernel = &kernels[c];
+			angle_histogram_t *hist = &hists[c];
+
+			for (k=block; k<end; k++)
+			{
+				double angle_no_sa = kernel->angle_vector(kernel, &sun[k]);
+				angle_histogram_add(hist, backtrack_angle(&kernel->backtrack, angle_no_sa));
+			}
+		}
+	}
+
+	free(kernels);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file	sweep.h
+ *
+ * @brief
+ *   Header for the tracker configuration parameter sweep
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stddef.h>
+#include "tracking_algorithm.h"
+#include "histogram.h"
+
+/// inclusive range of values min, min + step, ... max
+typedef struct
+{
+	double min;
+	double max;
+	double step;
+} sweep_range_t;
+
+/// one range per swept tracker_t field
+typedef struct
+{
+	sweep_range_t gcr;
+	sweep_range_t rom;
+	sweep_range_t night_stow;
+	sweep_range_t alpha;
+	sweep_range_t beta;
+} sweep_spec_t;
+
+int sweep_parse(const char *text, const tracker_t *defaults, sweep_spec_t *spec);
+size_t sweep_expand(const sweep_spec_t *spec, tracker_t **configs);
+void sweep_evaluate(const sun_vector_t *sun, size_t num_samples,
+	const tracker_t *configs, angle_histogram_t *hists, size_t num_configs);
+
+#endif
@@ -0,0 +1,448 @@
+/**
+ * @file	timeseries.c
+ *
+ * @brief
+ *   Timestamps of a weather file time series, read in batches from a memory mapped CSV
+ *
+ *  The file is mapped read-only and never copied: each row's timestamp is
+ * parsed where it lies and handed back as a pointer and length into the map,
+ * so the caller can write it out verbatim. Pages behind the previous batch
+ * are given back with madvise(MADV_DONTNEED) as the reader moves on, which
+ * keeps the resident memory to about two batches of rows whatever the size
+ * of the file.
+ *
+ *  The timestamp column is the first field of the first line within
+ * TIMESERIES_MAX_HEADER lines that parses as a timestamp, so preambles such
+ * as the TMY3 site line and column headers are skipped. Two forms are read:
+ *
+ *     ISO 8601    2017-06-21T13:30[:00[.000]][Z|+HH[:MM]]  ('T' or ' ')
+ *     TMY3        06/21/2017,13:30[:00] or "06/21/2017 13:30"  (24:00 allowed)
+ *
+ * either may be in double quotes. Dates must exist, 29 Feb only in leap years. Times without a zone are local standard
+ * time at the site's timezone, as everywhere else in tracker_calc.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "timeseries.h"
+#include "trackerangle.h"
+
+
+/// days from 1 Jan 1970 of a proleptic Gregorian date, valid for any year
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+	y -= (m <= 2);
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	unsigned yoe = (unsigned)(y - era * 400);
+	unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return(era * 146097 + (int64_t)doe - 719468);
+}
+
+
+/// days in a month of a proleptic Gregorian year
+static int32_t days_in_month(int32_t year, int32_t month)
+{
+	static const uint8_t month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	return(month_days[month - 1] + (month == 2 && leap));
+}
+
+
+/// 1 to max decimal digits at p as a number, advances p, -1 if none
+static int32_t read_digits(const char **p, const char *end, int min, int max)
+{
+	int32_t value = 0;
+	int n = 0;
+	while (*p < end && n < max && **p >= '0' && **p <= '9')
+	{
+		value = value * 10 + (**p - '0');
+		(*p)++;
+		n++;
+	}
+	return((n >= min) ? value : -1);
+}
+
+
+/// HH:MM[:SS[.f]] at p in seconds from midnight, advances p, -1 if not a time; hour 24 only as 24:00
+static double read_time_of_day(const char **p, const char *end, int max_hour)
+{
+	int32_t hour = read_digits(p, end, 1, 2);
+	if (hour < 0 || hour > max_hour || *p >= end || **p != ':')
+	{
+		return(-1.0);
+	}
+	(*p)++;
+	int32_t minute = read_digits(p, end, 2, 2);
+	if (minute < 0 || minute > 59 || (hour == 24 && (minute != 0 || (*p < end && **p == ':'))))
+	{
+		return(-1.0);
+	}
+	double seconds = 3600.0 * hour + 60.0 * minute;
+	if (*p < end && **p == ':')
+	{
+		(*p)++;
+		int32_t second = read_digits(p, end, 2, 2);
+		if (second < 0 || second > 60)
+		{
+			return(-1.0);
+		}
+		seconds += second;
+		if (*p < end && **p == '.')
+		{
+			double scale = 0.1;
+			(*p)++;
+			while (*p < end && **p >= '0' && **p <= '9')
+			{
+				seconds += scale * (**p - '0');
+				scale *= 0.1;
+				(*p)++;
+			}
+		}
+	}
+	return(seconds);
+}
+
+
+/// at the end of a field: end of line, a comma or trailing blanks
+static int at_field_end(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+	{
+		p++;
+	}
+	return(p == end || *p == ',');
+}
+
+
+/**
+ * @brief
+ *  Parse the timestamp at the start of a field
+ *
+ * @param [in] text start of the field
+ * @param [in] end end of the line, text is not read beyond it
+ * @param [in] timezone hours, for a timestamp without a zone
+ * @param [out] time days from noon 1 Jan 2000 UT, see trackerangle_time_unix()
+ * @param [out] field_end end of the timestamp text, after the time field of a TMY3 date
+ *
+ * @return 0 on success, -1 if the field is not a timestamp
+ */
+int timeseries_parse(const char *text, const char *end, int8_t timezone, double *time, const char **field_end)
+{
+	const char *p = text;
+	int quoted = (p < end && *p == '"');
+	p += quoted;
+
+	int32_t year, month, day;
+	double seconds;
+	double offset = 3600.0 * timezone;
+	const char *start = p;
+	int32_t first = read_digits(&p, end, 1, 4);
+	if (first >= 0 && p - start == 4 && p < end && *p == '-')
+	{
+		// ISO 8601 date, then 'T' or a blank and the time
+		year = first;
+		p++;
+		month = read_digits(&p, end, 2, 2);
+		if (month < 0 || p >= end || *p != '-')
+		{
+			return(-1);
+		}
+		p++;
+		day = read_digits(&p, end, 2, 2);
+		if (day < 0 || p >= end || (*p != 'T' && *p != ' '))
+		{
+			return(-1);
+		}
+		p++;
+		seconds = read_time_of_day(&p, end, 23);
+		if (seconds < 0.0)
+		{
+			return(-1);
+		}
+		if (p < end && *p == 'Z')
+		{
+			offset = 0.0;
+			p++;
+		}
+		else if (p < end && (*p == '+' || *p == '-'))
+		{
+			double sign = (*p == '-') ? -1.0 : 1.0;
+			p++;
+			int32_t hours = read_digits(&p, end, 2, 2);
+			int32_t minutes = 0;
+			if (p < end && *p == ':')
+			{
+				p++;
+			}
+			if (p < end && *p >= '0' && *p <= '9')
+			{
+				minutes = read_digits(&p, end, 2, 2);
+			}
+			if (hours < 0 || hours > 14 || minutes < 0 || minutes > 59)
+			{
+				return(-1);
+			}
+			offset = sign * (3600.0 * hours + 60.0 * minutes);
+		}
+	}
+	else if (first >= 0 && p - start <= 2 && p < end && *p == '/')
+	{
+		// TMY3 MM/DD/YYYY, the time after a blank or in the next field
+		month = first;
+		p++;
+		day = read_digits(&p, end, 1, 2);
+		if (day < 0 || p >= end || *p != '/')
+		{
+			return(-1);
+		}
+		p++;
+		year = read_digits(&p, end, 4, 4);
+		if (year < 0 || p >= end)
+		{
+			return(-1);
+		}
+		if (*p == ' ')
+		{
+			p++;
+		}
+		else
+		{
+			if (quoted)
+			{
+				if (*p != '"')
+				{
+					return(-1);
+				}
+				p++;
+			}
+			if (p >= end || *p != ',')
+			{
+				return(-1);
+			}
+			p++;
+			quoted = (p < end && *p == '"');
+			p += quoted;
+		}
+		seconds = read_time_of_day(&p, end, 24);
+		if (seconds < 0.0)
+		{
+			return(-1);
+		}
+	}
+	else
+	{
+		return(-1);
+	}
+	if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month))
+	{
+		return(-1);
+	}
+
+	if (quoted)
+	{
+		if (p >= end || *p != '"')
+		{
+			return(-1);
+		}
+		p++;
+	}
+	if (!at_field_end(p, end) || p - text > TIMESERIES_MAX_FIELD)
+	{
+		return(-1);
+	}
+
+	double unix_seconds = 86400.0 * days_from_civil(year, month, day) + seconds - offset;
+	*time = trackerangle_time_unix(unix_seconds);
+	*field_end = p;
+	return(0);
+}
+
+
+/// start of field column of a line, NULL if the line has fewer fields
+static const char *find_field(const char *p, const char *end, uint32_t column)
+{
+	int quoted = 0;
+	while (column > 0)
+	{
+		if (p >= end)
+		{
+			return(NULL);
+		}
+		if (*p == '"')
+		{
+			quoted = !quoted;
+		}
+		else if (*p == ',' && !quoted)
+		{
+			column--;
+		}
+		p++;
+	}
+	return(p);
+}
+
+
+/// end of the line at pos without its '\r', and the offset of the next line
+static const char *line_end(const timeseries_t *series, size_t pos, size_t *next)
+{
+	const char *line = series->map + pos;
+	const char *nl = memchr(line, '\n', series->size - pos);
+	const char *end = (nl != NULL) ? nl : series->map + series->size;
+	*next = (nl != NULL) ? (size_t)(nl - series->map) + 1 : series->size;
+	if (end > line && end[-1] == '\r')
+	{
+		end--;
+	}
+	return(end);
+}
+
+
+/**
+ * @brief
+ *  Map a CSV file and find its timestamp column
+ *
+ * @param [out] series pointer to timeseries_t struct
+ * @param [in] path file name
+ * @param [in] timezone hours, for timestamps without a zone
+ *
+ * @return 0 on success, -1 if the file can't be read, -2 if there is no
+ *  timestamp in the first TIMESERIES_MAX_HEADER lines
+ */
+int timeseries_open(timeseries_t *series, const char *path, int8_t timezone)
+{
+	memset(series, 0, sizeof(*series));
+	series->timezone = timezone;
+	series->fd = open(path, O_RDONLY);
+	if (series->fd < 0)
+	{
+		return(-1);
+	}
+	struct stat st;
+	if (fstat(series->fd, &st) != 0)
+	{
+		close(series->fd);
+		return(-1);
+	}
+	if (st.st_size == 0)
+	{
+		close(series->fd);
+		return(-2);
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, series->fd, 0);
+	if (map == MAP_FAILED)
+	{
+		close(series->fd);
+		return(-1);
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	series->map = map;
+	series->size = st.st_size;
+
+	// first field that parses, in the first line that has one
+	size_t pos = 0, next;
+	uint32_t lines;
+	for (lines=0; lines<TIMESERIES_MAX_HEADER && pos < series->size; lines++)
+	{
+		const char *end = line_end(series, pos, &next);
+		const char *field = series->map + pos;
+		uint32_t column = 0;
+		while (field != NULL)
+		{
+			double time;
+			const char *field_end;
+			if (timeseries_parse(field, end, timezone, &time, &field_end) == 0)
+			{
+				series->column = column;
+				series->pos = series->batch = pos;
+				series->line = lines;
+				return(0);
+			}
+			field = find_field(field, end, 1);
+			column++;
+		}
+		pos = next;
+	}
+	timeseries_close(series);
+	return(-2);
+}
+
+
+/**
+ * @brief
+ *  Read the timestamps of the next rows
+ *
+ *  The fields of the previous call stay valid until this one returns, those
+ * of earlier calls do not. Blank lines are skipped.
+ *
+ * @param [in,out] series pointer to timeseries_t struct
+ * @param [out] fields max timestamp texts in the file, may be NULL
+ * @param [out] time max times in days from noon 1 Jan 2000 UT
+ * @param [in] max rows to read at most
+ * @param [out] count rows read, 0 at the end of the file
+ *
+ * @return 0 on success, -1 if a row has no timestamp, its line number is in series->line
+ */
+int timeseries_read(timeseries_t *series, timeseries_field_t *fields, double *time, size_t max, size_t *count)
+{
+	// the rows before the previous batch are done with
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t keep = series->batch & ~(page - 1);
+	if (keep > series->released)
+	{
+		madvise((void *)(series->map + series->released), keep - series->released, MADV_DONTNEED);
+		series->released = keep;
+	}
+	series->batch = series->pos;
+
+	size_t n = 0;
+	while (n < max && series->pos < series->size)
+	{
+		size_t next;
+		const char *line = series->map + series->pos;
+		const char *end = line_end(series, series->pos, &next);
+		series->pos = next;
+		series->line++;
+		if (end == line)
+		{
+			continue;
+		}
+		const char *field = find_field(line, end, series->column);
+		const char *field_end;
+		if (field == NULL || timeseries_parse(field, end, series->timezone, &time[n], &field_end) != 0)
+		{
+			*count = n;
+			return(-1);
+		}
+		if (fields != NULL)
+		{
+			fields[n].text = field;
+			fields[n].len = (uint32_t)(field_end - field);
+		}
+		n++;
+	}
+	*count = n;
+	return(0);
+}
+
+
+/**
+ * @brief
+ *  Unmap a file opened with timeseries_open()
+ *
+ * @param [in,out] series pointer to timeseries_t struct
+ */
+void timeseries_close(timeseries_t *series)
+{
+	if (series->map != NULL)
+	{
+		munmap((void *)series->map, series->size);
+		close(series->fd);
+	}
+	memset(series, 0, sizeof(*series));
+}
@@ -0,0 +1,42 @@
+/**
+ * @file	timeseries.h
+ *
+ * @brief
+ *   Header for the memory mapped timestamp reader for weather file time series
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define TIMESERIES_BATCH		4096	// rows per timeseries_read() in tracker_calc --input
+#define TIMESERIES_MAX_HEADER	16		// lines searched for the first timestamp
+#define TIMESERIES_MAX_FIELD	64		// longest timestamp text, both fields of a TMY3 date and time
+
+/// timestamp text of one row, points into the mapped file
+typedef struct {
+	const char *text;
+	uint32_t len;
+} timeseries_field_t;
+
+/// CSV file being read in batches of rows, see timeseries_open()
+typedef struct {
+	int fd;
+	const char *map;			/// whole file, read only
+	size_t size;
+	size_t pos;					/// offset of the next line
+	size_t batch;				/// offset of the first line of the last batch, its fields stay mapped
+	size_t released;			/// bytes before this are given back to the kernel
+	uint64_t line;				/// line number of the last line read
+	uint32_t column;			/// field the timestamp starts in
+	int8_t timezone;			/// hours, for timestamps without a zone of their own
+} timeseries_t;
+
+int timeseries_parse(const char *text, const char *end, int8_t timezone, double *time, const char **field_end);
+int timeseries_open(timeseries_t *series, const char *path, int8_t timezone);
+int timeseries_read(timeseries_t *series, timeseries_field_t *fields, double *time, size_t max, size_t *count);
+void timeseries_close(timeseries_t *series);
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file	trackerangle.c
+ *
+ * @brief
+ *   Batch tracker angles for libtrackerangle, see trackerangle.h
+ *
+ *  Times are taken TRACKERANGLE_CHUNK at a time through the batch solar
+ * position kernels into stack buffers, then each sample goes through the
+ * configuration's tracker_angle() kernel and backtracking table, as
+ * tracker_calc does for every minute. Samples with the sun below the horizon
+ * get the backtracked night stow angle.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "trackerangle.h"
+
+
+/**
+ * @brief
+ *  Resolve a tracker design at a site for the batch functions
+ *
+ * @param [out] config pointer to trackerangle_t struct, shareable between threads once filled
+ * @param [in] tracker pointer to tracker_t struct, not referenced after the call
+ * @param [in] site pointer to solarpos_site_t struct, not referenced after the call
+ */
+void trackerangle_init(trackerangle_t *config, const tracker_t *tracker, const solarpos_site_t *site)
+{
+	memset(config, 0, sizeof(*config));
+	tracker_kernel_init(&config->kernel, tracker);
+	config->site = *site;
+	config->stow_angle = backtrack_angle(&config->kernel.backtrack, config->kernel.night_stow);
+}
+
+
+/**
+ * @brief
+ *  Tracker angle with shade avoidance for each of an array of solar positions
+ *
+ * @param [in] config pointer to trackerangle_t struct from trackerangle_init()
+ * @param [in] azimuth n sun azimuths in degrees, measured east from north
+ * @param [in] zenith n sun zeniths in degrees
+ * @param [in] n number of samples
+ * @param [out] angle n tracker angles in degrees, may not overlap the inputs
+ */
+void trackerangle_batch_positions(const trackerangle_t *config, const double *azimuth, const double *zenith, size_t n, double *angle)
+{
+	const tracker_kernel_t *kernel = &config->kernel;
+	size_t i;
+
+	for (i=0; i<n; i++)
+	{
+		if (zenith[i] >= 90.0)
+		{
+			angle[i] = config->stow_angle;
+			continue;
+		}
+		solarpos_t solarpos = {0};
+		solarpos.azimuth = azimuth[i];
+		solarpos.zenith = zenith[i];
+		angle[i] = backtrack_angle(&kernel->backtrack, kernel->angle(kernel, &solarpos));
+	}
+}
+
+
+/**
+ * @brief
+ *  Tracker angle with shade avoidance at the configuration's site for each of an array of times
+ *
+ * @param [in] config pointer to trackerangle_t struct from trackerangle_init()
+ * @param [in] time n times in days from noon 1 Jan 2000 UT, see solarpos_time() and trackerangle_time_unix()
+ * @param [in] n number of samples
+ * @param [out] angle n tracker angles in degrees, may be the time array itself
+ */
+void trackerangle_batch(const trackerangle_t *config, const double *time, size_t n, double *angle)
+{
+	double azimuth[TRACKERANGLE_CHUNK], zenith[TRACKERANGLE_CHUNK];
+	double elevation[TRACKERANGLE_CHUNK], declination[TRACKERANGLE_CHUNK];
+	solarpos_batch_t out = {azimuth, zenith, elevation, declination};
+	size_t first;
+
+	for (first=0; first<n; first+=TRACKERANGLE_CHUNK)
+	{
+		size_t count = (n - first < TRACKERANGLE_CHUNK) ? n - first : TRACKERANGLE_CHUNK;
+		solar_position_batch(&config->site, &time[first], count, &out);
+		trackerangle_batch_positions(config, azimuth, zenith, count, &angle[first]);
+	}
+}
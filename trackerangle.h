@@ -0,0 +1,60 @@
+/**
+ * @file	trackerangle.h
+ *
+ * @brief
+ *   Public header of libtrackerangle, tracker angles for arrays of times
+ *
+ *  A trackerangle_t holds one tracker design at one site. It is filled once
+ * by trackerangle_init() and only read afterwards, so any number of threads
+ * may share one and call the batch functions on it at the same time without
+ * locking. The batch functions use no heap memory and keep no state between
+ * calls; everything they need is in their arguments.
+ *
+ *  Link with -ltrackerangle -lm. The solar position and tracking headers
+ * included here (solarpos.h, solarpos_batch.h, tracking_algorithm.h) are part
+ * of the library too. solarpos_batch_set_isa() is the one process wide
+ * setting, meant to be called once at start-up if at all.
+ */
+
+#ifndef TRACKERANGLE_H
+#define TRACKERANGLE_H
+
+#include <stddef.h>
+#include "solarpos.h"
+#include "solarpos_batch.h"
+#include "tracking_algorithm.h"
+
+#define TRACKERANGLE_CHUNK	256		// samples per solar position batch, on the stack
+
+/// largest difference in degrees from solar_position_calc_r(), tracker_angle() and shade_avoidance_angle(), as SOLARPOS_BATCH_TOLERANCE
+#define TRACKERANGLE_TOLERANCE	1e-6
+
+/// days from noon 1 Jan 2000 UT at 00:00 1 Jan 1970 UT, see trackerangle_time_unix()
+#define TRACKERANGLE_UNIX_EPOCH	(-10957.5)
+
+/// one tracker design at one site, read-only after trackerangle_init()
+typedef struct {
+	tracker_kernel_t kernel;		/// tracker resolved by tracker_kernel_init()
+	solarpos_site_t site;
+	double stow_angle;				/// night stow angle with shade avoidance in degrees
+} trackerangle_t;
+
+void trackerangle_init(trackerangle_t *config, const tracker_t *tracker, const solarpos_site_t *site);
+void trackerangle_batch(const trackerangle_t *config, const double *time, size_t n, double *angle);
+void trackerangle_batch_positions(const trackerangle_t *config, const double *azimuth, const double *zenith, size_t n, double *angle);
+
+
+/**
+ * @brief
+ *  Time argument of trackerangle_batch() for a Unix time
+ *
+ * @param [in] unix_seconds seconds since 00:00 1 Jan 1970 UT
+ *
+ * @return days from noon 1 Jan 2000 UT, as solarpos_time()
+ */
+static inline double trackerangle_time_unix(double unix_seconds)
+{
+	return(unix_seconds / 86400.0 + TRACKERANGLE_UNIX_EPOCH);
+}
+
+#endif
@@ -21,12 +21,12 @@
  * @brief
  *  Find angle of incidence for single axis tracker with the specified roll, pitch and yaw angles
  * 
- * @param [in] tracker pointer to tracker_t struct
+ * @param [in] tracker pointer to tracker_t struct, gamma holds the roll angle
  * @param [in] solarpos pointer to solarpos_t struct
  * 
  * @return ia Angle of incidence in degrees between sun and tracker 
 */
-double tracker_incident(tracker_t *tracker, solarpos_t *solarpos)
+double tracker_incident(const tracker_t *tracker, const solarpos_t *solarpos)
 {
 	// convert angles to radians 
 	double gamma = deg2rad(tracker->gamma);
@@ -61,13 +61,17 @@ double tracker_incident(tracker_t *tracker, solarpos_t *solarpos)
  * @brief
  *  Find 3DOF single axis tracker angle, Jason's method.
  * 
+ *  The tracker struct is not modified, so one configuration can be shared by
+ * many threads. Callers that need tracker_incident() at this angle should copy
+ * the result into their own tracker_t's gamma.
+ * 
  * @param [in] solarpos pointer to solarpos_t struct
  * @param [in] tracker pointer to tracker_t struct
  * 
  * @return Ideal tracker angle in degrees without shade avoidance
  */
 
-double tracker_angle(solarpos_t *solarpos, tracker_t *tracker) 
+double tracker_angle(const solarpos_t *solarpos, const tracker_t *tracker) 
 {
 	// return stow angle when sun is below the horizon
 	if (solarpos->zenith >= 90.0) 
@@ -96,7 +100,6 @@ double tracker_angle(solarpos_t *solarpos, tracker_t *tracker)
 		calculated_angle = -calculated_angle;
 	}
 	
-	tracker->gamma = rad2deg(calculated_angle);
 	return(rad2deg(calculated_angle));
 }
 
@@ -105,6 +108,250 @@ double tracker_angle(solarpos_t *solarpos, tracker_t *tracker)
 
 
 
+/**
+ * @brief
+ *  Sun position as a unit vector, for evaluating many trackers against one sun position
+ * 
+ * @param [in] solarpos pointer to solarpos_t struct
+ * @param [out] sun pointer to sun_vector_t struct
+ */
+void sun_vector(const solarpos_t *solarpos, sun_vector_t *sun)
+{
+	double theta = deg2rad(360 - solarpos->azimuth);
+	double phi = deg2rad(solarpos->zenith);
+
+	sun->x = cos(theta) * sin(phi);
+	sun->y = sin(theta) * sin(phi);
+	sun->z = cos(phi);
+	
+	// cos() of 90 deg in radians is not exactly zero, keep the night test identical to tracker_angle()
+	if (solarpos->zenith >= 90.0 && sun->z > 0.0)
+	{
+		sun->z = 0.0;
+	}
+}
+
+
+
+
+
+
+/**
+ * @brief
+ *  Find 3DOF single axis tracker angle from a sun vector
+ * 
+ *  Same result as tracker_angle(), but with the sun's trig already done by
+ * sun_vector() so only the tracker's own angles are evaluated per call.
+ * 
+ * @param [in] sun pointer to sun_vector_t struct
+ * @param [in] tracker pointer to tracker_t struct
+ * 
+ * @return Ideal tracker angle in degrees without shade avoidance
+ */
+double tracker_angle_vector(const sun_vector_t *sun, const tracker_t *tracker)
+{
+	// return stow angle when sun is below the horizon
+	if (sun->z <= 0.0) 
+	{
+		return(tracker->night_stow); 
+	}
+	
+	double beta = deg2rad(tracker->beta);
+	double alpha = deg2rad(tracker->alpha);
+	
+	double A = cos(alpha) * sun->y - sin(alpha) * sun->x;
+	double B = sin(beta) * (sin(alpha) * sun->y + cos(alpha) * sun->x) + cos(beta) * sun->z;
+	double calculated_angle = -atan(A / B);
+	
+	// atan2(A, B) is outside -pi/2..pi/2 exactly when B is negative
+	if (B < 0.0)
+	{
+		calculated_angle = -calculated_angle;
+	}
+	
+	return(rad2deg(calculated_angle));
+}
+
+
+
+
+
+
+/*
+ * Specialized tracker_angle() kernels, picked by tracker_kernel_init()
+ *
+ * Each one evaluates the same expression as tracker_angle() with the terms
+ * that vanish for its geometry dropped and sin/cos of alpha and beta taken
+ * from the kernel, so results match tracker_angle() bit for bit. The sign
+ * fix uses B < 0 rather than atan2(A, B), as in tracker_angle_vector().
+ */
+
+static double angle_horizontal(const tracker_kernel_t *kernel, const solarpos_t *solarpos)
+{
+	if (solarpos->zenith >= 90.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	
+	double theta = deg2rad(360 - solarpos->azimuth);
+	double phi = deg2rad(solarpos->zenith);
+	
+	// B = cos(phi) is positive whenever the sun is up, so no sign fix
+	return(rad2deg(-atan(sin(phi) * sin(theta) / cos(phi))));
+}
+
+static double angle_tilted(const tracker_kernel_t *kernel, const solarpos_t *solarpos)
+{
+	if (solarpos->zenith >= 90.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	
+	double theta = deg2rad(360 - solarpos->azimuth);
+	double phi = deg2rad(solarpos->zenith);
+	
+	double A = sin(phi) * sin(theta);
+	double B = kernel->sin_beta * sin(phi) * cos(theta) + kernel->cos_beta * cos(phi);
+	double calculated_angle = -atan(A / B);
+	if (B < 0.0)
+	{
+		calculated_angle = -calculated_angle;
+	}
+	return(rad2deg(calculated_angle));
+}
+
+static double angle_general(const tracker_kernel_t *kernel, const solarpos_t *solarpos)
+{
+	if (solarpos->zenith >= 90.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	
+	double theta = deg2rad(360 - solarpos->azimuth);
+	double phi = deg2rad(solarpos->zenith);
+	
+	double A = kernel->cos_alpha * sin(phi) * sin(theta) - kernel->sin_alpha * sin(phi) * cos(theta);
+	double B = kernel->sin_alpha * kernel->sin_beta * sin(phi) * sin(theta) + kernel->cos_alpha * kernel->sin_beta * sin(phi) * cos(theta) + kernel->cos_beta * cos(phi);
+	double calculated_angle = -atan(A / B);
+	if (B < 0.0)
+	{
+		calculated_angle = -calculated_angle;
+	}
+	return(rad2deg(calculated_angle));
+}
+
+static double angle_vector_horizontal(const tracker_kernel_t *kernel, const sun_vector_t *sun)
+{
+	if (sun->z <= 0.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	return(rad2deg(-atan(sun->y / sun->z)));
+}
+
+static double angle_vector_tilted(const tracker_kernel_t *kernel, const sun_vector_t *sun)
+{
+	if (sun->z <= 0.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	
+	double B = kernel->sin_beta * sun->x + kernel->cos_beta * sun->z;
+	double calculated_angle = -atan(sun->y / B);
+	if (B < 0.0)
+	{
+		calculated_angle = -calculated_angle;
+	}
+	return(rad2deg(calculated_angle));
+}
+
+static double angle_vector_general(const tracker_kernel_t *kernel, const sun_vector_t *sun)
+{
+	if (sun->z <= 0.0) 
+	{
+		return(kernel->night_stow); 
+	}
+	
+	double A = kernel->cos_alpha * sun->y - kernel->sin_alpha * sun->x;
+	double B = kernel->sin_beta * (kernel->sin_alpha * sun->y + kernel->cos_alpha * sun->x) + kernel->cos_beta * sun->z;
+	double calculated_angle = -atan(A / B);
+	if (B < 0.0)
+	{
+		calculated_angle = -calculated_angle;
+	}
+	return(rad2deg(calculated_angle));
+}
+
+
+/**
+ * @brief
+ *  Resolve a tracker configuration into its specialized tracker_angle() kernel
+ * 
+ *  Call once per configuration, then use kernel->angle(kernel, solarpos) or
+ * kernel->angle_vector(kernel, sun) per sample instead of tracker_angle() or
+ * tracker_angle_vector(), and backtrack_angle(&kernel->backtrack, angle)
+ * instead of shade_avoidance_angle(). Changing the tracker_t afterwards has
+ * no effect on the kernel.
+ * 
+ * @param [out] kernel pointer to tracker_kernel_t struct
+ * @param [in] tracker pointer to tracker_t struct
+ */
+void tracker_kernel_init(tracker_kernel_t *kernel, const tracker_t *tracker)
+{
+	double beta = deg2rad(tracker->beta);
+	double alpha = deg2rad(tracker->alpha);
+	
+	kernel->sin_alpha = sin(alpha);
+	kernel->cos_alpha = cos(alpha);
+	kernel->sin_beta = sin(beta);
+	kernel->cos_beta = cos(beta);
+	kernel->night_stow = tracker->night_stow;
+	backtrack_table_init(&kernel->backtrack, tracker);
+	
+	if (tracker->alpha == 0.0 && tracker->beta == 0.0)
+	{
+		kernel->geometry = TRACKER_GEOMETRY_HORIZONTAL;
+		kernel->angle = angle_horizontal;
+		kernel->angle_vector = angle_vector_horizontal;
+	}
+	else if (tracker->alpha == 0.0)
+	{
+		kernel->geometry = TRACKER_GEOMETRY_TILTED;
+		kernel->angle = angle_tilted;
+		kernel->angle_vector = angle_vector_tilted;
+	}
+	else
+	{
+		kernel->geometry = TRACKER_GEOMETRY_GENERAL;
+		kernel->angle = angle_general;
+		kernel->angle_vector = angle_vector_general;
+	}
+}
+
+
+/**
+ * @brief
+ *  Name of a tracker geometry, for reports
+ * 
+ * @param [in] geometry tracker_geometry_t value
+ * 
+ * @return "horizontal", "tilted" or "general"
+ */
+const char *tracker_geometry_name(tracker_geometry_t geometry)
+{
+	switch (geometry)
+	{
+		case TRACKER_GEOMETRY_HORIZONTAL:	return("horizontal");
+		case TRACKER_GEOMETRY_TILTED:		return("tilted");
+		default:							return("general");
+	}
+}
+
+
+
+
+
+
 /**
  * @brief
  *  Tracker shade avoidance function for tilted single axis trackers (tilt can be zero).
@@ -115,12 +362,12 @@ double tracker_angle(solarpos_t *solarpos, tracker_t *tracker)
  * 
  * @return Tracker angle in degrees WITH shade avoidance taken into account.
 */
-double shade_avoidance_angle(double tracker_angle, tracker_t *tracker) 
+double shade_avoidance_angle(double tracker_angle, const tracker_t *tracker) 
 {
 	double angle_sa;
 	double direct_cutoff = rad2deg(acos(tracker->gcr)); // This is the angle at which backtracking begins
 
-	if ( abs(tracker_angle) <= direct_cutoff ) 
+	if ( fabs(tracker_angle) <= direct_cutoff ) 
 	{
 		angle_sa = tracker_angle;
 	} 
@@ -157,3 +404,95 @@ double shade_avoidance_angle(double tracker_angle, tracker_t *tracker)
 
 
 
+
+
+/**
+ * @brief
+ *  Backtracked angle by direct evaluation, no table
+ * 
+ *  Same geometry as shade_avoidance_angle(), written as angle -/+ acos(cos(angle) / gcr).
+ *  Used to build the table and for angles past +/- 90 degrees. Not clamped to the range of motion.
+ * 
+ * @param [in] table pointer to backtrack_table_t struct, only cutoff and gcr are used
+ * @param [in] tracker_angle Ideal tracker angle in degrees without shade avoidance
+ * 
+ * @return Tracker angle in degrees with shade avoidance
+ */
+double backtrack_exact(const backtrack_table_t *table, double tracker_angle)
+{
+	if (fabs(tracker_angle) <= table->cutoff)
+	{
+		return(tracker_angle);
+	}
+	
+	// rounding can push the ratio just over 1 right at the cutoff
+	double x = cos(deg2rad(tracker_angle)) / table->gcr;
+	double correction = rad2deg(acos(x < 1.0 ? x : 1.0));
+	return((tracker_angle < 0) ? tracker_angle + correction : tracker_angle - correction);
+}
+
+
+
+
+
+
+/**
+ * @brief
+ *  Build the backtracking table for a tracker's gcr and rom
+ * 
+ *  Nodes are evenly spaced in u = sqrt(|angle| - cutoff) from the cutoff to 90 degrees.
+ *  The interpolation error is measured at several points inside every interval and
+ *  stored in max_error; with BACKTRACK_TABLE_SIZE intervals it is ~1e-9 degrees for
+ *  typical gcr values.
+ * 
+ * @param [out] table pointer to backtrack_table_t struct
+ * @param [in] tracker pointer to tracker_t struct, gcr and rom are used
+ */
+void backtrack_table_init(backtrack_table_t *table, const tracker_t *tracker)
+{
+	table->gcr = tracker->gcr;
+	table->rom = tracker->rom;
+	table->cutoff = rad2deg(acos(tracker->gcr)); // This is the angle at which backtracking begins
+	
+	double u_max = sqrt(90.0 - table->cutoff);
+	double h = u_max / BACKTRACK_TABLE_SIZE;
+	table->scale = BACKTRACK_TABLE_SIZE / u_max;
+	
+	int k;
+	for (k=0; k<=BACKTRACK_TABLE_SIZE; k++)
+	{
+		double u = k * h;
+		double angle = table->cutoff + u * u;
+		table->value[k] = angle - backtrack_exact(table, angle);
+		
+		// d(correction)/du = 2u * d(acos(cos(angle) / gcr))/d(angle), which tends to
+		// sqrt(2 tan(cutoff)) in radian units at the cutoff
+		double slope;
+		if (k == 0)
+		{
+			slope = sqrt(2.0 * tan(deg2rad(table->cutoff)) * DEG_TO_RAD) * RAD_TO_DEG;
+		}
+		else
+		{
+			double x = cos(deg2rad(angle)) / tracker->gcr;
+			slope = 2.0 * u * (sin(deg2rad(angle)) / tracker->gcr) / sqrt(1.0 - x * x);
+		}
+		table->slope[k] = slope * h;
+	}
+	
+	// measure the interpolation error between the nodes, before the range of motion clamp
+	table->max_error = 0;
+	double rom = table->rom;
+	table->rom = INFINITY;
+	for (k=0; k<BACKTRACK_TABLE_SIZE; k++)
+	{
+		int j;
+		for (j=1; j<8; j++)
+		{
+			double u = (k + j / 8.0) * h;
+			double angle = table->cutoff + u * u;
+			table->max_error = fmax(table->max_error, fabs(backtrack_angle(table, angle) - backtrack_exact(table, angle)));
+		}
+	}
+	table->rom = rom;
+}
@@ -12,9 +12,13 @@
 #ifndef TRACKING_ALGORITHM_H
 #define TRACKING_ALGORITHM_H
 
+#include <math.h>
 #include <inttypes.h>
 #include "solarpos.h"
 
+#define BACKTRACK_TABLE_SIZE	256		// intervals in the backtracking table
+#define BACKTRACK_TOLERANCE		1e-6	// largest allowed table error in degrees
+
 typedef struct
 {
 	double alpha; 		/// Tracker yaw angle in degrees
@@ -25,8 +29,109 @@ typedef struct
 	double rom;			/// Range of motion in degrees
 } tracker_t;
 
-double tracker_incident(tracker_t *tracker, solarpos_t *solarpos);
-double tracker_angle(solarpos_t *solarpos, tracker_t *tracker);
-double shade_avoidance_angle(double tracker_angle, tracker_t *tracker);
+/// unit vector pointing at the sun, same axes as tracker_incident()
+typedef struct
+{
+	double x;
+	double y;
+	double z;			/// <= 0 when the sun is below the horizon (zenith >= 90)
+} sun_vector_t;
+
+/// tracker orientations with their own tracker_angle() kernel
+typedef enum
+{
+	TRACKER_GEOMETRY_HORIZONTAL,	/// alpha = beta = 0
+	TRACKER_GEOMETRY_TILTED,		/// alpha = 0, axis tilted north-south by beta
+	TRACKER_GEOMETRY_GENERAL		/// any alpha and beta
+} tracker_geometry_t;
+
+/**
+ * shade_avoidance_angle() for one gcr and rom as a table
+ *
+ * Past the cutoff the backtracked angle is angle -/+ acos(cos(angle) / gcr),
+ * whose correction term grows like sqrt(|angle| - cutoff). The table is
+ * indexed by u = sqrt(|angle| - cutoff), where the correction is smooth, and
+ * interpolated with cubic Hermite segments from stored values and slopes.
+ */
+typedef struct
+{
+	double cutoff;								/// |angle| in degrees above which backtracking starts
+	double rom;									/// Range of motion in degrees
+	double gcr;									/// Ground coverage ratio fraction
+	double scale;								/// table intervals per unit of u
+	double max_error;							/// largest error in degrees measured by backtrack_table_init()
+	double value[BACKTRACK_TABLE_SIZE + 1];		/// correction in degrees at each node
+	double slope[BACKTRACK_TABLE_SIZE + 1];		/// d(correction)/du at each node, times the node spacing
+} backtrack_table_t;
+
+/// tracker_t resolved once by tracker_kernel_init(), the trig of its fixed angles done up front
+typedef struct tracker_kernel
+{
+	tracker_geometry_t geometry;
+	double sin_alpha;
+	double cos_alpha;
+	double sin_beta;
+	double cos_beta;
+	double night_stow;	/// Night stow angle in degrees
+	backtrack_table_t backtrack;
+	double (*angle)(const struct tracker_kernel *kernel, const solarpos_t *solarpos);
+	double (*angle_vector)(const struct tracker_kernel *kernel, const sun_vector_t *sun);
+} tracker_kernel_t;
+
+double tracker_incident(const tracker_t *tracker, const solarpos_t *solarpos);
+double tracker_angle(const solarpos_t *solarpos, const tracker_t *tracker);
+double shade_avoidance_angle(double tracker_angle, const tracker_t *tracker);
+void sun_vector(const solarpos_t *solarpos, sun_vector_t *sun);
+double tracker_angle_vector(const sun_vector_t *sun, const tracker_t *tracker);
+void tracker_kernel_init(tracker_kernel_t *kernel, const tracker_t *tracker);
+void backtrack_table_init(backtrack_table_t *table, const tracker_t *tracker);
+double backtrack_exact(const backtrack_table_t *table, double tracker_angle);
+const char *tracker_geometry_name(tracker_geometry_t geometry);
+
+
+/**
+ * @brief
+ *  shade_avoidance_angle() from a backtracking table
+ *
+ * @param [in] table pointer to backtrack_table_t struct from backtrack_table_init()
+ * @param [in] tracker_angle Ideal tracker angle in degrees without shade avoidance
+ *
+ * @return Tracker angle in degrees WITH shade avoidance, within +/- rom
+ */
+static inline double backtrack_angle(const backtrack_table_t *table, double tracker_angle)
+{
+	double angle_sa = tracker_angle;
+	double a = fabs(tracker_angle);
+	
+	if (a > table->cutoff)
+	{
+		double p = sqrt(a - table->cutoff) * table->scale;
+		if (p < BACKTRACK_TABLE_SIZE)
+		{
+			int k = (int)p;
+			double t = p - k;
+			double t2 = t * t;
+			double t3 = t2 * t;
+			double correction = (2*t3 - 3*t2 + 1) * table->value[k] + (t3 - 2*t2 + t) * table->slope[k]
+				+ (3*t2 - 2*t3) * table->value[k+1] + (t3 - t2) * table->slope[k+1];
+			angle_sa = (tracker_angle < 0) ? tracker_angle + correction : tracker_angle - correction;
+		}
+		else
+		{
+			angle_sa = backtrack_exact(table, tracker_angle);	// beyond +/- 90 degrees, past the table
+		}
+	}
+	
+	// keep angle within range of motion
+	if (angle_sa < -table->rom) 
+	{
+		return(-table->rom);
+	}
+	if (angle_sa > table->rom) 
+	{
+		return(table->rom);
+	}
+	return(angle_sa);
+}
 
 #endif